@@ -0,0 +1,87 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file AllocCounter.cpp
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#include <cstdlib>
+#include <new>
+#include "AllocCounter.h"
+#include "StageProfiler.h"
+
+using namespace std;
+
+//////////
+
+// スレッドごとに数える。複数のログを並列に処理しても、各スレッドのスキャン処理での回数がわかる
+static SLAM_THREAD_LOCAL unsigned long long allocCount = 0;
+static SLAM_THREAD_LOCAL unsigned long long allocBytes = 0;
+
+unsigned long long AllocCounter::getCount() {
+  return(allocCount);
+}
+
+unsigned long long AllocCounter::getBytes() {
+  return(allocBytes);
+}
+
+static void *countedAlloc(size_t size) {
+  ++allocCount;
+  allocBytes += size;
+  void *p = malloc((size > 0)? size : 1);
+  if (p == nullptr)
+    throw bad_alloc();
+  return(p);
+}
+
+//////////
+
+void *operator new(size_t size) {
+  return(countedAlloc(size));
+}
+
+void *operator new[](size_t size) {
+  return(countedAlloc(size));
+}
+
+void *operator new(size_t size, const nothrow_t &) noexcept {
+  try {
+    return(countedAlloc(size));
+  }
+  catch (...) {
+    return(nullptr);
+  }
+}
+
+void *operator new[](size_t size, const nothrow_t &) noexcept {
+  try {
+    return(countedAlloc(size));
+  }
+  catch (...) {
+    return(nullptr);
+  }
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+void operator delete[](void *p) noexcept {
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+  free(p);
+}
@@ -0,0 +1,29 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file AllocCounter.h
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#ifndef ALLOC_COUNTER_H_
+#define ALLOC_COUNTER_H_
+
+#include <cstddef>
+
+// ヒープ確保の回数を数える。AllocCounter.cppをリンクすると、プログラム全体のoperator newが置き換わる
+// 1スキャンの処理の前後で差をとれば、そのスキャンで何回確保したかがわかる。回数は呼び出したスレッドでの確保だけを数える
+class AllocCounter
+{
+public:
+  static unsigned long long getCount();       // このスレッドでのこれまでの確保回数
+  static unsigned long long getBytes();       // このスレッドでのこれまでの確保バイト数
+};
+
+#endif
@@ -0,0 +1,158 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file ScanSimulator.cpp
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#include "ScanSimulator.h"
+
+using namespace std;
+
+//////////
+
+void ScanSimulator::addSegment(double x1, double y1, double x2, double y2) {
+  SimSegment s;
+  s.x1 = x1;  s.y1 = y1;
+  s.x2 = x2;  s.y2 = y2;
+  segs.push_back(s);
+}
+
+// 軸に平行な長方形の4辺を加える
+void ScanSimulator::addBox(double x0, double y0, double x1, double y1) {
+  addSegment(x0, y0, x1, y0);
+  addSegment(x1, y0, x1, y1);
+  addSegment(x1, y1, x0, y1);
+  addSegment(x0, y1, x0, y0);
+}
+
+// 線分を格子に登録する。線分の外接矩形が掛かるセルすべてに入れる
+// 線分を加え終わったら呼ぶこと
+void ScanSimulator::buildIndex() {
+  cells.clear();
+  if (segs.empty())
+    return;
+
+  double xmax=-HUGE_VAL, ymax=-HUGE_VAL;
+  xmin = ymin = HUGE_VAL;
+  for (size_t i=0; i<segs.size(); i++) {
+    const SimSegment &s = segs[i];
+    xmin = min(xmin, min(s.x1, s.x2));
+    ymin = min(ymin, min(s.y1, s.y2));
+    xmax = max(xmax, max(s.x1, s.x2));
+    ymax = max(ymax, max(s.y1, s.y2));
+  }
+  nx = static_cast<int>((xmax - xmin)/csize) + 1;
+  ny = static_cast<int>((ymax - ymin)/csize) + 1;
+  cells.resize(static_cast<size_t>(nx)*ny);
+
+  for (size_t i=0; i<segs.size(); i++) {
+    const SimSegment &s = segs[i];
+    int i0 = static_cast<int>((min(s.x1, s.x2) - xmin)/csize);
+    int i1 = static_cast<int>((max(s.x1, s.x2) - xmin)/csize);
+    int j0 = static_cast<int>((min(s.y1, s.y2) - ymin)/csize);
+    int j1 = static_cast<int>((max(s.y1, s.y2) - ymin)/csize);
+    for (int j=j0; j<=j1; j++)
+      for (int k=i0; k<=i1; k++)
+        cells[j*nx + k].push_back(static_cast<int>(i));
+  }
+}
+
+// 点(px,py)から方向(dx,dy)に出たビームが線分sに当たる距離。当たらなければHUGE_VAL
+double ScanSimulator::hitSegment(const SimSegment &s, double px, double py, double dx, double dy) const {
+  double ex = s.x2 - s.x1;
+  double ey = s.y2 - s.y1;
+  double den = dx*ey - dy*ex;
+  if (fabs(den) < 1.0E-12)                    // 平行
+    return(HUGE_VAL);
+  double t = ((s.x1 - px)*ey - (s.y1 - py)*ex)/den;     // ビーム上の距離
+  double u = ((s.x1 - px)*dy - (s.y1 - py)*dx)/den;     // 線分上の位置（0〜1）
+  if (t <= 1.0E-9 || u < 0 || u > 1)
+    return(HUGE_VAL);
+  return(t);
+}
+
+// 点(px,py)から方位a[rad]に出たビームが最初に当たる壁までの距離。射程内に壁がなければHUGE_VAL
+// 格子のセルをビームに沿ってたどり（Amanatides-Wooの方法）、見つかった距離がそのセルの出口より手前なら終わる
+double ScanSimulator::castRay(double px, double py, double a) const {
+  double dx = cos(a);
+  double dy = sin(a);
+  double best = HUGE_VAL;
+
+  int cx = static_cast<int>(floor((px - xmin)/csize));
+  int cy = static_cast<int>(floor((py - ymin)/csize));
+  if (cells.empty() || cx < 0 || cx >= nx || cy < 0 || cy >= ny) {     // 格子の外からは全部調べる
+    for (size_t i=0; i<segs.size(); i++)
+      best = min(best, hitSegment(segs[i], px, py, dx, dy));
+    return((best <= maxRange)? best : HUGE_VAL);
+  }
+
+  int stepX = (dx > 0)? 1 : -1;
+  int stepY = (dy > 0)? 1 : -1;
+  double tMaxX = (dx != 0)? (xmin + (cx + (dx > 0))*csize - px)/dx : HUGE_VAL;   // 次のx境界までの距離
+  double tMaxY = (dy != 0)? (ymin + (cy + (dy > 0))*csize - py)/dy : HUGE_VAL;
+  double tDeltaX = (dx != 0)? csize/fabs(dx) : HUGE_VAL;                         // セル1個分の距離
+  double tDeltaY = (dy != 0)? csize/fabs(dy) : HUGE_VAL;
+
+  while (true) {
+    const vector<int> &cell = cells[cy*nx + cx];
+    for (size_t k=0; k<cell.size(); k++)
+      best = min(best, hitSegment(segs[cell[k]], px, py, dx, dy));
+
+    double tExit = min(tMaxX, tMaxY);          // このセルの出口
+    if (best <= tExit || tExit > maxRange)
+      break;
+
+    if (tMaxX < tMaxY) {
+      cx += stepX;
+      if (cx < 0 || cx >= nx)
+        break;
+      tMaxX += tDeltaX;
+    }
+    else {
+      cy += stepY;
+      if (cy < 0 || cy >= ny)
+        break;
+      tMaxY += tDeltaY;
+    }
+  }
+
+  return((best <= maxRange)? best : HUGE_VAL);
+}
+
+// poseにあるセンサのスキャンを作る。rangesは各ビームの距離で、計測なしは0
+void ScanSimulator::makeScan(const Pose2D &pose, vector<double> &ranges) {
+  ranges.resize(beamNum);
+  for (int i=0; i<beamNum; i++) {
+    double r = castRay(pose.tx, pose.ty, DEG2RAD(pose.th + beamAngle(i)));
+    if (r == HUGE_VAL)
+      ranges[i] = 0;
+    else
+      ranges[i] = max(0.0, r + rangeNoise*ndist(rng));
+  }
+}
+
+// 走査中に動くセンサのスキャンを作る。最後のビームをposeで、それより前のビームは、prevからposeへの移動を
+// 線形補間した位置で計測する。ratioはスキャン間の移動のうち走査にかかる割合（走査時間/スキャン周期）
+void ScanSimulator::makeSweptScan(const Pose2D &prev, const Pose2D &pose, double ratio, vector<double> &ranges) {
+  ranges.resize(beamNum);
+  double dth = MyUtil::add(pose.th, -prev.th);
+  for (int i=0; i<beamNum; i++) {
+    double u = (beamNum > 1)? ratio*(1.0 - static_cast<double>(i)/(beamNum - 1)) : 0;    // 最後のビームから遡る割合
+    double x = pose.tx - u*(pose.tx - prev.tx);
+    double y = pose.ty - u*(pose.ty - prev.ty);
+    double th = pose.th - u*dth;
+    double r = castRay(x, y, DEG2RAD(th + beamAngle(i)));
+    if (r == HUGE_VAL)
+      ranges[i] = 0;
+    else
+      ranges[i] = max(0.0, r + rangeNoise*ndist(rng));
+  }
+}
@@ -0,0 +1,105 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file ScanSimulator.h
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#ifndef SCAN_SIMULATOR_H_
+#define SCAN_SIMULATOR_H_
+
+#include <vector>
+#include <random>
+#include "MyUtil.h"
+#include "Pose2D.h"
+
+// 環境の壁（線分）
+struct SimSegment
+{
+  double x1, y1;
+  double x2, y2;
+};
+
+///////
+
+// 線分でできた2次元環境でレーザスキャンを模擬する
+// 線分は格子に登録しておき、ビームが通るセルだけを調べるので、環境が広くてもビーム1本の計算量は射程で決まる
+class ScanSimulator
+{
+private:
+  std::vector<SimSegment> segs;             // 環境の線分
+  double csize;                             // 線分格子のセルサイズ[m]
+  double xmin, ymin;                        // 線分格子の左下[m]
+  int nx, ny;                               // 線分格子のセル数
+  std::vector<std::vector<int> > cells;     // セルごとの線分番号
+
+  int beamNum;                              // ビーム数
+  double fov;                               // 計測範囲[度]。正面を中心にする
+  double maxRange;                          // 射程[m]。これより遠いと計測なし
+  double rangeNoise;                        // 距離の誤差の標準偏差[m]
+  std::mt19937 rng;                         // 乱数。種を決めれば同じ出力になる
+  std::normal_distribution<double> ndist;
+
+public:
+  ScanSimulator() : csize(2.0), xmin(0), ymin(0), nx(0), ny(0), beamNum(1081), fov(270), maxRange(30), rangeNoise(0.01), rng(1), ndist(0, 1) {
+  }
+
+  ~ScanSimulator() {
+  }
+
+  void setBeam(int n, double f) {
+    beamNum = n;
+    fov = f;
+  }
+
+  int getBeamNum() const {
+    return(beamNum);
+  }
+
+  void setMaxRange(double r) {
+    maxRange = r;
+  }
+
+  void setRangeNoise(double s) {
+    rangeNoise = s;
+  }
+
+  void setSeed(unsigned int s) {
+    rng.seed(s);
+  }
+
+  // i番目のビームのセンサ座標系での方位[度]
+  double beamAngle(int i) const {
+    return((beamNum > 1)? -fov/2 + fov*i/(beamNum - 1) : 0);
+  }
+
+  // 標準正規分布の乱数。軌跡の誤差づけにも使う
+  double gauss() {
+    return(ndist(rng));
+  }
+
+  size_t getSegmentNum() const {
+    return(segs.size());
+  }
+
+//////////
+
+  void addSegment(double x1, double y1, double x2, double y2);
+  void addBox(double x0, double y0, double x1, double y1);
+  void buildIndex();
+  double castRay(double px, double py, double a) const;
+  void makeScan(const Pose2D &pose, std::vector<double> &ranges);
+  void makeSweptScan(const Pose2D &prev, const Pose2D &pose, double ratio, std::vector<double> &ranges);
+
+private:
+  double hitSegment(const SimSegment &s, double px, double py, double dx, double dy) const;
+};
+
+#endif
@@ -0,0 +1,84 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file WorkStealingPool.cpp
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#include <thread>
+#include "WorkStealingPool.h"
+
+using namespace std;
+
+//////////
+
+// スレッド数nが0なら、計算機のハードウェアスレッド数にする
+WorkStealingPool::WorkStealingPool(size_t n) : threadNum((n > 0)? n : defaultThreadNum()), stolenNum(0) {
+  for (size_t w=0; w<threadNum; w++)
+    queues.push_back(new WorkerQueue());
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  for (size_t w=0; w<queues.size(); w++)
+    delete queues[w];
+}
+
+// 計算機のハードウェアスレッド数。わからなければ1
+size_t WorkStealingPool::defaultThreadNum() {
+  unsigned int n = thread::hardware_concurrency();
+  return((n > 0)? n : 1);
+}
+
+// 仕事tasksを全部処理して戻る。仕事は与えた順に各スレッドへ1個ずつ配るので、長い仕事を先に並べると早く終わる
+// スレッド0は呼び出したスレッドで動かすので、スレッド数が1ならスレッドを作らずに順に処理する
+void WorkStealingPool::run(const vector<function<void()> > &tasks) {
+  for (size_t i=0; i<tasks.size(); i++)
+    queues[i%threadNum]->tasks.push_back(tasks[i]);
+
+  vector<thread> workers;
+  for (size_t w=1; w<threadNum; w++)
+    workers.push_back(thread(&WorkStealingPool::workerLoop, this, w));
+  workerLoop(0);
+  for (size_t w=0; w<workers.size(); w++)
+    workers[w].join();
+}
+
+// スレッドwの次の仕事をtaskに入れる。全キューが空ならfalse
+// 処理中に仕事は増えないので、一巡して見つからなければ終わってよい
+bool WorkStealingPool::takeTask(size_t w, function<void()> &task) {
+  {
+    WorkerQueue *q = queues[w];
+    lock_guard<mutex> lock(q->mtx);
+    if (!q->tasks.empty()) {
+      task = q->tasks.front();
+      q->tasks.pop_front();
+      return(true);
+    }
+  }
+
+  for (size_t k=1; k<threadNum; k++) {           // 隣から順に盗みに行く
+    WorkerQueue *q = queues[(w + k)%threadNum];
+    lock_guard<mutex> lock(q->mtx);
+    if (!q->tasks.empty()) {                      // 持ち主と反対側の、後回しにされた短い仕事を取る
+      task = q->tasks.back();
+      q->tasks.pop_back();
+      ++stolenNum;
+      return(true);
+    }
+  }
+
+  return(false);
+}
+
+void WorkStealingPool::workerLoop(size_t w) {
+  function<void()> task;
+  while (takeTask(w, task))
+    task();
+}
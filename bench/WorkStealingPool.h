@@ -0,0 +1,60 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file WorkStealingPool.h
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#ifndef WORK_STEALING_POOL_H_
+#define WORK_STEALING_POOL_H_
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <functional>
+
+// 互いに独立な仕事を複数のスレッドで処理するスレッドプール
+// 仕事は最初にスレッドごとのキューに順に配り、各スレッドは自分のキューの先頭から取る
+// 自分のキューが空になったら、他のスレッドのキューの末尾から盗む。仕事の長さがまちまちでも、最後まで全スレッドが働ける
+class WorkStealingPool
+{
+private:
+  struct WorkerQueue
+  {
+    std::mutex mtx;
+    std::deque<std::function<void()> > tasks;
+  };
+
+  size_t threadNum;                        // スレッド数
+  std::vector<WorkerQueue*> queues;        // スレッドごとの仕事のキュー
+  std::atomic<size_t> stolenNum;           // 他のスレッドから盗んだ仕事の数
+
+public:
+  explicit WorkStealingPool(size_t n=0);
+  ~WorkStealingPool();
+
+  size_t getThreadNum() const {
+    return(threadNum);
+  }
+
+  size_t getStolenNum() const {
+    return(stolenNum.load());
+  }
+
+  static size_t defaultThreadNum();
+  void run(const std::vector<std::function<void()> > &tasks);
+
+private:
+  bool takeTask(size_t w, std::function<void()> &task);
+  void workerLoop(size_t w);
+};
+
+#endif
@@ -0,0 +1,253 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file kernel_bench.cpp
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+// SLAMの主要な処理を個別に測るマイクロベンチマーク（Google Benchmark）
+// 入力は、部屋の中の合成スキャン。引数はスキャンのビーム数で、--benchmark_filterで対象を選べる
+// 例: kernel_bench --benchmark_filter=NNGrid --benchmark_format=json
+
+#include <cmath>
+#include <vector>
+#include <map>
+#include <benchmark/benchmark.h>
+
+#include "MyUtil.h"
+#include "LPoint2D.h"
+#include "Pose2D.h"
+#include "Scan2D.h"
+#include "NNGridTable.h"
+#include "ScanPointResampler.h"
+#include "ScanPointAnalyser.h"
+#include "CovarianceCalculator.h"
+#include "DataAssociatorGT.h"
+#include "CostFunctionED.h"
+#include "CostFunctionPD.h"
+#include "PoseOptimizerSL.h"
+#include "SlamLog.h"
+#include "ScanSimulator.h"
+
+using namespace std;
+
+///////
+
+// 合成スキャンとその対応づけ結果。ビーム数ごとに1回だけ作る
+// 点数がビーム数に比例するように、均一化はしない（均一化すると点数は部屋の大きさで決まる）
+struct KernelData
+{
+  Scan2D refScan;                           // 参照スキャン。原点で取得
+  Scan2D curScan;                           // 現在スキャン。curPoseで取得
+  Scan2D rawScan;                           // 法線計算前の現在スキャン
+  Pose2D curPose;                           // 現在スキャンの真の位置
+  Pose2D predPose;                          // 現在スキャンの予測位置。真値から少しずらす
+  CorrespondenceSet corrs;                  // 対応づけた点の組
+};
+
+// 部屋は8m x 5m（原点中心）で、柱が4本ある
+static void makeRoom(ScanSimulator &sim) {
+  sim.addBox(-4.0, -2.5, 4.0, 2.5);
+  const double pillars[4][3] = {{1.5, 1.0, 0.2}, {-2.0, -1.2, 0.3}, {2.5, -1.5, 0.15}, {-1.0, 1.6, 0.25}};
+  for (int k=0; k<4; k++) {
+    const double *p = pillars[k];
+    sim.addBox(p[0]-p[2], p[1]-p[2], p[0]+p[2], p[1]+p[2]);
+  }
+  sim.buildIndex();
+}
+
+// poseで測ったスキャンを作る。点はセンサ座標系
+static void makeScan(ScanSimulator &sim, const Pose2D &pose, int sid, Scan2D &scan) {
+  vector<double> ranges;
+  sim.makeScan(pose, ranges);
+  vector<LPoint2D> lps;
+  lps.reserve(ranges.size());
+  for (size_t i=0; i<ranges.size(); i++) {
+    if (ranges[i] <= Scan2D::MIN_SCAN_RANGE || ranges[i] >= Scan2D::MAX_SCAN_RANGE)
+      continue;
+    LPoint2D lp;
+    lp.setSid(sid);
+    lp.calXY(ranges[i], sim.beamAngle(static_cast<int>(i)));
+    lps.emplace_back(lp);
+  }
+  scan.setSid(sid);
+  scan.setLps(lps);
+}
+
+static const KernelData &getData(int beamNum) {
+  static map<int, KernelData> cache;
+  map<int, KernelData>::iterator it = cache.find(beamNum);
+  if (it != cache.end())
+    return(it->second);
+
+  KernelData &d = cache[beamNum];
+  ScanPointAnalyser spana;
+  ScanSimulator sim;
+  sim.setBeam(beamNum, 270);
+  sim.setRangeNoise(0.005);
+  makeRoom(sim);
+
+  Pose2D org(0, 0, 0);
+  makeScan(sim, org, 0, d.refScan);
+  spana.analysePoints(d.refScan.lps);
+
+  d.curPose = Pose2D(0.10, 0.05, 2.0);
+  makeScan(sim, d.curPose, 1, d.rawScan);
+  d.curScan = d.rawScan;
+  spana.analysePoints(d.curScan.lps);
+  d.predPose = Pose2D(0.12, 0.03, 1.5);
+
+  DataAssociatorGT dass;
+  dass.setRefBase(d.refScan.lps);
+  dass.findCorrespondence(&d.curScan, d.predPose);
+  d.corrs = dass.corrs;
+
+  return(d);
+}
+
+// ビーム数。実機のURG（1081点）を中心に、小さいものと大きいもの
+static void beamArgs(benchmark::internal::Benchmark *b) {
+  b->Arg(271)->Arg(1081)->Arg(4321);
+}
+
+///////
+
+static void BM_NNGridTable_addPoint(benchmark::State &state) {
+  const KernelData &d = getData(static_cast<int>(state.range(0)));
+  NNGridTable *nntab = new NNGridTable();
+  for (auto _ : state) {
+    state.PauseTiming();
+    nntab->clear();                               // 点の配列を空にするだけ。セル表はfindClosestPoint等で作るので、ここでは点の追加だけを測る
+    state.ResumeTiming();
+    for (size_t i=0; i<d.refScan.lps.size(); i++)
+      nntab->addPoint(&d.refScan.lps[i]);
+  }
+  state.SetItemsProcessed(state.iterations()*d.refScan.lps.size());
+  delete nntab;
+}
+BENCHMARK(BM_NNGridTable_addPoint)->Apply(beamArgs);
+
+static void BM_NNGridTable_findClosestPoint(benchmark::State &state) {
+  const KernelData &d = getData(static_cast<int>(state.range(0)));
+  NNGridTable *nntab = new NNGridTable();
+  for (size_t i=0; i<d.refScan.lps.size(); i++)
+    nntab->addPoint(&d.refScan.lps[i]);
+  for (auto _ : state) {
+    for (size_t i=0; i<d.curScan.lps.size(); i++)
+      benchmark::DoNotOptimize(nntab->findClosestPoint(&d.curScan.lps[i], d.predPose));
+  }
+  state.SetItemsProcessed(state.iterations()*d.curScan.lps.size());
+  delete nntab;
+}
+BENCHMARK(BM_NNGridTable_findClosestPoint)->Apply(beamArgs);
+
+// 点のある範囲（外接矩形）のセルを走査するので、外接矩形のセル数と点数で決まる
+static void BM_NNGridTable_makeCellPoints(benchmark::State &state) {
+  const KernelData &d = getData(static_cast<int>(state.range(0)));
+  NNGridTable *nntab = new NNGridTable();
+  for (size_t i=0; i<d.refScan.lps.size(); i++)
+    nntab->addPoint(&d.refScan.lps[i]);
+  vector<LPoint2D> ps;
+  for (auto _ : state) {
+    ps.clear();
+    nntab->makeCellPoints(1, ps);
+    benchmark::DoNotOptimize(ps.data());
+  }
+  delete nntab;
+}
+BENCHMARK(BM_NNGridTable_makeCellPoints)->Apply(beamArgs)->Unit(benchmark::kMicrosecond);
+
+static void BM_DataAssociatorGT_findCorrespondence(benchmark::State &state) {
+  const KernelData &d = getData(static_cast<int>(state.range(0)));
+  DataAssociatorGT dass;                          // 格子テーブルは点のある範囲だけ確保するので、スタックに置ける
+  dass.setRefBase(d.refScan.lps);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(dass.findCorrespondence(&d.curScan, d.predPose));
+  state.SetItemsProcessed(state.iterations()*d.curScan.lps.size());
+}
+BENCHMARK(BM_DataAssociatorGT_findCorrespondence)->Apply(beamArgs);
+
+template <class CF>
+static void BM_CostFunction_calValue(benchmark::State &state) {
+  const KernelData &d = getData(static_cast<int>(state.range(0)));
+  CF cfunc;
+  cfunc.setEvlimit(0.2);
+  cfunc.setPoints(d.corrs);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(cfunc.calValue(d.predPose.tx, d.predPose.ty, d.predPose.th));
+  state.SetItemsProcessed(state.iterations()*d.corrs.size());
+}
+BENCHMARK_TEMPLATE(BM_CostFunction_calValue, CostFunctionED)->Apply(beamArgs);
+BENCHMARK_TEMPLATE(BM_CostFunction_calValue, CostFunctionPD)->Apply(beamArgs);
+
+static void BM_PoseOptimizerSL_optimizePose(benchmark::State &state) {
+  const KernelData &d = getData(static_cast<int>(state.range(0)));
+  CostFunctionPD cfunc;
+  PoseOptimizerSL popt;
+  popt.setCostFunction(&cfunc);
+  popt.setEvlimit(0.2);
+  popt.setPoints(d.corrs);
+  for (auto _ : state) {
+    Pose2D initPose = d.predPose;
+    Pose2D estPose;
+    benchmark::DoNotOptimize(popt.optimizePose(initPose, estPose));
+  }
+}
+BENCHMARK(BM_PoseOptimizerSL_optimizePose)->Apply(beamArgs);
+
+static void BM_ScanPointAnalyser_analysePoints(benchmark::State &state) {
+  const KernelData &d = getData(static_cast<int>(state.range(0)));
+  vector<LPoint2D> lps = d.curScan.lps;
+  ScanPointAnalyser spana;
+  for (auto _ : state) {
+    spana.analysePoints(lps);                     // 法線を上書きするだけなので、同じ点群で繰り返せる
+    benchmark::DoNotOptimize(lps.data());
+  }
+  state.SetItemsProcessed(state.iterations()*lps.size());
+}
+BENCHMARK(BM_ScanPointAnalyser_analysePoints)->Apply(beamArgs);
+
+static void BM_ScanPointResampler_resamplePoints(benchmark::State &state) {
+  const KernelData &d = getData(static_cast<int>(state.range(0)));
+  ScanPointResampler spres;
+  Scan2D scan;
+  for (auto _ : state) {
+    state.PauseTiming();
+    scan.lps = d.rawScan.lps;                     // 点群を書き換えるので毎回戻す
+    state.ResumeTiming();
+    spres.resamplePoints(&scan);
+    benchmark::DoNotOptimize(scan.lps.data());
+  }
+  state.SetItemsProcessed(state.iterations()*d.rawScan.lps.size());
+}
+BENCHMARK(BM_ScanPointResampler_resamplePoints)->Apply(beamArgs);
+
+static void BM_CovarianceCalculator_calIcpCovariance(benchmark::State &state) {
+  const KernelData &d = getData(static_cast<int>(state.range(0)));
+  CovarianceCalculator cvc;
+  Eigen::Matrix3d cov;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(cvc.calIcpCovariance(d.curPose, d.corrs, cov));
+    benchmark::DoNotOptimize(cov.data());
+  }
+  state.SetItemsProcessed(state.iterations()*d.corrs.size());
+}
+BENCHMARK(BM_CovarianceCalculator_calIcpCovariance)->Apply(beamArgs);
+
+///////
+
+int main(int argc, char *argv[]) {
+  SlamLog::setLevel(SLAM_LOG_WARN);             // 確認用の表示で計測が乱れないようにする
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return(1);
+  benchmark::RunSpecifiedBenchmarks();
+  return(0);
+}
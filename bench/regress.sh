@@ -0,0 +1,42 @@
+#!/bin/sh
+# LittleSLAM: 2D-Laser SLAM for educational use
+# Copyright (C) 2017-2018 Masahiro Tomono
+# Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+#                    Chiba Institute of Technology.
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this file,
+# You can obtain one at https://mozilla.org/MPL/2.0/.
+#
+# @file regress.sh
+# @author Masahiro Tomono
+
+# 合成データでslam_benchを実行し、長時間のSLAMや位置推定が壊れていないかを確かめる回帰テスト
+# 使い方: regress.sh [ビルドしたbenchディレクトリ] [作業ディレクトリ]
+# LittleSLAMは、benchディレクトリと並ぶcuiディレクトリのものを使う
+# どれかの実行が失敗（終了コードが0以外）すると、終了コード1を返す
+
+BIN=$(cd "${1:-.}" && pwd) || exit 1
+WORK=${2:-regress_work}
+mkdir -p "$WORK" || exit 1
+
+fail=0
+
+# 姿勢グラフのメモリプールの1ブロック（10万ノード）を超えるスキャン数
+echo "== long lap (100010 scans)"
+"$BIN/scan_sim" -m lap -N 100010 -b 181 -n 0.005 "$WORK/long.lsc" &&
+"$BIN/slam_bench" -c A -o "$WORK/long.json" "$WORK/long.lsc" || fail=1
+
+# 周回の地図をSLAMで作り、その距離場に対する位置推定が真の軌跡から外れないか
+# LittleSLAMはカレントディレクトリに出力するので、作業ディレクトリで実行する
+echo "== localization on a lap"
+"$BIN/scan_sim" -m lap -N 3000 -g "$WORK/loc_gt.txt" "$WORK/loc.lsc" &&
+(cd "$WORK" && "$BIN/../cui/LittleSLAM" -bm loc.lsc > /dev/null) &&
+"$BIN/slam_bench" -c I -l "$WORK/loc_field.bin" -e 0.1 -r "$WORK/loc_gt.txt" -o "$WORK/loc.json" "$WORK/loc.lsc" || fail=1
+
+if [ $fail -ne 0 ]; then
+  echo "regress: FAILED"
+  exit 1
+fi
+echo "regress: OK"
+exit 0
@@ -0,0 +1,348 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file scan_sim.cpp
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+// 合成データの生成。碁盤目状の通路をもつ環境をロボットが走り、LASERSCAN形式のデータファイルを出力する
+// 使い方: scan_sim [オプション] 出力ファイル
+//   -w RxC  ブロックの行数と列数（既定 3x3）。ブロックの間が通路になる
+//   -k 大きさ,通路幅  ブロックの1辺と通路幅[m]（既定 9,3）
+//   -m 経路 walk: 交差点ごとに曲がる方向を乱数で選ぶ（何度も同じ場所に戻る）
+//           lap:  外周を回り続ける（1周ごとに同じ場所に戻る）
+//   -L 長さ  走行距離[m]（既定 200）。-Nがあればそちらを使う
+//   -N 個数  スキャン数
+//   -b 本数  ビーム数（既定 1081）、-f 角度  計測範囲[度]（既定 270）、-R 距離  射程[m]（既定 30）
+//   -n 誤差  距離の誤差の標準偏差[m]（既定 0.01）
+//   -r 周期  スキャン周期[Hz]（既定 10）、-v 速さ  走行速度[m/s]（既定 0.5）
+//   -e 誤差  オドメトリの誤差の比率（既定 0.05）
+//   -S 時間  1回の走査にかかる時間[ms]（既定 0）。0でなければ、走査中の移動でスキャンが歪む
+//   -s 種    乱数の種（既定 1）
+//   -g ファイル  真の軌跡を「番号 x y 角度[度]」で出力する（slam_bench -rで使える）
+// SLAMの地図座標系は出発位置が原点になる。walkは中央の交差点から、lapは下辺の中央の交差点から出発する
+// 出発位置から外壁までがNNGridTableの対象領域（±40m）を超える大きさの環境は、壁が地図から落ちるのでエラーにする
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <random>
+
+#include "MyUtil.h"
+#include "Pose2D.h"
+#include "ScanSimulator.h"
+#include "SlamLog.h"
+
+using namespace std;
+
+///////
+
+// 出発位置から外壁までの距離の上限[m]。NNGridTableの対象領域の半分
+static const double MAP_REACH = 40;
+
+///////
+
+// 碁盤目状の環境。交差点の間を通路でつなぐ
+struct BlockWorld
+{
+  int rows, cols;                           // ブロックの行数と列数
+  double block;                             // ブロックの1辺[m]
+  double corridor;                          // 通路幅[m]
+  double x0, y0;                            // 左下の交差点の位置[m]
+  double left, bottom;                      // 外壁の左下の角の位置[m]
+  double width, height;                     // 外壁の大きさ[m]
+
+  // 交差点(i,j)の位置。iは0〜rows、jは0〜cols
+  double nodeX(int j) const {
+    return(x0 + j*(block + corridor));
+  }
+
+  double nodeY(int i) const {
+    return(y0 + i*(block + corridor));
+  }
+};
+
+// 外壁とブロックをsimに加える。通路が単調にならないように、ブロックの各辺に小さな出っ張りをつける
+static void makeBlockWorld(BlockWorld &w, ScanSimulator &sim) {
+  double pitch = w.block + w.corridor;
+  double width = w.cols*pitch + w.corridor;
+  double height = w.rows*pitch + w.corridor;
+  double left = -width/2;
+  double bottom = -height/2;
+  w.x0 = left + w.corridor/2;
+  w.y0 = bottom + w.corridor/2;
+  w.left = left;
+  w.bottom = bottom;
+  w.width = width;
+  w.height = height;
+
+  sim.addBox(left, bottom, left + width, bottom + height);       // 外壁
+  const double bump = 0.4;                                       // 出っ張りの大きさ[m]
+  for (int i=0; i<w.rows; i++) {
+    for (int j=0; j<w.cols; j++) {
+      double bx = left + w.corridor + j*pitch;
+      double by = bottom + w.corridor + i*pitch;
+      sim.addBox(bx, by, bx + w.block, by + w.block);
+      for (int k=0; k<4; k++) {
+        double u = (0.2 + 0.6*(0.5 + 0.5*sin(12.9898*(i*w.cols + j) + 78.233*k)))*w.block;   // 辺上の位置
+        if (k == 0)
+          sim.addBox(bx + u, by - bump, bx + u + bump, by);
+        else if (k == 1)
+          sim.addBox(bx + w.block, by + u, bx + w.block + bump, by + u + bump);
+        else if (k == 2)
+          sim.addBox(bx + u, by + w.block, bx + u + bump, by + w.block + bump);
+        else
+          sim.addBox(bx - bump, by + u, bx, by + u + bump);
+      }
+    }
+  }
+  sim.buildIndex();
+}
+
+///////
+
+// 経路。交差点を順にたどる
+class Route
+{
+private:
+  const BlockWorld &w;
+  bool lap;                                 // 外周を回るか
+  int ci, cj;                               // 今いる交差点
+  int pi, pj;                               // 1つ前の交差点
+  std::mt19937 rng;                         // 曲がる方向を選ぶ乱数
+
+public:
+  // 交差点(i0,j0)から出発する。lapでは外周上の交差点にすること
+  Route(const BlockWorld &w_, bool lap_, unsigned int seed, int i0, int j0) : w(w_), lap(lap_), ci(i0), cj(j0), pi(-1), pj(-1), rng(seed) {
+  }
+
+  // 次の交差点に進んで、その位置を返す
+  void next(double &x, double &y) {
+    int ni=ci, nj=cj;
+    if (lap) {                              // 反時計回りに外周をたどる
+      if (ci == 0 && cj < w.cols)
+        nj = cj + 1;
+      else if (cj == w.cols && ci < w.rows)
+        ni = ci + 1;
+      else if (ci == w.rows && cj > 0)
+        nj = cj - 1;
+      else
+        ni = ci - 1;
+    }
+    else {                                  // 引き返す以外の方向から選ぶ
+      static const int di[4] = {1, 0, -1, 0};
+      static const int dj[4] = {0, 1, 0, -1};
+      int cand[4][2];
+      int n=0;
+      for (int k=0; k<4; k++) {
+        int ti = ci + di[k], tj = cj + dj[k];
+        if (ti < 0 || ti > w.rows || tj < 0 || tj > w.cols)
+          continue;
+        if (ti == pi && tj == pj)
+          continue;
+        cand[n][0] = ti;
+        cand[n][1] = tj;
+        ++n;
+      }
+      int k = std::uniform_int_distribution<int>(0, n-1)(rng);
+      ni = cand[k][0];
+      nj = cand[k][1];
+    }
+    pi = ci;  pj = cj;
+    ci = ni;  cj = nj;
+    x = w.nodeX(cj);
+    y = w.nodeY(ci);
+  }
+};
+
+///////
+
+int main(int argc, char *argv[]) {
+  BlockWorld w;
+  w.rows = 3;  w.cols = 3;
+  w.block = 9;  w.corridor = 3;
+  bool lap = false;
+  double length = 200;                      // 走行距離[m]
+  size_t scanNum = 0;                       // スキャン数。0なら走行距離で決める
+  int beamNum = 1081;
+  double fov = 270;
+  double maxRange = 30;
+  double rangeNoise = 0.01;
+  double rate = 10;                         // スキャン周期[Hz]
+  double speed = 0.5;                       // 走行速度[m/s]
+  double turnRate = 45;                     // 旋回速度[度/s]
+  double odoErr = 0.05;                     // オドメトリの誤差の比率
+  double sweep = 0;                         // 1回の走査にかかる時間[s]
+  unsigned int seed = 1;
+  string gtFile;
+  const char *outFile = nullptr;
+
+  for (int i=1; i<argc; i++) {
+    const char *a = argv[i];
+    bool hasArg = (i+1 < argc);
+    if (strcmp(a, "-w") == 0 && hasArg)
+      sscanf(argv[++i], "%dx%d", &w.rows, &w.cols);
+    else if (strcmp(a, "-k") == 0 && hasArg)
+      sscanf(argv[++i], "%lf,%lf", &w.block, &w.corridor);
+    else if (strcmp(a, "-m") == 0 && hasArg)
+      lap = (strcmp(argv[++i], "lap") == 0);
+    else if (strcmp(a, "-L") == 0 && hasArg)
+      length = atof(argv[++i]);
+    else if (strcmp(a, "-N") == 0 && hasArg)
+      scanNum = strtoul(argv[++i], nullptr, 10);
+    else if (strcmp(a, "-b") == 0 && hasArg)
+      beamNum = atoi(argv[++i]);
+    else if (strcmp(a, "-f") == 0 && hasArg)
+      fov = atof(argv[++i]);
+    else if (strcmp(a, "-R") == 0 && hasArg)
+      maxRange = atof(argv[++i]);
+    else if (strcmp(a, "-n") == 0 && hasArg)
+      rangeNoise = atof(argv[++i]);
+    else if (strcmp(a, "-r") == 0 && hasArg)
+      rate = atof(argv[++i]);
+    else if (strcmp(a, "-v") == 0 && hasArg)
+      speed = atof(argv[++i]);
+    else if (strcmp(a, "-e") == 0 && hasArg)
+      odoErr = atof(argv[++i]);
+    else if (strcmp(a, "-S") == 0 && hasArg)
+      sweep = atof(argv[++i])/1000;
+    else if (strcmp(a, "-s") == 0 && hasArg)
+      seed = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+    else if (strcmp(a, "-g") == 0 && hasArg)
+      gtFile = argv[++i];
+    else if (a[0] != '-' && outFile == nullptr)
+      outFile = a;
+    else {
+      SLAM_LOGE("Error: invalid argument %s\n", a);
+      return(1);
+    }
+  }
+  if (outFile == nullptr || w.rows < 1 || w.cols < 1 || beamNum < 1 || rate <= 0 || speed <= 0) {
+    SLAM_LOGE("Usage: scan_sim [-w RxC] [-k block,corridor] [-m walk|lap] [-L length | -N scans] [-b beams] [-f fov] [-R range] [-n noise] [-r rate] [-v speed] [-e odoErr] [-S sweep_ms] [-s seed] [-g gt.txt] out.lsc\n");
+    return(1);
+  }
+
+  ScanSimulator sim;
+  sim.setBeam(beamNum, fov);
+  sim.setMaxRange(maxRange);
+  sim.setRangeNoise(rangeNoise);
+  sim.setSeed(seed);
+  makeBlockWorld(w, sim);
+
+  // 出発する交差点と、そこから外壁までの距離。出発時は通路に沿った向きなので、地図座標系の軸も壁に沿う
+  int si = lap? 0 : w.rows/2;
+  int sj = w.cols/2;
+  double sx = w.nodeX(sj);
+  double sy = w.nodeY(si);
+  double reach = max(max(sx - w.left, w.left + w.width - sx), max(sy - w.bottom, w.bottom + w.height - sy));
+  if (reach > MAP_REACH) {
+    SLAM_LOGE("Error: the world reaches %g m from the start (limit %g m). Use smaller -w or -k.\n", reach, MAP_REACH);
+    return(1);
+  }
+
+  FILE *fp = fopen(outFile, "w");
+  if (fp == nullptr) {
+    SLAM_LOGE("Error: cannot open %s\n", outFile);
+    return(1);
+  }
+  FILE *gfp = nullptr;
+  if (!gtFile.empty()) {
+    gfp = fopen(gtFile.c_str(), "w");
+    if (gfp == nullptr) {
+      SLAM_LOGE("Error: cannot open %s\n", gtFile.c_str());
+      fclose(fp);
+      return(1);
+    }
+  }
+
+  // 出発する交差点から、最初の通路の方向を向いて出発する
+  Route route(w, lap, seed, si, sj);
+  double gx, gy;
+  route.next(gx, gy);
+  Pose2D pose(sx, sy, RAD2DEG(atan2(gy - sy, gx - sx)));
+  Pose2D odo = pose;                        // オドメトリ値。真値から出発して誤差が積もる
+  Pose2D prev = pose;
+
+  double dt = 1.0/rate;
+  double step = speed*dt;                   // 1周期の移動量[m]
+  double turn = turnRate*dt;                // 1周期の旋回量[度]
+  if (scanNum == 0)
+    scanNum = static_cast<size_t>(length/step) + 1;
+
+  vector<double> ranges;
+  for (size_t cnt=0; cnt<scanNum; cnt++) {
+    Pose2D last = pose;                     // 前スキャンの真の位置
+    if (cnt > 0) {
+      // 次の交差点の方向を向いてから進む
+      double dth = MyUtil::add(RAD2DEG(atan2(gy - pose.ty, gx - pose.tx)), -pose.th);
+      if (fabs(dth) > 1.0E-6)
+        pose.th = MyUtil::add(pose.th, max(-turn, min(turn, dth)));
+      else {
+        double d = sqrt((gx - pose.tx)*(gx - pose.tx) + (gy - pose.ty)*(gy - pose.ty));
+        if (d <= step) {                    // 交差点に着いた
+          pose.tx = gx;
+          pose.ty = gy;
+          route.next(gx, gy);
+        }
+        else {
+          pose.tx += step*cos(DEG2RAD(pose.th));
+          pose.ty += step*sin(DEG2RAD(pose.th));
+        }
+      }
+      pose.calRmat();
+
+      // オドメトリ。真の相対移動に、移動量に比例した誤差を加える。角度は1mあたり5度にodoErrを掛けたものも加える
+      Pose2D rel;
+      Pose2D::calRelativePose(pose, prev, rel);
+      double dl = sqrt(rel.tx*rel.tx + rel.ty*rel.ty);
+      rel.tx += odoErr*dl*sim.gauss();
+      rel.ty += odoErr*dl*sim.gauss();
+      rel.th += odoErr*(fabs(rel.th) + 5*dl)*sim.gauss();
+      rel.calRmat();
+      Pose2D npose;
+      Pose2D::calGlobalPose(rel, odo, npose);
+      odo = npose;
+      prev = pose;
+    }
+
+    if (sweep > 0 && cnt > 0)
+      sim.makeSweptScan(last, pose, sweep/dt, ranges);
+    else
+      sim.makeScan(pose, ranges);
+
+    // SensorDataReaderの形式。方位はレーザスキャナの向きのオフセット（180度）を引いておく
+    long sec = static_cast<long>(cnt*dt);
+    long nsec = static_cast<long>((cnt*dt - sec)*1.0E9);
+    fprintf(fp, "LASERSCAN %lu %ld %ld %d", cnt, sec, nsec, beamNum);
+    for (int i=0; i<beamNum; i++)
+      fprintf(fp, " %g %.3f", sim.beamAngle(i) - 180, ranges[i]);
+    fprintf(fp, " %.4f %.4f %.5f\n", odo.tx, odo.ty, DEG2RAD(odo.th));
+
+    if (gfp != nullptr)
+      fprintf(gfp, "%lu %.6f %.6f %.6f\n", cnt, pose.tx, pose.ty, pose.th);
+  }
+
+  bool flag = (ferror(fp) == 0);
+  fclose(fp);
+  if (gfp != nullptr) {
+    flag = flag && (ferror(gfp) == 0);
+    fclose(gfp);
+  }
+  if (!flag) {
+    SLAM_LOGE("Error: failed to write %s\n", outFile);
+    return(1);
+  }
+
+  printf("scan_sim: %lu scans, %lu segments, %s\n", scanNum, sim.getSegmentNum(), outFile);
+  return(0);
+}
@@ -0,0 +1,723 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file slam_bench.cpp
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+// 記録データに対してSLAMを描画なしで実行し、処理速度と精度をJSONに出力するベンチマーク
+// 使い方: slam_bench [-c 構成] [-n スキャン数] [-b 上限] [-w 走査時間] [-m メモリ上限] [-a 確保回数上限] [-l 距離場] [-e ATE上限] [-j 並列数] [-o 出力JSON] [-t 軌跡ディレクトリ] [-v] [-r 参照軌跡] ログ ...
+//   -c  FrameworkCustomizerの構成。"ABCDEFGHIJK"のように並べるか"all"。既定は"I"
+//   -r  直後のログの参照軌跡。「番号 x y 角度[度]」の形式（LittleSLAM -bの_traj.txtと同じ）
+//   -n  各ログで処理する最大スキャン数（0なら全部）
+//   -b  1スキャンの処理時間の上限[ms]。超えそうなときは精度を落として間に合わせる（0なら上限なし）
+//   -w  1回の走査にかかる時間[ms]。スキャンの歪みを補正する（0なら補正しない）
+//   -m  部分地図の点群のメモリ上限[MB]。超えた分はカレントディレクトリのファイルに退避する（0なら上限なし）
+//   -a  定常状態での1スキャンあたりのヒープ確保回数（中央値）の上限。超えた実行があれば終了コード1にする（負なら検査しない）。既定はALLOC_LIMIT
+//   -l  LittleSLAM -mで作った距離場のファイル。SLAMのかわりに、この地図に対する位置推定を行う
+//   -e  ATEの上限[m]。参照軌跡で評価した実行のATEがこれを超えたら終了コード1にする（0なら検査しない）
+//   -j  同時に処理する実行（ログ1個×構成1個）の数。0なら計算機のスレッド数。既定は1で、1個ずつ順に処理する
+//   -t  推定軌跡を「<ログ名>_<構成>_traj.txt」、全体地図を「<ログ名>_<構成>_map.txt」としてこのディレクトリに出力する
+//   -v  確認用の表示をする
+// 慣らし期間（最初のALLOC_WARMUPスキャン）の後、1スキャンの処理で何回ヒープ確保をしたかもJSONのallocationsに出力する
+// 数えるのはoperator newによる確保だけで、mallocを直接呼ぶ確保（Eigenの整列確保など）は数えない
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#elif __linux__
+#include <sys/resource.h>
+#endif
+
+#include "SensorDataReader.h"
+#include "PointCloudMap.h"
+#include "LikelihoodField.h"
+#include "SlamFrontEnd.h"
+#include "FrameworkCustomizer.h"
+#include "StageProfiler.h"
+#include "SlamLog.h"
+#include "AllocCounter.h"
+#include "WorkStealingPool.h"
+
+#ifndef LITTLESLAM_VERSION
+#define LITTLESLAM_VERSION "unknown"
+#endif
+
+using namespace std;
+
+///////
+
+// ヒープ確保回数を数えるときに、慣らし期間とみなす最初のスキャン数。作業用の領域はこの間に大きさが決まる
+static const size_t ALLOC_WARMUP = 50;
+
+// 定常状態での1スキャンあたりのヒープ確保回数の中央値の上限
+// 姿勢グラフには1スキャンごとにノードとアークが増え、その隣接リストの確保が2回起きる。それ以外の確保が増えたら失敗にする
+// ループ閉じ込みや部分地図の切り替えのあるスキャンでは確保が多いので、平均でなく中央値で見る
+static const long ALLOC_LIMIT = 2;
+
+///////
+
+// 1回の実行（ログ1個×構成1個）の結果
+struct BenchRun
+{
+  string log;                      // ログファイル名
+  char config;                     // 構成（'A'〜'I'）
+  bool ok;                         // 正常に処理できたか
+  size_t scans;                    // 処理したスキャン数
+  double budget;                   // 1スキャンの処理時間の上限[s]。0なら上限なし
+  double sweep;                    // 歪み補正での1回の走査時間[s]。0なら補正しない
+  size_t memBudget;                // 部分地図の点群のメモリ上限[byte]。0なら上限なし
+  const LikelihoodField *field;    // 位置推定に使う静的地図の距離場。nullptrならSLAMを行う
+  string fieldFile;                // 距離場のファイル名
+  double wallTime;                 // 実行時間[s]
+  double logDuration;              // 処理したスキャンの記録時間（最後と最初の時刻の差）[s]。0なら時刻なし
+  size_t peakRss;                  // 最大常駐メモリ[byte]。0なら不明
+  unsigned long long loops;        // ループ閉じ込みの回数
+  size_t mapPoints;                // 全体地図の点数
+  vector<Pose2D> traj;             // 推定軌跡
+  string trajFile;                 // 推定軌跡を出力したファイル。空なら出力していない
+  string mapFile;                  // 全体地図を出力するファイル。空なら出力しない
+  StageProfiler prof;              // 処理段階ごとの処理時間
+  bool hasRef;                     // 参照軌跡で評価したか
+  size_t refMatched;               // 参照軌跡と対応づいたポーズ数
+  double ate;                      // 絶対軌跡誤差（並進のRMSE）[m]
+  double rpeTrans;                 // 相対位置誤差（1スキャン間、並進のRMSE）[m]
+  double rpeRot;                   // 相対位置誤差（1スキャン間、回転のRMSE）[度]
+  unsigned long long allocWarmup;  // 慣らし期間（最初のALLOC_WARMUPスキャン）のヒープ確保回数
+  unsigned long long allocSteady;  // 慣らし期間後のヒープ確保回数
+  size_t allocScans;               // 慣らし期間後に1回でもヒープ確保をしたスキャン数
+  unsigned long long allocMax;     // 慣らし期間後の1スキャンあたりの確保回数の最大
+  unsigned long long allocMedian;  // 慣らし期間後の1スキャンあたりの確保回数の中央値
+  vector<unsigned long long> allocCounts;  // 慣らし期間後の各スキャンの確保回数
+
+  BenchRun() : config('I'), ok(false), scans(0), budget(0), sweep(0), memBudget(0), field(nullptr), wallTime(0), logDuration(0), peakRss(0), loops(0), mapPoints(0),
+               hasRef(false), refMatched(0), ate(0), rpeTrans(0), rpeRot(0), allocWarmup(0), allocSteady(0), allocScans(0), allocMax(0), allocMedian(0) {
+  }
+};
+
+///////
+
+// 最大常駐メモリの計測をやり直す。Linuxではclear_refsで最大値を現在値に戻せる
+static void resetPeakRss() {
+#ifdef __linux__
+  FILE *fp = fopen("/proc/self/clear_refs", "w");
+  if (fp != nullptr) {
+    fputs("5", fp);
+    fclose(fp);
+  }
+#endif
+}
+
+// 最大常駐メモリ[byte]。取れなければ0
+static size_t getPeakRss() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS pmc;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+    return(pmc.PeakWorkingSetSize);
+  return(0);
+#elif __linux__
+  FILE *fp = fopen("/proc/self/status", "r");
+  if (fp != nullptr) {
+    char line[256];
+    size_t kb = 0;
+    while (fgets(line, sizeof(line), fp) != nullptr) {
+      if (strncmp(line, "VmHWM:", 6) == 0) {
+        kb = strtoul(line+6, nullptr, 10);
+        break;
+      }
+    }
+    fclose(fp);
+    if (kb > 0)
+      return(kb*1024);
+  }
+  struct rusage ru;                         // clear_refsが効かない場合はプロセス全体の最大値
+  if (getrusage(RUSAGE_SELF, &ru) == 0)
+    return(static_cast<size_t>(ru.ru_maxrss)*1024);
+  return(0);
+#else
+  return(0);
+#endif
+}
+
+///////
+
+// 軌跡ファイルを読む。各行は「番号 x y 角度[度]」
+static bool loadTrajectory(const string &path, map<size_t, Pose2D> &traj) {
+  FILE *fp = fopen(path.c_str(), "r");
+  if (fp == nullptr) {
+    SLAM_LOGE("Error: cannot open %s\n", path.c_str());
+    return(false);
+  }
+
+  char line[256];
+  while (fgets(line, sizeof(line), fp) != nullptr) {
+    unsigned long idx;
+    double x, y, th;
+    if (sscanf(line, "%lu %lf %lf %lf", &idx, &x, &y, &th) == 4)
+      traj[idx] = Pose2D(x, y, th);
+  }
+  fclose(fp);
+
+  return(!traj.empty());
+}
+
+static bool saveTrajectory(const string &path, const vector<Pose2D> &traj) {
+  FILE *fp = fopen(path.c_str(), "w");
+  if (fp == nullptr) {
+    SLAM_LOGE("Error: cannot open %s\n", path.c_str());
+    return(false);
+  }
+  for (size_t i=0; i<traj.size(); i++) {
+    const Pose2D &p = traj[i];
+    fprintf(fp, "%lu %.6f %.6f %.6f\n", i, p.tx, p.ty, p.th);
+  }
+  bool flag = (ferror(fp) == 0);
+  fclose(fp);
+  return(flag);
+}
+
+// 全体地図を出力する。各行は「x y 法線x 法線y」（LittleSLAM -bの_map.txtと同じ）
+static bool saveMap(const string &path, const vector<LPoint2D> &gmap) {
+  FILE *fp = fopen(path.c_str(), "w");
+  if (fp == nullptr) {
+    SLAM_LOGE("Error: cannot open %s\n", path.c_str());
+    return(false);
+  }
+  for (size_t i=0; i<gmap.size(); i++) {
+    const LPoint2D &lp = gmap[i];
+    fprintf(fp, "%.6f %.6f %.6f %.6f\n", lp.x, lp.y, lp.nx, lp.ny);
+  }
+  bool flag = (ferror(fp) == 0);
+  fclose(fp);
+  return(flag);
+}
+
+// ファイルの大きさ[byte]。開けなければ0
+static long fileSize(const string &path) {
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (fp == nullptr)
+    return(0);
+  long size = (fseek(fp, 0, SEEK_END) == 0)? ftell(fp) : 0;
+  fclose(fp);
+  return(max(size, 0L));
+}
+
+///////
+
+// 推定軌跡を参照軌跡と番号で対応づけて、ATEとRPEを求める
+// ATEは、推定軌跡を剛体変換で参照軌跡に最小二乗で合わせた後の並進誤差のRMSE
+static void evaluateTrajectory(const vector<Pose2D> &est, const map<size_t, Pose2D> &ref, BenchRun &run) {
+  vector<size_t> ids;                       // 両方にある番号
+  for (map<size_t, Pose2D>::const_iterator it=ref.begin(); it!=ref.end(); ++it) {
+    if (it->first < est.size())
+      ids.push_back(it->first);
+  }
+  run.refMatched = ids.size();
+  if (ids.empty())
+    return;
+  run.hasRef = true;
+
+  // 重心
+  double ex=0, ey=0, rx=0, ry=0;
+  for (size_t i=0; i<ids.size(); i++) {
+    const Pose2D &e = est[ids[i]];
+    const Pose2D &r = ref.find(ids[i])->second;
+    ex += e.tx; ey += e.ty;
+    rx += r.tx; ry += r.ty;
+  }
+  double n = static_cast<double>(ids.size());
+  ex /= n; ey /= n; rx /= n; ry /= n;
+
+  // 回転。重心を引いた点の相互共分散から求める
+  double sxx=0, sxy=0;
+  for (size_t i=0; i<ids.size(); i++) {
+    const Pose2D &e = est[ids[i]];
+    const Pose2D &r = ref.find(ids[i])->second;
+    double ax = e.tx - ex, ay = e.ty - ey;
+    double bx = r.tx - rx, by = r.ty - ry;
+    sxx += ax*bx + ay*by;
+    sxy += ax*by - ay*bx;
+  }
+  double a = atan2(sxy, sxx);
+  double c = cos(a), s = sin(a);
+
+  double sum=0;
+  for (size_t i=0; i<ids.size(); i++) {
+    const Pose2D &e = est[ids[i]];
+    const Pose2D &r = ref.find(ids[i])->second;
+    double ax = e.tx - ex, ay = e.ty - ey;
+    double dx = c*ax - s*ay + rx - r.tx;
+    double dy = s*ax + c*ay + ry - r.ty;
+    sum += dx*dx + dy*dy;
+  }
+  run.ate = sqrt(sum/n);
+
+  // RPE。隣り合う番号間の相対位置どうしの差
+  double sumT=0, sumR=0;
+  size_t m=0;
+  for (size_t i=1; i<ids.size(); i++) {
+    if (ids[i] != ids[i-1] + 1)
+      continue;
+    Pose2D relE, relR, err;
+    Pose2D::calRelativePose(est[ids[i]], est[ids[i-1]], relE);
+    Pose2D::calRelativePose(ref.find(ids[i])->second, ref.find(ids[i-1])->second, relR);
+    Pose2D::calRelativePose(relE, relR, err);
+    sumT += err.tx*err.tx + err.ty*err.ty;
+    sumR += err.th*err.th;
+    ++m;
+  }
+  if (m > 0) {
+    run.rpeTrans = sqrt(sumT/m);
+    run.rpeRot = sqrt(sumR/m);
+  }
+}
+
+///////
+
+// ログ1個を構成configで最後まで処理する。run.mapFileが空でなければ、全体地図をそこに出力する
+// run.memBudgetが0でなければ、部分地図の点群をその大きさまでメモリに置き、超えた分はファイルに退避する
+// run.fieldがあれば、地図は作らずにその距離場に対する位置推定を行う。点群地図には直前位置しか残らないので、軌跡はスキャンごとに取る
+// 他の実行と並列に処理するときは、最大常駐メモリがプロセス全体の値になるので、alone=falseとして測らない
+static bool runOne(const string &log, char config, size_t maxScans, double budget, double sweep, bool alone, BenchRun &run) {
+  run.log = log;
+  run.config = config;
+  run.budget = budget;
+  run.sweep = sweep;
+  bool flag = true;
+
+  // 構成ごとに作り直す。部品が大きいのでヒープに置く
+  SensorDataReader *sreader = new SensorDataReader();
+  SlamFrontEnd *sfront = new SlamFrontEnd();
+  FrameworkCustomizer *fcustom = new FrameworkCustomizer();
+
+  if (sreader->openScanFile(log.c_str())) {
+    fcustom->setSlamFrontEnd(sfront);
+    fcustom->makeFramework();
+    fcustom->customize(config);
+    sfront->setTimeBudget(budget);
+    fcustom->setDeskew(sweep);
+    if (run.memBudget > 0)
+      fcustom->setMemoryBudget(run.memBudget, 2, ".");
+    bool localizing = (run.field != nullptr);
+    if (localizing)
+      fcustom->setStaticMap(run.field);
+    PointCloudMap *pcmap = fcustom->getPointCloudMap();
+
+    if (alone)
+      resetPeakRss();
+    StageProfiler::setCurrent(&run.prof);
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+
+    size_t cnt = 0;
+    double stamp0 = 0;
+    Scan2D scan;
+    bool eof = sreader->loadScan(cnt, scan);
+    while (!eof && (maxScans == 0 || cnt < maxScans)) {
+      if (cnt == 0)
+        stamp0 = scan.stamp;
+      run.logDuration = scan.stamp - stamp0;
+      unsigned long long a0 = AllocCounter::getCount();
+      sfront->process(scan);
+      unsigned long long na = AllocCounter::getCount() - a0;        // このスキャンの処理でのヒープ確保回数
+      if (cnt < ALLOC_WARMUP)
+        run.allocWarmup += na;
+      else {
+        run.allocSteady += na;
+        run.allocScans += (na > 0);
+        run.allocMax = max(run.allocMax, na);
+        run.allocCounts.push_back(na);      // 確保回数を測り終えてから入れるので、この確保は数えない
+      }
+      if (localizing)
+        run.traj.push_back(pcmap->getLastPose());
+      ++cnt;
+      eof = sreader->loadScan(cnt, scan);
+      run.prof.endScan();
+    }
+    pcmap->makeExportMap();                 // 最後のスキャンまで入れた全体地図にする。退避した部分地図も入れる
+
+    run.wallTime = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    if (!run.allocCounts.empty()) {
+      vector<unsigned long long>::iterator mid = run.allocCounts.begin() + run.allocCounts.size()/2;
+      nth_element(run.allocCounts.begin(), mid, run.allocCounts.end());
+      run.allocMedian = *mid;
+    }
+    StageProfiler::setCurrent(nullptr);
+    run.peakRss = alone? getPeakRss() : 0;
+    sreader->closeScanFile();
+
+    run.ok = (cnt > 0);
+    run.scans = cnt;
+    run.loops = run.prof.getCounter(PC_LOOP_CLOSURE);
+    run.mapPoints = pcmap->globalMap.size();
+    if (!localizing)
+      run.traj = pcmap->poses;
+    if (run.ok && !run.mapFile.empty() && !saveMap(run.mapFile, pcmap->globalMap)) {
+      run.mapFile.clear();
+      flag = false;
+    }
+  }
+
+  delete fcustom;
+  delete sfront;
+  delete sreader;
+
+  return(flag);
+}
+
+///////
+
+// 文字列をJSONの文字列として出力する
+static void writeJsonString(FILE *fp, const string &s) {
+  fputc('"', fp);
+  for (size_t i=0; i<s.size(); i++) {
+    char c = s[i];
+    if (c == '"' || c == '\\')
+      fprintf(fp, "\\%c", c);
+    else if (static_cast<unsigned char>(c) < 0x20)
+      fprintf(fp, "\\u%04x", c);
+    else
+      fputc(c, fp);
+  }
+  fputc('"', fp);
+}
+
+// 全実行をまとめた結果
+struct BenchBatch
+{
+  size_t jobs;                     // 同時に処理した実行の数
+  double wallTime;                 // 全実行にかかった時間[s]
+  size_t stolen;                   // 他のスレッドから盗んで処理した実行の数
+  size_t peakRss;                  // プロセス全体の最大常駐メモリ[byte]。0なら不明
+  long allocLimit;                 // 定常状態での1スキャンあたりのヒープ確保回数（中央値）の上限。負なら検査しない
+  size_t allocOver;                // 上限を超えた実行の数
+  double ateLimit;                 // ATEの上限[m]。0なら検査しない
+  size_t ateOver;                  // 上限を超えた実行の数
+
+  BenchBatch() : jobs(1), wallTime(0), stolen(0), peakRss(0), allocLimit(ALLOC_LIMIT), allocOver(0), ateLimit(0), ateOver(0) {
+  }
+};
+
+static bool writeJson(const string &path, const vector<BenchRun*> &runs, const BenchBatch &batch) {
+  FILE *fp = fopen(path.c_str(), "w");
+  if (fp == nullptr) {
+    SLAM_LOGE("Error: cannot open %s\n", path.c_str());
+    return(false);
+  }
+
+  fprintf(fp, "{\n  \"version\": ");
+  writeJsonString(fp, LITTLESLAM_VERSION);
+
+  double runSum = 0;                        // 各実行の時間の和
+  size_t scanSum = 0;
+  for (size_t k=0; k<runs.size(); k++) {
+    runSum += runs[k]->wallTime;
+    scanSum += runs[k]->scans;
+  }
+  // 並列度は平均して同時に処理していた実行の数。コア数より多くすると、各実行の時間が延びるだけで処理量は増えない
+  fprintf(fp, ",\n  \"batch\": {\"jobs\": %lu, \"runs\": %lu, \"scans\": %lu, \"wall_s\": %.6f, \"scans_per_s\": %.3f, \"run_wall_sum_s\": %.6f, \"concurrency\": %.3f, \"stolen\": %lu, \"peak_rss_bytes\": %lu, \"alloc_limit\": %ld, \"alloc_over\": %lu, \"ate_limit_m\": %.6f, \"ate_over\": %lu}",
+          batch.jobs, runs.size(), scanSum, batch.wallTime, (batch.wallTime > 0)? scanSum/batch.wallTime : 0, runSum,
+          (batch.wallTime > 0)? runSum/batch.wallTime : 0, batch.stolen, batch.peakRss, batch.allocLimit, batch.allocOver, batch.ateLimit, batch.ateOver);
+  fprintf(fp, ",\n  \"runs\": [\n");
+  for (size_t k=0; k<runs.size(); k++) {
+    const BenchRun &r = *runs[k];
+    double sps = (r.wallTime > 0)? r.scans/r.wallTime : 0;
+    fprintf(fp, "    {\n      \"log\": ");
+    writeJsonString(fp, r.log);
+    fprintf(fp, ",\n      \"config\": \"%c\",\n      \"ok\": %s,\n", r.config, r.ok? "true" : "false");
+    fprintf(fp, "      \"scans\": %lu,\n      \"budget_ms\": %.3f,\n      \"wall_s\": %.6f,\n      \"scans_per_s\": %.3f,\n", r.scans, 1000*r.budget, r.wallTime, sps);
+    double rtf = (r.wallTime > 0)? r.logDuration/r.wallTime : 0;       // 1以上なら実時間で処理できている
+    fprintf(fp, "      \"log_duration_s\": %.6f,\n      \"realtime_factor\": %.3f,\n      \"sweep_ms\": %.3f,\n", r.logDuration, rtf, 1000*r.sweep);
+    fprintf(fp, "      \"mem_budget_bytes\": %lu,\n", r.memBudget);
+    fprintf(fp, "      \"field_file\": ");
+    if (r.field != nullptr)
+      writeJsonString(fp, r.fieldFile);
+    else
+      fprintf(fp, "null");
+    fprintf(fp, ",\n");
+    fprintf(fp, "      \"peak_rss_bytes\": %lu,\n      \"loop_closures\": %llu,\n      \"map_points\": %lu,\n", r.peakRss, r.loops, r.mapPoints);
+    if (!r.traj.empty()) {
+      const Pose2D &p = r.traj.back();
+      fprintf(fp, "      \"final_pose\": [%.6f, %.6f, %.6f],\n", p.tx, p.ty, p.th);
+    }
+    else
+      fprintf(fp, "      \"final_pose\": null,\n");
+    if (r.hasRef)
+      fprintf(fp, "      \"accuracy\": {\"matched\": %lu, \"ate_m\": %.6f, \"rpe_trans_m\": %.6f, \"rpe_rot_deg\": %.6f},\n",
+              r.refMatched, r.ate, r.rpeTrans, r.rpeRot);
+    else
+      fprintf(fp, "      \"accuracy\": null,\n");
+    fprintf(fp, "      \"traj_file\": ");
+    if (!r.trajFile.empty())
+      writeJsonString(fp, r.trajFile);
+    else
+      fprintf(fp, "null");
+    fprintf(fp, ",\n      \"map_file\": ");
+    if (!r.mapFile.empty())
+      writeJsonString(fp, r.mapFile);
+    else
+      fprintf(fp, "null");
+    fprintf(fp, ",\n");
+    size_t steadyScans = (r.scans > ALLOC_WARMUP)? r.scans - ALLOC_WARMUP : 0;
+    fprintf(fp, "      \"allocations\": {\"warmup_scans\": %lu, \"warmup\": %llu, \"steady\": %llu, \"steady_scans_with_alloc\": %lu, \"steady_mean_per_scan\": %.3f, \"steady_median_per_scan\": %llu, \"steady_max_per_scan\": %llu},\n",
+            ALLOC_WARMUP, r.allocWarmup, r.allocSteady, r.allocScans, (steadyScans > 0)? static_cast<double>(r.allocSteady)/steadyScans : 0, r.allocMedian, r.allocMax);
+
+    fprintf(fp, "      \"stages\": {\n");
+    for (int s=0; s<PS_NUM; s++) {
+      const StageHistogram &h = r.prof.getHistogram(static_cast<ProfStage>(s));
+      double mean = (h.getNum() > 0)? h.getSum()/h.getNum() : 0;
+      fprintf(fp, "        \"%s\": {\"scans\": %llu, \"total_ms\": %.6f, \"mean_ms\": %.6f, \"p50_ms\": %.6f, \"p99_ms\": %.6f, \"max_ms\": %.6f}%s\n",
+              StageProfiler::stageName(static_cast<ProfStage>(s)), h.getNum(), 1000*h.getSum(), 1000*mean,
+              1000*h.quantile(0.5), 1000*h.quantile(0.99), 1000*h.getMax(), (s < PS_NUM-1)? "," : "");
+    }
+    fprintf(fp, "      },\n      \"counters\": {\n");
+    for (int c=0; c<PC_NUM; c++) {
+      fprintf(fp, "        \"%s\": %llu%s\n", StageProfiler::counterName(static_cast<ProfCounter>(c)),
+              r.prof.getCounter(static_cast<ProfCounter>(c)), (c < PC_NUM-1)? "," : "");
+    }
+    fprintf(fp, "      }\n    }%s\n", (k+1 < runs.size())? "," : "");
+  }
+  fprintf(fp, "  ]\n}\n");
+
+  bool flag = (ferror(fp) == 0);
+  fclose(fp);
+  return(flag);
+}
+
+// ファイル名からディレクトリと拡張子を除く
+static string baseName(const string &path) {
+  string name(path);
+  size_t p = name.find_last_of("/\\");
+  if (p != string::npos)
+    name = name.substr(p+1);
+  size_t q = name.find_last_of('.');
+  if (q != string::npos && q > 0)
+    name = name.substr(0, q);
+  return(name);
+}
+
+///////
+
+int main(int argc, char *argv[]) {
+  string configs = "I";                     // 実行する構成
+  string outFile = "slam_bench.json";       // 結果のJSONファイル
+  string trajDir;                           // 推定軌跡の出力先。空なら出力しない
+  size_t maxScans = 0;                      // 各ログの最大スキャン数
+  double budget = 0;                        // 1スキャンの処理時間の上限[s]
+  double sweep = 0;                         // 歪み補正での1回の走査時間[s]
+  size_t memBudget = 0;                     // 部分地図の点群のメモリ上限[byte]
+  long allocLimit = ALLOC_LIMIT;            // 定常状態での1スキャンあたりのヒープ確保回数の上限
+  string fieldFile;                         // 位置推定に使う距離場のファイル。空ならSLAMを行う
+  double ateLimit = 0;                      // ATEの上限[m]
+  size_t jobs = 1;                          // 同時に処理する実行の数。0なら計算機のスレッド数
+  vector<string> logs;                      // ログファイル
+  vector<string> refs;                      // ログごとの参照軌跡。空なら評価しない
+  string nextRef;
+
+  SlamLog::setLevel(SLAM_LOG_WARN);         // 既定では確認用の表示をしない
+
+  for (int i=1; i<argc; i++) {
+    string a = argv[i];
+    bool hasArg = (i+1 < argc);
+    if (a == "-c" && hasArg)
+      configs = argv[++i];
+    else if (a == "-r" && hasArg)
+      nextRef = argv[++i];
+    else if (a == "-n" && hasArg)
+      maxScans = strtoul(argv[++i], nullptr, 10);
+    else if (a == "-b" && hasArg)
+      budget = atof(argv[++i])/1000;
+    else if (a == "-w" && hasArg)
+      sweep = atof(argv[++i])/1000;
+    else if (a == "-m" && hasArg)
+      memBudget = static_cast<size_t>(atof(argv[++i])*1024*1024);
+    else if (a == "-a" && hasArg)
+      allocLimit = strtol(argv[++i], nullptr, 10);
+    else if (a == "-l" && hasArg)
+      fieldFile = argv[++i];
+    else if (a == "-e" && hasArg)
+      ateLimit = atof(argv[++i]);
+    else if (a == "-j" && hasArg)
+      jobs = strtoul(argv[++i], nullptr, 10);
+    else if (a == "-o" && hasArg)
+      outFile = argv[++i];
+    else if (a == "-t" && hasArg)
+      trajDir = argv[++i];
+    else if (a == "-v")
+      SlamLog::setLevel(SLAM_LOG_DEBUG);
+    else if (a[0] == '-') {
+      SLAM_LOGE("Error: invalid option %s\n", a.c_str());
+      return(1);
+    }
+    else {
+      logs.push_back(a);
+      refs.push_back(nextRef);
+      nextRef.clear();
+    }
+  }
+  if (logs.empty()) {
+    SLAM_LOGE("Usage: slam_bench [-c configs] [-n maxScans] [-b budget_ms] [-w sweep_ms] [-m budget_mb] [-a alloc_limit] [-l field.bin] [-e ate_limit_m] [-j jobs] [-o out.json] [-t trajDir] [-v] [-r ref] log ...\n");
+    return(1);
+  }
+  if (configs == "all")
+    configs = "ABCDEFGHIJK";
+  for (size_t k=0; k<configs.size(); k++) {
+    if (configs[k] < 'A' || configs[k] > 'K') {
+      SLAM_LOGE("Error: invalid config %c\n", configs[k]);
+      return(1);
+    }
+  }
+
+  LikelihoodField field;                    // 位置推定に使う距離場。全実行で共用し、読むだけ
+  if (!fieldFile.empty() && !field.load(fieldFile))
+    return(1);
+
+  bool allOk = true;
+  vector<map<size_t, Pose2D> > refTrajs(logs.size());      // ログごとの参照軌跡
+  for (size_t i=0; i<logs.size(); i++) {
+    if (!refs[i].empty() && !loadTrajectory(refs[i], refTrajs[i]))
+      allOk = false;
+  }
+
+  // 実行の一覧。結果は処理した順によらず、ログ×構成の順に並べる
+  vector<BenchRun*> runs;
+  vector<size_t> runLog;                    // 実行ごとのログの番号
+  vector<long> runSize;                     // 実行ごとのログファイルの大きさ
+  for (size_t i=0; i<logs.size(); i++) {
+    long size = fileSize(logs[i]);
+    for (size_t k=0; k<configs.size(); k++) {
+      BenchRun *run = new BenchRun();
+      run->log = logs[i];
+      run->config = configs[k];
+      run->memBudget = memBudget;
+      if (!fieldFile.empty()) {
+        run->field = &field;
+        run->fieldFile = fieldFile;
+      }
+      if (!trajDir.empty())
+        run->mapFile = trajDir + "/" + baseName(logs[i]) + "_" + configs[k] + "_map.txt";
+      runs.push_back(run);
+      runLog.push_back(i);
+      runSize.push_back(size);
+    }
+  }
+
+  // 大きいログの実行から先に配る。短い実行が後に残るので、空いたスレッドがそれを盗んで最後まで均せる
+  vector<size_t> order;
+  for (size_t n=0; n<runs.size(); n++)
+    order.push_back(n);
+  stable_sort(order.begin(), order.end(), [&runSize](size_t a, size_t b) {return (runSize[a] > runSize[b]);});
+
+  if (jobs == 0)
+    jobs = WorkStealingPool::defaultThreadNum();
+  jobs = min(jobs, runs.size());
+  bool alone = (jobs == 1);                 // 1個ずつなら、実行ごとに最大常駐メモリを測れる
+  vector<char> runOk(runs.size(), 1);       // 実行ごとの成否。スレッドごとに別の要素に書く
+  vector<function<void()> > tasks;
+  for (size_t m=0; m<order.size(); m++) {
+    size_t n = order[m];
+    tasks.push_back([&, n]() {
+      BenchRun &run = *runs[n];
+      const map<size_t, Pose2D> &ref = refTrajs[runLog[n]];
+      if (!runOne(run.log, run.config, maxScans, budget, sweep, alone, run))
+        runOk[n] = 0;
+      if (!run.ok) {
+        SLAM_LOGE("Error: %s (%c) failed\n", run.log.c_str(), run.config);
+        runOk[n] = 0;
+        return;
+      }
+      if (!ref.empty())
+        evaluateTrajectory(run.traj, ref, run);
+      if (!trajDir.empty()) {
+        string path = trajDir + "/" + baseName(run.log) + "_" + run.config + "_traj.txt";
+        if (saveTrajectory(path, run.traj))
+          run.trajFile = path;
+        else
+          runOk[n] = 0;
+      }
+    });
+  }
+
+  WorkStealingPool pool(jobs);
+  BenchBatch batch;
+  batch.jobs = pool.getThreadNum();
+  chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+  pool.run(tasks);
+  batch.wallTime = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+  batch.stolen = pool.getStolenNum();
+  batch.peakRss = getPeakRss();             // 1個ずつ処理したときは実行ごとに測り直しているので、その最大にする
+  for (size_t n=0; alone && n<runs.size(); n++)
+    batch.peakRss = max(batch.peakRss, runs[n]->peakRss);
+  for (size_t n=0; n<runs.size(); n++) {
+    if (!runOk[n])
+      allOk = false;
+  }
+
+  // 定常状態でのヒープ確保が増えていないかを調べる
+  batch.allocLimit = allocLimit;
+  for (size_t n=0; allocLimit >= 0 && n<runs.size(); n++) {
+    const BenchRun &r = *runs[n];
+    if (r.allocCounts.empty() || r.allocMedian <= static_cast<unsigned long long>(allocLimit))
+      continue;
+    SLAM_LOGE("Error: %s (%c) allocates %llu times per scan in steady state (limit %ld)\n", r.log.c_str(), r.config, r.allocMedian, allocLimit);
+    ++batch.allocOver;
+    allOk = false;
+  }
+
+  // 推定軌跡が参照軌跡から外れていないかを調べる。位置推定で見失ったままになると大きくなる
+  batch.ateLimit = ateLimit;
+  for (size_t n=0; ateLimit > 0 && n<runs.size(); n++) {
+    const BenchRun &r = *runs[n];
+    if (!r.hasRef || r.ate <= ateLimit)
+      continue;
+    SLAM_LOGE("Error: %s (%c) has ATE %g m (limit %g m)\n", r.log.c_str(), r.config, r.ate, ateLimit);
+    ++batch.ateOver;
+    allOk = false;
+  }
+
+  // 結果の一覧
+  printf("%-24s %3s %7s %9s %9s %9s %9s %6s %9s %9s\n", "log", "cfg", "scans", "scans/s", "p50[ms]", "p99[ms]", "RSS[MB]", "loops", "ATE[m]", "RPE[m]");
+  for (size_t k=0; k<runs.size(); k++) {
+    const BenchRun &r = *runs[k];
+    const StageHistogram &h = r.prof.getHistogram(PS_PROCESS);
+    double sps = (r.wallTime > 0)? r.scans/r.wallTime : 0;
+    printf("%-24s %3c %7lu %9.1f %9.3f %9.3f %9.1f %6llu ", baseName(r.log).c_str(), r.config, r.scans, sps,
+           1000*h.quantile(0.5), 1000*h.quantile(0.99), r.peakRss/(1024.0*1024.0), r.loops);
+    if (r.hasRef)
+      printf("%9.4f %9.4f\n", r.ate, r.rpeTrans);
+    else
+      printf("%9s %9s\n", "-", "-");
+  }
+
+  size_t scanSum = 0;
+  for (size_t k=0; k<runs.size(); k++)
+    scanSum += runs[k]->scans;
+  printf("jobs=%lu, wall=%.2f[s], scans/s=%.1f, stolen=%lu, peak RSS=%.1f[MB]\n", batch.jobs, batch.wallTime,
+         (batch.wallTime > 0)? scanSum/batch.wallTime : 0, batch.stolen, batch.peakRss/(1024.0*1024.0));
+
+  if (!writeJson(outFile, runs, batch))
+    allOk = false;
+  else
+    printf("Results: %s\n", outFile.c_str());
+
+  for (size_t k=0; k<runs.size(); k++)
+    delete runs[k];
+
+  return(allOk? 0 : 1);
+}
@@ -0,0 +1,178 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file slam_stream.cpp
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+// SlamStreamの動作確認用。パイプやFIFOからLASERSCAN形式のデータを読んで、逐次SLAMに投入する
+// 使い方: slam_stream [-c 構成] [-q キュー長] [-d oldest|newest] [-r 周期] [-R 倍速] [-b 上限] [-o 結果ファイル] [-v] 入力
+//   入力が"-"なら標準入力から読む。例: scan_sim -N 1000 /dev/stdout | slam_stream -r 10 -
+//   -r  センサの周期[Hz]を模擬して、その間隔で投入する（0なら読んだらすぐ投入）
+//   -R  ログに記録された時刻の間隔で投入する（再生）。引数は再生速度で、1なら記録と同じ速さ。-rより優先する
+//   -b  1スキャンの処理時間の上限[ms]。超えそうなときは精度を落として間に合わせる
+//   -o  スキャンごとに「番号 時刻 x y 角度[度] 遅延[ms] 待ち[ms] 処理[ms] 縮退」を出力する
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <chrono>
+#include <thread>
+
+#include "SensorDataReader.h"
+#include "SlamFrontEnd.h"
+#include "SlamStream.h"
+#include "FrameworkCustomizer.h"
+#include "StageProfiler.h"
+#include "SlamLog.h"
+
+using namespace std;
+
+///////
+
+// 取り出した結果をファイルに書く
+static void writeResults(SlamStream &stream, FILE *fp) {
+  StreamResult r;
+  while (stream.popResult(r)) {
+    if (fp != nullptr)
+      fprintf(fp, "%d %.6f %.6f %.6f %.6f %.3f %.3f %.3f %u\n", r.sid, r.stamp, r.pose.tx, r.pose.ty, r.pose.th,
+              1000*r.latency, 1000*r.queueTime, 1000*r.procTime, r.degrade);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  char config = 'I';
+  size_t capacity = 4;
+  StreamDropPolicy policy = DROP_OLDEST;
+  double rate = 0;
+  double speed = 0;                         // 再生速度。0なら記録時刻に合わせない
+  double budget = 0;                        // 1スキャンの処理時間の上限[s]
+  string outFile;
+  const char *input = nullptr;
+
+  SlamLog::setLevel(SLAM_LOG_WARN);
+
+  for (int i=1; i<argc; i++) {
+    const char *a = argv[i];
+    bool hasArg = (i+1 < argc);
+    if (strcmp(a, "-c") == 0 && hasArg)
+      config = argv[++i][0];
+    else if (strcmp(a, "-q") == 0 && hasArg)
+      capacity = strtoul(argv[++i], nullptr, 10);
+    else if (strcmp(a, "-d") == 0 && hasArg)
+      policy = (strcmp(argv[++i], "newest") == 0)? DROP_NEWEST : DROP_OLDEST;
+    else if (strcmp(a, "-r") == 0 && hasArg)
+      rate = atof(argv[++i]);
+    else if (strcmp(a, "-R") == 0 && hasArg)
+      speed = atof(argv[++i]);
+    else if (strcmp(a, "-b") == 0 && hasArg)
+      budget = atof(argv[++i])/1000;
+    else if (strcmp(a, "-o") == 0 && hasArg)
+      outFile = argv[++i];
+    else if (strcmp(a, "-v") == 0)
+      SlamLog::setLevel(SLAM_LOG_DEBUG);
+    else if (input == nullptr && (a[0] != '-' || a[1] == '\0'))
+      input = a;
+    else {
+      SLAM_LOGE("Error: invalid argument %s\n", a);
+      return(1);
+    }
+  }
+  if (input == nullptr) {
+    SLAM_LOGE("Usage: slam_stream [-c config] [-q capacity] [-d oldest|newest] [-r rate] [-R speed] [-b budget_ms] [-o results.txt] [-v] input|-\n");
+    return(1);
+  }
+
+  SensorDataReader sreader;
+  if (!sreader.openScanFile((strcmp(input, "-") == 0)? "/dev/stdin" : input))
+    return(1);
+
+  FILE *fp = nullptr;
+  if (!outFile.empty()) {
+    fp = fopen(outFile.c_str(), "w");
+    if (fp == nullptr) {
+      SLAM_LOGE("Error: cannot open %s\n", outFile.c_str());
+      return(1);
+    }
+  }
+
+  SlamFrontEnd sfront;
+  FrameworkCustomizer fcustom;
+  fcustom.setSlamFrontEnd(&sfront);
+  fcustom.makeFramework();
+  if (!fcustom.customize(config)) {
+    SLAM_LOGE("Error: invalid config %c\n", config);
+    return(1);
+  }
+  sfront.setTimeBudget(budget);
+
+  StageProfiler prof;
+  SlamStream stream;
+  stream.setSlamFrontEnd(&sfront);
+  stream.setCapacity(capacity);
+  stream.setDropPolicy(policy);
+  stream.setProfiler(&prof);
+  if (!stream.start())
+    return(1);
+
+  chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+  chrono::steady_clock::time_point next = t0;
+  size_t cnt = 0;
+  double stamp0 = 0, stampN = 0;            // 最初と最後のスキャンの記録時刻
+  Scan2D scan;
+  bool eof = sreader.loadScan(cnt, scan);
+  while (!eof) {
+    if (cnt == 0)
+      stamp0 = scan.stamp;
+    stampN = scan.stamp;
+
+    if (speed > 0) {                        // 記録時刻の間隔で投入する
+      next = t0 + chrono::microseconds(static_cast<long long>(1.0E6*(scan.stamp - stamp0)/speed));
+      this_thread::sleep_until(next);
+    }
+    else if (rate > 0) {                    // センサの周期を模擬する
+      next += chrono::microseconds(static_cast<long long>(1.0E6/rate));
+      this_thread::sleep_until(next);
+    }
+
+    double stamp = scan.stamp;              // 時刻が記録されていなければ、投入した時刻を使う
+    if (stamp0 == 0 && stampN == 0)
+      stamp = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    stream.pushScan(scan, stamp);
+    writeResults(stream, fp);
+    ++cnt;
+    eof = sreader.loadScan(cnt, scan);
+  }
+  sreader.closeScanFile();
+
+  stream.stop(true);                        // 残りを処理してから止める
+  writeResults(stream, fp);
+  if (fp != nullptr)
+    fclose(fp);
+
+  double wall = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+  StageHistogram lat = stream.getLatencyHistogram();
+  printf("slam_stream: pushed=%lu, processed=%lu, dropped=%lu, wall=%.3f s\n", cnt, stream.getProcessed(), stream.getDropped(), wall);
+  double duration = stampN - stamp0;        // ログの記録時間
+  if (duration > 0 && wall > 0)
+    printf("log duration=%.3f s, realtime factor=%.3f\n", duration, duration/wall);
+  printf("latency[ms]: p50=%.3f, p99=%.3f, max=%.3f, mean=%.3f\n", 1000*lat.quantile(0.5), 1000*lat.quantile(0.99),
+         1000*lat.getMax(), (lat.getNum() > 0)? 1000*lat.getSum()/lat.getNum() : 0);
+  Pose2D p = fcustom.getPointCloudMap()->getLastPose();
+  printf("last pose: %g %g %g\n", p.tx, p.ty, p.th);
+  if (budget > 0) {
+    printf("degraded scans: icpIteration=%llu, icpDeadline=%llu, resample=%llu, skipGlobalMap=%llu\n",
+           prof.getCounter(PC_DEGRADE_ICP_ITER), prof.getCounter(PC_DEGRADE_ICP_DEADLINE),
+           prof.getCounter(PC_DEGRADE_RESAMPLE), prof.getCounter(PC_DEGRADE_SKIP_GLOBALMAP));
+  }
+
+  return(0);
+}
@@ -31,6 +31,25 @@ void FrameworkCustomizer::makeFramework() {
   sfront->setScanMatcher(&smat);
 }
 
+// 文字cで指定した構成にする。'A'ならcustomizeA()。該当するものがなければfalseを返す
+bool FrameworkCustomizer::customize(char c) {
+  switch (c) {
+    case 'A': customizeA(); break;
+    case 'B': customizeB(); break;
+    case 'C': customizeC(); break;
+    case 'D': customizeD(); break;
+    case 'E': customizeE(); break;
+    case 'F': customizeF(); break;
+    case 'G': customizeG(); break;
+    case 'H': customizeH(); break;
+    case 'I': customizeI(); break;
+    case 'J': customizeJ(); break;
+    case 'K': customizeK(); break;
+    default: return(false);
+  }
+  return(true);
+}
+
 /////// 実験用
 
 // フレームワーク基本構成
@@ -221,3 +240,60 @@ void FrameworkCustomizer::customizeI() {
   sfront->setPointCloudMap(pcmap);
   sfront->setDgCheck(true);                        // センサ融合する
 }
+
+// 構成Iのスキャンマッチングを、距離場のコスト関数で行う。ICPの繰り返しごとのデータ対応づけがなくなる
+// 処理時間の上限による繰り返し回数の制限と締切は、poestDirectからガウス・ニュートン法の繰り返しに渡る
+// ループ検出は構成Iと同じく、データ対応づけと垂直距離のコスト関数で行う
+void FrameworkCustomizer::customizeJ() {
+  pcmap = &pcmapLP;                                // 部分地図ごとに管理する点群地図
+  RefScanMaker *rsm = &rsmLM;                      // 局所地図を参照スキャンとする
+  DataAssociator *dass = &dassGT;                  // 格子テーブルによるデータ対応づけ。センサ融合とループ検出で使う
+  CostFunctionLF *cfunc = &cfuncLF;                // 部分地図ごとの距離場をコスト関数とする
+  PoseOptimizer *popt = &poptDirect;               // コスト関数が微分を返すので、ガウス・ニュートン法で最適化する
+  LoopDetector *lpd = &lpdSS;                      // 部分地図を用いたループ検出
+
+  cfunc->setPointCloudMap(&pcmapLP);
+  popt->setCostFunction(cfunc);
+  poestDirect.setDataAssociator(dass);
+  poestDirect.setPoseOptimizer(popt);
+  poptSL.setCostFunction(&cfuncPD);                // ループ検出のICP用
+  poest.setDataAssociator(dass);
+  poest.setPoseOptimizer(&poptSL);
+  pfu.setDataAssociator(dass);
+  smat.setPoseEstimator(&poestDirect);
+  smat.setPointCloudMap(pcmap);
+  smat.setRefScanMaker(rsm);
+  smat.setScanPointResampler(&spres);
+  smat.setScanPointAnalyser(&spana);
+  sfront->setLoopDetector(lpd);
+  sfront->setPointCloudMap(pcmap);
+  sfront->setDgCheck(true);                        // センサ融合する
+}
+
+// 構成Iのスキャンマッチングを、NDTのコスト関数で行う。1点の評価はセルの正規分布を引くだけなので、局所地図の点数によらない
+// 構成Jと同じく、処理時間の上限による繰り返し回数の制限と締切は、poestDirectからニュートン法の繰り返しに渡る
+// ループ検出は構成Iと同じく、データ対応づけと垂直距離のコスト関数で行う
+void FrameworkCustomizer::customizeK() {
+  pcmap = &pcmapLP;                                // 部分地図ごとに管理する点群地図
+  RefScanMaker *rsm = &rsmLM;                      // 局所地図を参照スキャンとする
+  DataAssociator *dass = &dassGT;                  // 格子テーブルによるデータ対応づけ。センサ融合とループ検出で使う
+  CostFunction *cfunc = &cfuncNDT;                 // 局所地図のセルごとの正規分布をコスト関数とする
+  PoseOptimizer *popt = &poptDirect;               // コスト関数が勾配とヘッセ行列を返すので、ニュートン法で最適化する
+  LoopDetector *lpd = &lpdSS;                      // 部分地図を用いたループ検出
+
+  popt->setCostFunction(cfunc);
+  poestDirect.setDataAssociator(dass);
+  poestDirect.setPoseOptimizer(popt);
+  poptSL.setCostFunction(&cfuncPD);                // ループ検出のICP用
+  poest.setDataAssociator(dass);
+  poest.setPoseOptimizer(&poptSL);
+  pfu.setDataAssociator(dass);
+  smat.setPoseEstimator(&poestDirect);
+  smat.setPointCloudMap(pcmap);
+  smat.setRefScanMaker(rsm);
+  smat.setScanPointResampler(&spres);
+  smat.setScanPointAnalyser(&spana);
+  sfront->setLoopDetector(lpd);
+  sfront->setPointCloudMap(pcmap);
+  sfront->setDgCheck(true);                        // センサ融合する
+}
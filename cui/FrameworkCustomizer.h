@@ -26,6 +26,8 @@
 #include "CostFunction.h" 
 #include "CostFunctionED.h" 
 #include "CostFunctionPD.h" 
+#include "CostFunctionLF.h" 
+#include "CostFunctionNDT.h" 
 #include "PoseOptimizer.h" 
 #include "PoseOptimizerSD.h" 
 #include "PoseOptimizerSL.h" 
@@ -38,6 +40,7 @@
 #include "ScanPointResampler.h"
 #include "ScanPointAnalyser.h"
 #include "PoseEstimatorICP.h" 
+#include "PoseEstimatorLF.h" 
 #include "PoseFuser.h" 
 #include "ScanMatcher2D.h" 
 #include "SlamFrontEnd.h" 
@@ -51,6 +54,8 @@ class FrameworkCustomizer
   DataAssociatorGT dassGT;
   CostFunctionED cfuncED;
   CostFunctionPD cfuncPD;
+  CostFunctionLF cfuncLF;
+  CostFunctionNDT cfuncNDT;
   PoseOptimizerSD poptSD;
   PoseOptimizerSL poptSL;
   PointCloudMapBS pcmapBS;
@@ -59,10 +64,14 @@ class FrameworkCustomizer
   PointCloudMap *pcmap;            // SlamLauncherで参照するためメンバ変数にする
   LoopDetector lpdDM;              // ダミー。何もしない
   LoopDetectorSS lpdSS;
+  ScanDeskewer sdes;
   ScanPointResampler spres;
   ScanPointAnalyser spana;
 
   PoseEstimatorICP poest;
+  PoseEstimatorICP poestDirect;    // 対応づけを使わないコスト関数（距離場、NDT）のスキャンマッチング用。ループ検出はpoestを使う
+  PoseOptimizerSL poptDirect;
+  PoseEstimatorLF lfest;
   PoseFuser pfu;
   ScanMatcher2D smat;
   SlamFrontEnd *sfront;
@@ -82,9 +91,33 @@ public:
     return(pcmap);
   }
 
+  // 部分地図の点群のメモリ上限を設定する。超えた分はdirにファイルとして退避する
+  void setMemoryBudget(size_t budget, size_t horizon, const char *dir) {
+    pcmapLP.setMemoryBudget(budget, horizon, dir);
+  }
+
+  // スキャンマッチングで残す、直近のロボット位置の共分散（確認用）の個数を設定する
+  void setPoseCovCapacity(size_t n) {
+    smat.setPoseCovCapacity(n);
+  }
+
+  // 作成済みの地図の距離場fieldとの照合で、位置推定だけを行う。nullptrならSLAMを行う
+  // スキャンの前処理は構成のものを使い、地図の成長、ポーズグラフ、ループ検出は行わない
+  void setStaticMap(const LikelihoodField *field) {
+    lfest.setField(field);
+    smat.setFieldEstimator((field != nullptr)? &lfest : nullptr);
+  }
+
+  // 1回の走査にかかる時間sweepTime[s]を与えて、スキャンの歪み補正を行う。0なら補正しない
+  void setDeskew(double sweepTime) {
+    sdes.setSweepTime(sweepTime);
+    smat.setScanDeskewer((sweepTime > 0)? &sdes : nullptr);
+  }
+
 //////
 
   void makeFramework();
+  bool customize(char c);
   void customizeA();
   void customizeB();
   void customizeC();
@@ -94,6 +127,8 @@ public:
   void customizeG();
   void customizeH();
   void customizeI();
+  void customizeJ();
+  void customizeK();
 };
 
 #endif
@@ -13,26 +13,38 @@
  ****************************************************************************/
 
 #include <boost/algorithm/string/predicate.hpp>
-#include <boost/timer.hpp>
 #include "SlamLauncher.h"
+#include "SlamLog.h"
 #include "ScanPointResampler.h"
 
 using namespace std;                       // C++標準ライブラリの名前空間を使う
 
 //////////
 
-void SlamLauncher::run() {
-  mdrawer.initGnuplot();                   // gnuplot初期化
-  mdrawer.setAspectRatio(-0.9);            // x軸とy軸の比（負にすると中身が一定）
+// SLAMを実行する。headlessのときは、結果をファイルに出力して、成功したかを返す
+bool SlamLauncher::run() {
+  if (!headless) {
+    mdrawer.initGnuplot();                 // gnuplot初期化
+    mdrawer.setAspectRatio(-0.9);          // x軸とy軸の比（負にすると中身が一定）
+  }
   
   size_t cnt = 0;                          // 処理の論理時刻
   if (startN > 0)
     skipData(startN);                      // startNまでデータを読み飛ばす
 
-  double totalTime=0, totalTimeDraw=0, totalTimeRead=0;
+  string ckptFile = outBase + "_ckpt.bin";
   Scan2D scan;
+  if (resume) {                            // チェックポイントの次のスキャンから続ける
+    if (!ckpt.load(sfront, ckptFile))
+      return(false);
+    cnt = sfront.getCnt();
+    bool eof = false;
+    for (size_t i=0; i<cnt && !eof; i++)
+      eof = sreader.loadScan(i, scan);     // 処理済みのスキャンを読み飛ばす
+  }
+
+  StageProfiler::setCurrent(&profiler);    // 処理時間をprofilerに記録する
   bool eof = sreader.loadScan(cnt, scan);  // ファイルからスキャンを1個読み込む
-  boost::timer tim;
   while(!eof) {
     if (odometryOnly) {                      // オドメトリによる地図構築（SLAMより優先）
       if (cnt == 0) {
@@ -41,30 +53,46 @@ void SlamLauncher::run() {
       }
       mapByOdometry(&scan);
     }
-    else 
+    else {
       sfront.process(scan);                // SLAMによる地図構築
+      if (ckptInterval > 0 && sfront.getCnt()%ckptInterval == 0)
+        ckpt.saveAsync(sfront, ckptFile);  // 状態を写したらすぐ戻る
+    }
 
-    double t1 = 1000*tim.elapsed();
-
-    if (cnt%drawSkip == 0) {               // drawSkipおきに結果を描画
+    if (!headless && cnt%drawSkip == 0) {  // drawSkipおきに結果を描画
+      StageTimer st(PS_DRAW);
       mdrawer.drawMapGp(*pcmap);
     }
-    double t2 = 1000*tim.elapsed();
 
     ++cnt;                                 // 論理時刻更新
     eof = sreader.loadScan(cnt, scan);     // 次のスキャンを読み込む
+    profiler.endScan();                    // 1スキャン分の処理時間を集計
 
-    double t3 = 1000*tim.elapsed();
-    totalTime = t3;                        // 全体処理時間
-    totalTimeDraw += (t2-t1);              // 描画時間の合計
-    totalTimeRead += (t3-t2);              // ロード時間の合計
-
-    printf("---- SlamLauncher: cnt=%lu ends ----\n", cnt);
+    SLAM_LOGD("---- SlamLauncher: cnt=%lu ends ----\n", cnt);
   }
   sreader.closeScanFile();
+  StageProfiler::setCurrent(nullptr);
+  ckpt.wait();                             // チェックポイントの書き出しを終えておく
+
+  double totalTimeMap = 1000*profiler.getHistogram(PS_PROCESS).getSum();    // 地図構築時間の合計[ms]
+  double totalTimeDraw = 1000*profiler.getHistogram(PS_DRAW).getSum();      // 描画時間の合計[ms]
+  double totalTimeRead = 1000*profiler.getHistogram(PS_READ).getSum();      // ロード時間の合計[ms]
+  SLAM_LOGI("Elapsed time: mapping=%g, drawing=%g, reading=%g\n", totalTimeMap, totalTimeDraw, totalTimeRead);
+  profiler.printSummary();
+
+  if (headless) {                          // 描画しない場合は、結果を出力して終わる
+    profiler.writeCsv(outBase + "_prof.csv");               // 処理時間の集計結果もファイルに残す
+    profiler.writeJson(outBase + "_prof.json");
+    bool flag = (cnt > 0);
+    if (!flag)
+      SLAM_LOGE("Error: no scan processed.\n");
+    else
+      flag = saveResults();
+    SLAM_LOGI("SlamLauncher finished.\n");
+    return(flag);
+  }
 
-  printf("Elapsed time: mapping=%g, drawing=%g, reading=%g\n", (totalTime-totalTimeDraw-totalTimeRead), totalTimeDraw, totalTimeRead);
-  printf("SlamLauncher finished.\n");
+  SLAM_LOGI("SlamLauncher finished.\n");
 
   // 処理終了後も描画画面を残すためにsleepで無限ループにする。ctrl-Cで終了。
   while(true) {
@@ -76,6 +104,103 @@ void SlamLauncher::run() {
   }
 }
 
+// ロボット軌跡と地図をファイルに出力する
+// 軌跡は<outBase>_traj.txtに「番号 x y 角度[度]」、地図は<outBase>_map.txtに「x y 法線x 法線y」の形式
+bool SlamLauncher::saveResults() {
+  pcmap->makeExportMap();                  // 最後のスキャンまで入れた全体地図にする。退避した部分地図も入れる
+
+  string trajFile = outBase + "_traj.txt";
+  FILE *fp = fopen(trajFile.c_str(), "w");
+  if (fp == nullptr) {
+    SLAM_LOGE("Error: cannot open %s\n", trajFile.c_str());
+    return(false);
+  }
+  const vector<Pose2D> &poses = pcmap->poses;
+  for (size_t i=0; i<poses.size(); i++) {
+    const Pose2D &p = poses[i];
+    fprintf(fp, "%lu %.6f %.6f %.6f\n", i, p.tx, p.ty, p.th);
+  }
+  bool flag = (ferror(fp) == 0);
+  fclose(fp);
+
+  string mapFile = outBase + "_map.txt";
+  fp = fopen(mapFile.c_str(), "w");
+  if (fp == nullptr) {
+    SLAM_LOGE("Error: cannot open %s\n", mapFile.c_str());
+    return(false);
+  }
+  const vector<LPoint2D> &gmap = pcmap->globalMap;
+  for (size_t i=0; i<gmap.size(); i++) {
+    const LPoint2D &lp = gmap[i];
+    fprintf(fp, "%.6f %.6f %.6f %.6f\n", lp.x, lp.y, lp.nx, lp.ny);
+  }
+  flag = flag && (ferror(fp) == 0);
+  fclose(fp);
+
+  SLAM_LOGI("Results: %s (%lu poses), %s (%lu points)\n", trajFile.c_str(), poses.size(), mapFile.c_str(), gmap.size());
+
+  if (makeField && flag) {                 // 位置推定用に、全体地図の距離場を作っておく
+    LikelihoodField field;
+    field.build(gmap, 0.05, 0.5);          // セル5cm、距離は50cmで打ち切る
+    flag = field.save(outBase + "_field.bin");
+    if (flag)
+      SLAM_LOGI("Likelihood field: %s_field.bin (%d x %d cells)\n", outBase.c_str(), field.getWidth(), field.getHeight());
+  }
+
+  return(flag);
+}
+
+// 作成済みの地図の距離場fieldFileに対して、位置推定だけを行う。描画はしない
+// 軌跡はスキャンごとに<outBase>_traj.txtに書き出すので、走行が長くてもメモリは増えない
+bool SlamLauncher::localize() {
+  if (!lfield.load(fieldFile))
+    return(false);
+  fcustom.setStaticMap(&lfield);
+
+  string trajFile = outBase + "_traj.txt";
+  FILE *fp = fopen(trajFile.c_str(), "w");
+  if (fp == nullptr) {
+    SLAM_LOGE("Error: cannot open %s\n", trajFile.c_str());
+    return(false);
+  }
+
+  size_t cnt = 0;                          // 処理の論理時刻
+  if (startN > 0)
+    skipData(startN);                      // startNまでデータを読み飛ばす
+
+  StageProfiler::setCurrent(&profiler);    // 処理時間をprofilerに記録する
+  Scan2D scan;
+  bool eof = sreader.loadScan(cnt, scan);
+  while(!eof) {
+    sfront.process(scan);                  // 静的地図による位置推定
+    const Pose2D &p = pcmap->getLastPose();
+    fprintf(fp, "%lu %.6f %.6f %.6f\n", cnt, p.tx, p.ty, p.th);
+
+    ++cnt;
+    eof = sreader.loadScan(cnt, scan);
+    profiler.endScan();
+  }
+  sreader.closeScanFile();
+  StageProfiler::setCurrent(nullptr);
+  bool flag = (ferror(fp) == 0);
+  fclose(fp);
+
+  double totalTimeMap = 1000*profiler.getHistogram(PS_PROCESS).getSum();    // 位置推定時間の合計[ms]
+  SLAM_LOGI("Elapsed time: localization=%g\n", totalTimeMap);
+  profiler.printSummary();
+  profiler.writeCsv(outBase + "_prof.csv");
+  profiler.writeJson(outBase + "_prof.json");
+
+  if (cnt == 0) {
+    SLAM_LOGE("Error: no scan processed.\n");
+    flag = false;
+  }
+  SLAM_LOGI("Results: %s (%lu poses)\n", trajFile.c_str(), cnt);
+  SLAM_LOGI("SlamLauncher finished.\n");
+
+  return(flag);
+}
+
 // 開始からnum個のスキャンまで読み飛ばす
 void SlamLauncher::skipData(int num) {
   Scan2D scan;
@@ -105,7 +230,7 @@ void SlamLauncher::mapByOdometry(Scan2D *scan) {
   pcmap->addPoints(glps);
   pcmap->makeGlobalMap();
 
-  printf("Odom pose: tx=%g, ty=%g, th=%g\n", pose.tx, pose.ty, pose.th);
+  SLAM_LOGD("Odom pose: tx=%g, ty=%g, th=%g\n", pose.tx, pose.ty, pose.th);
 }
 
 ////////// スキャン描画 ////////
@@ -135,12 +260,12 @@ void SlamLauncher::showScans() {
 
     mdrawer.drawScanGp(scan);              // スキャン描画
 
-    printf("---- scan num=%lu ----\n", cnt);
+    SLAM_LOGD("---- scan num=%lu ----\n", cnt);
     eof = sreader.loadScan(cnt, scan);
     ++cnt;
   }
   sreader.closeScanFile();
-  printf("SlamLauncher finished.\n");
+  SLAM_LOGI("SlamLauncher finished.\n");
 }
 
 //////// スキャン読み込み /////////
@@ -148,6 +273,16 @@ void SlamLauncher::showScans() {
 bool SlamLauncher::setFilename(char *filename) {
   bool flag = sreader.openScanFile(filename);        // ファイルをオープン
 
+  // 出力ファイル名の元。ディレクトリと拡張子を除いて、カレントディレクトリに出力する
+  string name(filename);
+  size_t p = name.find_last_of("/\\");
+  if (p != string::npos)
+    name = name.substr(p+1);
+  size_t q = name.find_last_of('.');
+  if (q != string::npos && q > 0)
+    name = name.substr(0, q);
+  outBase = name;
+
   return(flag);
 }
 
@@ -159,6 +294,11 @@ void SlamLauncher::customizeFramework() {
 //  fcustom.customizeG();                         // 退化の対処をしない
 //  fcustom.customizeH();                         // 退化の対処をする
   fcustom.customizeI();                           // ループ閉じ込みをする
+//  fcustom.customizeJ();                         // 距離場でスキャンマッチングする
+//  fcustom.customizeK();                         // NDTでスキャンマッチングする
+//  fcustom.setDeskew(0.025);                     // 1回の走査に25msかかるとして、スキャンの歪みを補正する
+  if (memBudget > 0)
+    fcustom.setMemoryBudget(memBudget, 2, ".");   // 超えた分の部分地図はファイルに退避する。直近の2個は残す
 
   pcmap = fcustom.getPointCloudMap();           // customizeの後にやること
 }
@@ -16,6 +16,7 @@
 #define SLAM_LAUNCHER_H_
 
 #include <vector>
+#include <string>
 #ifdef _WIN32
 #include <windows.h>
 #elif __linux__
@@ -28,6 +29,9 @@
 #include "SlamBackEnd.h"
 #include "MapDrawer.h"
 #include "FrameworkCustomizer.h"
+#include "StageProfiler.h"
+#include "SlamCheckpoint.h"
+#include "LikelihoodField.h"
 
 /////////////
 
@@ -37,6 +41,12 @@ private:
   int startN;                      // 開始スキャン番号
   int drawSkip;                    // 描画間隔
   bool odometryOnly;               // オドメトリによる地図構築か
+  bool headless;                   // 描画せずに、結果をファイルに出力して終了するか
+  int ckptInterval;                // チェックポイントを保存するスキャン間隔。0なら保存しない
+  bool resume;                     // チェックポイントから再開するか
+  bool makeField;                  // 結果の地図から距離場を作って保存するか
+  size_t memBudget;                // 部分地図の点群のメモリ上限[byte]。0なら無制限
+  std::string fieldFile;           // 位置推定に使う距離場のファイル。空ならSLAMを行う
   Pose2D ipose;                    // オドメトリ地図構築の補助データ。初期位置の角度を0にする
 
   Pose2D lidarOffset;              // レーザスキャナとロボットの相対位置
@@ -46,9 +56,13 @@ private:
   SlamFrontEnd sfront;             // SLAMフロントエンド
   MapDrawer mdrawer;               // gnuplotによる描画
   FrameworkCustomizer fcustom;     // フレームワークの改造
+  StageProfiler profiler;          // 処理段階ごとの処理時間の集計
+  SlamCheckpoint ckpt;             // SLAMの状態の保存と読み戻し
+  LikelihoodField lfield;          // 位置推定に使う静的地図の距離場
+  std::string outBase;             // 出力ファイル名の元。データファイル名から拡張子を除いたもの
 
 public:
-  SlamLauncher() : startN(0), drawSkip(10), odometryOnly(false), pcmap(nullptr) {
+  SlamLauncher() : startN(0), drawSkip(10), odometryOnly(false), headless(false), ckptInterval(0), resume(false), makeField(false), memBudget(0), pcmap(nullptr) {
   }
 
   ~SlamLauncher() {
@@ -64,9 +78,40 @@ public:
     odometryOnly = p;
   }
 
+  void setHeadless(bool p) {
+    headless = p;
+  }
+
+  // nスキャンごとにSLAMの状態を<outBase>_ckpt.binに保存する。書き出しは別スレッドで行う
+  void setCheckpointInterval(int n) {
+    ckptInterval = n;
+  }
+
+  // <outBase>_ckpt.binから状態を読み戻して、続きのスキャンから処理する
+  void setResume(bool p) {
+    resume = p;
+  }
+
+  // 終了時に、全体地図から距離場を作って<outBase>_field.binに保存する
+  void setMakeField(bool p) {
+    makeField = p;
+  }
+
+  // 部分地図の点群のメモリ上限budget[byte]。超えた分はカレントディレクトリにファイルとして退避する
+  void setMemoryBudget(size_t budget) {
+    memBudget = budget;
+  }
+
+  // 地図を作らず、距離場のファイルpathの地図に対して位置推定だけを行う
+  void setStaticMap(const std::string &path) {
+    fieldFile = path;
+  }
+
 ///////////
 
-  void run();
+  bool run();
+  bool saveResults();
+  bool localize();
   void showScans();
   void mapByOdometry(Scan2D *scan);
   bool setFilename(char *filename);
@@ -13,15 +13,22 @@
  ****************************************************************************/
 
 #include "SlamLauncher.h"
+#include "SlamLog.h"
 
 int main(int argc, char *argv[]) {
   bool scanCheck=false;              // スキャン表示のみか
   bool odometryOnly=false;           // オドメトリによる地図構築か
-  char *filename;                    // データファイル名
+  bool headless=false;               // 描画せずに結果をファイルに出力するか
+  int ckptInterval=0;                // チェックポイントを保存するスキャン間隔
+  bool resume=false;                 // チェックポイントから再開するか
+  bool makeField=false;              // 結果の地図から距離場を作るか
+  size_t memBudget=0;                // 部分地図の点群のメモリ上限[byte]
+  char *fieldFile=nullptr;           // 位置推定に使う距離場のファイル名
+  char *filename=nullptr;            // データファイル名
   int startN=0;                      // 開始スキャン番号
 
   if (argc < 2) {
-    printf("Error: too few arguments.\n");
+    SLAM_LOGE("Error: too few arguments.\n");
     return(1);
   }
 
@@ -37,24 +44,53 @@ int main(int argc, char *argv[]) {
         scanCheck = true;
       else if (option == 'o')        // オドメトリによる地図構築
         odometryOnly = true;
+      else if (option == 'q')        // 確認用の表示をしない
+        SlamLog::setLevel(SLAM_LOG_INFO);
+      else if (option == 'b')        // バッチ処理用。描画せずに結果をファイルに出力して終了する
+        headless = true;
+      else if (option == 'k')        // 100スキャンごとにチェックポイントを保存する
+        ckptInterval = 100;
+      else if (option == 'r')        // チェックポイントから再開する
+        resume = true;
+      else if (option == 'm')        // 結果の地図から位置推定用の距離場を作る
+        makeField = true;
+      else if (option == 'p')        // 部分地図のメモリを64MBまでにして、超えた分はファイルに退避する
+        memBudget = 64*1024*1024;
+      else if (option == 'l')        // 作成済みの地図に対して位置推定だけを行う。距離場のファイル名を先に与える
+        fieldFile = argv[2];
     }
-    if (argc == 2) {
-      printf("Error: no file name.\n");
+    if (argc == 2 || (fieldFile != nullptr && argc == 3)) {
+      SLAM_LOGE("Error: no file name.\n");
       return(1);
     }
     ++idx;
+    if (fieldFile != nullptr)
+      ++idx;
   }
   if (argc >= idx+1)                 // '-'ある場合idx=2、ない場合idx=1
     filename = argv[idx];
   if (argc == idx+2)                 // argcがidxより2大きければstartNがある
     startN = atoi(argv[idx+1]);
   else if (argc >= idx+2) {
-    printf("Error: invalid arguments.\n");
+    SLAM_LOGE("Error: invalid arguments.\n");
     return(1);
   }
   
-  printf("SlamLauncher: startN=%d, scanCheck=%d, odometryOnly=%d\n", startN, scanCheck, odometryOnly);
-  printf("filename=%s\n", filename);
+  if (scanCheck && headless) {
+    SLAM_LOGE("Error: -s cannot be used with -b.\n");
+    return(1);
+  }
+  if ((ckptInterval > 0 || resume) && (scanCheck || odometryOnly)) {
+    SLAM_LOGE("Error: -k and -r cannot be used with -s or -o.\n");
+    return(1);
+  }
+  if (fieldFile != nullptr && (!headless || scanCheck || odometryOnly || ckptInterval > 0 || resume || makeField)) {
+    SLAM_LOGE("Error: -l must be used with -b, and cannot be used with -s, -o, -k, -r or -m.\n");
+    return(1);
+  }
+
+  SLAM_LOGI("SlamLauncher: startN=%d, scanCheck=%d, odometryOnly=%d, headless=%d, ckptInterval=%d, resume=%d\n", startN, scanCheck, odometryOnly, headless, ckptInterval, resume);
+  SLAM_LOGI("filename=%s\n", filename);
 
   // ファイルを開く
   SlamLauncher sl;
@@ -69,8 +105,19 @@ int main(int argc, char *argv[]) {
     sl.showScans();
   else {                             // スキャン表示以外はSlamLauncher内で場合分け
     sl.setOdometryOnly(odometryOnly);
+    sl.setHeadless(headless);
+    sl.setCheckpointInterval(ckptInterval);
+    sl.setResume(resume);
+    sl.setMakeField(makeField);
+    sl.setMemoryBudget(memBudget);
     sl.customizeFramework();
-    sl.run();
+    if (fieldFile != nullptr) {      // 位置推定だけを行う
+      sl.setStaticMap(fieldFile);
+      if (!sl.localize())
+        return(1);
+    }
+    else if (!sl.run())              // headlessでなければ戻らない
+      return(1);
   }
 
   return(0);
@@ -0,0 +1,40 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file CheckpointIO.cpp
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#include <cstdio>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include "CheckpointIO.h"
+#include "SlamLog.h"
+
+using namespace std;
+
+//////////
+
+// ファイルsrcのハードリンクdstを作る。dstがあれば置き換える。中身は写さないので、大きなファイルでもすぐ終わる
+bool linkFile(const string &src, const string &dst) {
+  remove(dst.c_str());
+#ifdef _WIN32
+  bool flag = (CreateHardLinkA(dst.c_str(), src.c_str(), NULL) != 0);
+#else
+  bool flag = (link(src.c_str(), dst.c_str()) == 0);
+#endif
+  if (!flag)
+    SLAM_LOGW("Warning: cannot link %s to %s\n", src.c_str(), dst.c_str());
+
+  return(flag);
+}
@@ -0,0 +1,198 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file CheckpointIO.h
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#ifndef CHECKPOINT_IO_H_
+#define CHECKPOINT_IO_H_
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+#include "MyUtil.h"
+#include "LPoint2D.h"
+#include "Pose2D.h"
+#include "Scan2D.h"
+
+// ファイルsrcのハードリンクdstを作る。dstがあれば置き換える。リンクできないファイルシステムではfalseを返す
+bool linkFile(const std::string &src, const std::string &dst);
+
+// チェックポイントに書く内容をメモリにためる
+// 値はメモリ上の表現のまま書くので、読めるのは同じ環境でビルドしたプログラムだけ
+// 退避ファイルのように大きな中身は、読み込まずにハードリンクとしてチェックポイントと一緒に残せる
+class CheckpointWriter
+{
+private:
+  std::vector<char> buf;
+  std::string filePrefix;             // 一緒に残すファイルの名前の先頭。空なら残さない
+  std::vector<std::string> files;     // 一緒に残したファイル
+
+public:
+  CheckpointWriter() {
+  }
+
+  ~CheckpointWriter() {
+  }
+
+  // 領域は残すので、次の書き込みでヒープ確保が少なくて済む
+  void clear() {
+    buf.clear();
+    files.clear();
+  }
+
+  // 書き出しが終わった後に、領域も解放する
+  void release() {
+    std::vector<char>().swap(buf);
+  }
+
+  void setFilePrefix(const std::string &p) {
+    filePrefix = p;
+  }
+
+  const std::vector<std::string> &getFiles() const {
+    return(files);
+  }
+
+  // ファイルsrcを「filePrefix+番号」にリンクして、一緒に残すファイルに加える。番号をidに入れる
+  // リンクを作った後にsrcが置き換えられても、残したファイルは書いた時点の中身のまま
+  bool putFile(const std::string &src, uint64_t &id) {
+    if (filePrefix.empty())
+      return(false);
+    id = files.size();
+    std::string dst = filePrefix + std::to_string(id);
+    if (!linkFile(src, dst))
+      return(false);
+    files.push_back(dst);
+    return(true);
+  }
+
+  const std::vector<char> &getBuffer() const {
+    return(buf);
+  }
+
+  std::vector<char> &getBuffer() {
+    return(buf);
+  }
+
+  template <class T>
+  void put(const T &v) {
+    static_assert(std::is_trivially_copyable<T>::value, "put needs a trivially copyable type");
+    const char *p = reinterpret_cast<const char*>(&v);
+    buf.insert(buf.end(), p, p + sizeof(T));
+  }
+
+  // 点数を書いてから中身をまとめて書く
+  template <class T>
+  void putVector(const std::vector<T> &v) {
+    static_assert(std::is_trivially_copyable<T>::value, "putVector needs a trivially copyable type");
+    put<uint64_t>(v.size());
+    if (!v.empty()) {
+      const char *p = reinterpret_cast<const char*>(v.data());
+      buf.insert(buf.end(), p, p + v.size()*sizeof(T));
+    }
+  }
+
+  void putMatrix(const Eigen::Matrix3d &m) {
+    for (int i=0; i<3; i++)
+      for (int j=0; j<3; j++)
+        put(m(i,j));
+  }
+
+  void putScan(const Scan2D &s) {
+    put(s.sid);
+    put(s.stamp);
+    put(s.pose);
+    putVector(s.lps);
+    putVector(s.phases);
+  }
+};
+
+///////
+
+// CheckpointWriterで書いた内容を順に読む。途中で足りなくなったら、以降はすべてfalseを返す
+class CheckpointReader
+{
+private:
+  const char *cur;              // 次に読む位置
+  const char *end;              // 終わり
+  bool ok;                      // ここまで読めたか
+  std::string filePrefix;       // 一緒に残したファイルの名前の先頭
+
+public:
+  CheckpointReader(const char *p, size_t n) : cur(p), end(p + n), ok(true) {
+  }
+
+  ~CheckpointReader() {
+  }
+
+  bool isOk() const {
+    return(ok);
+  }
+
+  bool atEnd() const {
+    return(cur == end);
+  }
+
+  void setFilePrefix(const std::string &p) {
+    filePrefix = p;
+  }
+
+  // CheckpointWriter::putFileで残したid番のファイル名
+  std::string getFilePath(uint64_t id) const {
+    return(filePrefix + std::to_string(id));
+  }
+
+  template <class T>
+  bool get(T &v) {
+    static_assert(std::is_trivially_copyable<T>::value, "get needs a trivially copyable type");
+    if (!ok || static_cast<size_t>(end - cur) < sizeof(T))
+      return(ok = false);
+    memcpy(&v, cur, sizeof(T));
+    cur += sizeof(T);
+    return(true);
+  }
+
+  template <class T>
+  bool getVector(std::vector<T> &v) {
+    static_assert(std::is_trivially_copyable<T>::value, "getVector needs a trivially copyable type");
+    uint64_t n;
+    if (!get(n))
+      return(false);
+    if (n > static_cast<size_t>(end - cur)/sizeof(T))     // 壊れたファイルで巨大な確保をしない
+      return(ok = false);
+    v.resize(n);
+    if (n > 0)
+      memcpy(v.data(), cur, n*sizeof(T));
+    cur += n*sizeof(T);
+    return(true);
+  }
+
+  bool getMatrix(Eigen::Matrix3d &m) {
+    for (int i=0; i<3; i++)
+      for (int j=0; j<3; j++)
+        get(m(i,j));
+    return(ok);
+  }
+
+  bool getScan(Scan2D &s) {
+    get(s.sid);
+    get(s.stamp);
+    get(s.pose);
+    getVector(s.lps);
+    getVector(s.phases);
+    return(ok);
+  }
+};
+
+#endif
@@ -0,0 +1,79 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file CorrespondenceSet.h
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#ifndef CORRESPONDENCE_SET_H_
+#define CORRESPONDENCE_SET_H_
+
+#include <vector>
+#include "LPoint2D.h"
+
+// 対応づけた点の組。コスト関数と共分散の計算に使う値だけを詰めて持つ
+struct CorrPair
+{
+  double cx, cy;           // 現在スキャンの点の位置（ロボット座標系）
+  double rx, ry;           // 参照スキャンの点の位置（地図座標系）
+  double nx, ny;           // 参照スキャンの点の法線ベクトル
+  ptype rtype;             // 参照スキャンの点のタイプ
+};
+
+// データ対応づけの結果。DataAssociatorが1つ持ち、コスト関数などには参照で渡す
+// 点の組を配列に詰めるので、繰り返し計算で点を指すポインタをたどらずに済む
+class CorrespondenceSet
+{
+private:
+  std::vector<CorrPair> pairs;
+
+public:
+  CorrespondenceSet() {
+  }
+
+  ~CorrespondenceSet() {
+  }
+
+  // 領域は残すので、次の対応づけでヒープ確保をしない
+  void clear() {
+    pairs.clear();
+  }
+
+  // 現在スキャンの点clpと参照スキャンの点rlpの組を加える
+  void add(const LPoint2D *clp, const LPoint2D *rlp) {
+    CorrPair cp;
+    cp.cx = clp->x;
+    cp.cy = clp->y;
+    cp.rx = rlp->x;
+    cp.ry = rlp->y;
+    cp.nx = rlp->nx;
+    cp.ny = rlp->ny;
+    cp.rtype = rlp->type;
+    pairs.push_back(cp);
+  }
+
+  size_t size() const {
+    return(pairs.size());
+  }
+
+  bool empty() const {
+    return(pairs.empty());
+  }
+
+  const CorrPair &operator[](size_t i) const {
+    return(pairs[i]);
+  }
+
+  const CorrPair *data() const {
+    return(pairs.data());
+  }
+};
+
+#endif
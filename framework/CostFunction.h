@@ -20,17 +20,18 @@
 #include "LPoint2D.h"
 #include "Pose2D.h"
 #include "Scan2D.h"
+#include "CorrespondenceSet.h"
+#include "LPointSpan.h"
 
 class CostFunction
 {
 protected:
-  std::vector<const LPoint2D*> curLps;         // 対応がとれた現在スキャンの点群
-  std::vector<const LPoint2D*> refLps;         // 対応がとれた参照スキャンの点群
+  const CorrespondenceSet *corrs;              // 対応がとれた点の組。DataAssociatorが持つものを参照する
   double evlimit;                              // マッチングで対応がとれたと見なす距離閾値
   double pnrate;                               // 誤差がevlimit以内で対応がとれた点の比率
 
 public:
-  CostFunction() : evlimit(0), pnrate(0) {
+  CostFunction() : corrs(nullptr), evlimit(0), pnrate(0) {
   }
 
   ~CostFunction() {
@@ -42,16 +43,39 @@ public:
     evlimit = e;
   }
 
-  // DataAssociatorで対応のとれた点群cur, refを設定
-  void setPoints(std::vector<const LPoint2D*> &cur, std::vector<const LPoint2D*> &ref) {
-    curLps = cur;
-    refLps = ref;
+  // DataAssociatorで対応のとれた点の組cを設定。コピーはしないので、calValueの間はcを変えないこと
+  void setPoints(const CorrespondenceSet &c) {
+    corrs = &c;
   }
 
   double getPnrate() {
     return(pnrate);
   }
 
+  // 評価に使った点数
+  virtual size_t getUsedNum() {
+    return((corrs != nullptr)? corrs->size() : 0);
+  }
+
+  // データ対応づけの結果を使うか。falseなら、点の組の代わりにsetScanとsetRefBaseで点群を受け取る
+  virtual bool usesCorrespondence() {
+    return(true);
+  }
+
+  // 対応づけを使わないコスト関数に現在スキャンを設定する
+  virtual void setScan(const Scan2D * /*scan*/) {
+  }
+
+  // 対応づけを使わないコスト関数に参照スキャンを設定する
+  virtual void setRefBase(const LPointSpan & /*refLps*/) {
+  }
+
+  // 位置(tx,ty,th)でのコストの勾配gradと近似ヘッセ行列hes（ガウス・ニュートン近似）を解析的に求める
+  // thは度で、微分も度あたり。求められなければfalseを返し、最適化器は数値微分を使う
+  virtual bool calDerivatives(double /*tx*/, double /*ty*/, double /*th*/, Eigen::Vector3d & /*grad*/, Eigen::Matrix3d & /*hes*/) {
+    return(false);
+  }
+
 ///////////
 
   virtual double calValue(double tx, double ty, double th) = 0;
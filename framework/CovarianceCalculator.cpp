@@ -13,57 +13,48 @@
  ****************************************************************************/
 
 #include "CovarianceCalculator.h"
+#include "SlamLog.h"
 
 using namespace std;
 
 ////////// ICPによる推定値の共分散 /////////
 
 // ICPによるロボット位置の推定値の共分散covを求める。
-// 推定位置pose、現在スキャン点群curLps、参照スキャン点群refLps
-double CovarianceCalculator::calIcpCovariance(const Pose2D &pose, std::vector<const LPoint2D*> &curLps, std::vector<const LPoint2D*> &refLps, Eigen::Matrix3d &cov) {
-  double tx = pose.tx;
-  double ty = pose.ty;
-  double th = pose.th;
-  double a = DEG2RAD(th);
-  vector<double> Jx;                                         // ヤコビ行列のxの列
-  vector<double> Jy;                                         // ヤコビ行列のyの列
-  vector<double> Jt;                                         // ヤコビ行列のthの列
-
-  for (size_t i=0; i<curLps.size(); i++) {
-    const LPoint2D *clp = curLps[i];                         // 現在スキャンの点
-    const LPoint2D *rlp = refLps[i];                         // 参照スキャンの点
-
-    if (rlp->type == ISOLATE)                                // 孤立点は除外
-      continue;
-
-    double pd0 = calPDistance(clp, rlp, tx, ty, a);         // コスト関数値
-    double pdx = calPDistance(clp, rlp, tx+dd, ty, a);      // xを少し変えたコスト関数値
-    double pdy = calPDistance(clp, rlp, tx, ty+dd, a);      // yを少し変えたコスト関数値
-    double pdt = calPDistance(clp, rlp, tx, ty, a+da);      // thを少し変えたコスト関数値
-
-    Jx.push_back((pdx - pd0)/dd);                            // 偏微分（x成分）
-    Jy.push_back((pdy - pd0)/dd);                            // 偏微分（y成分）
-    Jt.push_back((pdt - pd0)/da);                            // 偏微分（th成分）
+// 推定位置pose、対応づけた点の組corrs
+// 観測モデルは垂直距離 pd = (R(th)c + t - r)・n なので、ヤコビ行列の行は解析的に
+// (nx, ny, (-sin(th)cx - cos(th)cy)nx + (cos(th)cx - sin(th)cy)ny) となる。数値微分はしない
+double CovarianceCalculator::calIcpCovariance(const Pose2D &pose, const CorrespondenceSet &corrs, Eigen::Matrix3d &cov) {
+  double a = DEG2RAD(pose.th);
+  double cs = cos(a);
+  double sn = sin(a);
+
+  // ヤコビ行列の各行を求めながら、ヘッセ行列の近似J^TJの上三角を累積する。分岐をなくして、ループを単純にする
+  double h00=0, h01=0, h02=0, h11=0, h12=0, h22=0;
+  const CorrPair *cps = corrs.data();
+  size_t num = corrs.size();
+  for (size_t i=0; i<num; i++) {
+    const CorrPair &cp = cps[i];                             // 現在スキャンの点と参照スキャンの点の組
+    double w = (cp.rtype == ISOLATE)? 0.0 : 1.0;             // 孤立点は除外
+
+    double Jx = w*cp.nx;                                     // 偏微分（x成分）
+    double Jy = w*cp.ny;                                     // 偏微分（y成分）
+    double Jt = w*((-sn*cp.cx - cs*cp.cy)*cp.nx + (cs*cp.cx - sn*cp.cy)*cp.ny);   // 偏微分（th成分）
+    h00 += Jx*Jx;
+    h01 += Jx*Jy;
+    h02 += Jx*Jt;
+    h11 += Jy*Jy;
+    h12 += Jy*Jt;
+    h22 += Jt*Jt;
   }
 
-  // ヘッセ行列の近似J^TJの計算
-  Eigen::Matrix3d hes = Eigen::Matrix3d::Zero(3,3);          // 近似ヘッセ行列。0で初期化
-  for (size_t i=0; i<Jx.size(); i++) {
-    hes(0,0) += Jx[i]*Jx[i];
-    hes(0,1) += Jx[i]*Jy[i];
-    hes(0,2) += Jx[i]*Jt[i];
-    hes(1,1) += Jy[i]*Jy[i];
-    hes(1,2) += Jy[i]*Jt[i];
-    hes(2,2) += Jt[i]*Jt[i];
-  }
   // J^TJが対称行列であることを利用
-  hes(1,0) = hes(0,1);
-  hes(2,0) = hes(0,2);
-  hes(2,1) = hes(1,2);
+  Eigen::Matrix3d hes;                                       // 近似ヘッセ行列
+  hes << h00, h01, h02,
+         h01, h11, h12,
+         h02, h12, h22;
 
-  // 共分散行列は（近似）ヘッセ行列の逆行列
-//  cov = hes.inverse();
-  cov = MyUtil::svdInverse(hes);                              // SVDを使う方が少しよい
+  // 共分散行列は（近似）ヘッセ行列の逆行列。3x3の対称行列なので、余因子で直接求める
+  cov = MyUtil::symInverse(hes);
 
   double vals[2], vec1[2], vec2[2];
   double ratio = calEigen(cov, vals, vec1, vec2);            // 固有値計算して、退化具合を調べる
@@ -77,10 +68,10 @@ double CovarianceCalculator::calIcpCovariance(const Pose2D &pose, std::vector<co
 }
 
 // 垂直距離を用いた観測モデルの式
-double CovarianceCalculator::calPDistance(const LPoint2D *clp, const LPoint2D *rlp, double tx, double ty, double th) {
-  double x = cos(th)*clp->x - sin(th)*clp->y + tx;                     // clpを推定位置で座標変換
-  double y = sin(th)*clp->x + cos(th)*clp->y + ty;
-  double pdis = (x - rlp->x)*rlp->nx + (y - rlp->y)*rlp->ny;           // 座標変換した点からrlpへの垂直距離
+double CovarianceCalculator::calPDistance(const CorrPair &cp, double tx, double ty, double th) {
+  double x = cos(th)*cp.cx - sin(th)*cp.cy + tx;                       // 現在スキャンの点を推定位置で座標変換
+  double y = sin(th)*cp.cx + cos(th)*cp.cy + ty;
+  double pdis = (x - cp.rx)*cp.nx + (y - cp.ry)*cp.ny;                 // 座標変換した点から参照スキャンの点への垂直距離
 
   return(pdis);
 }
@@ -116,11 +107,13 @@ void CovarianceCalculator::calMotionCovarianceSimple(const Pose2D &motion, doubl
   cov = kk*C1;
 
   // 確認用
-  printf("calMotionCovarianceSimple\n");
-  printf("vt=%g, wt=%g\n", vt, wt);
-  double vals[2], vec1[2], vec2[2];
-  calEigen(cov, vals, vec1, vec2);
-  printf("cov : %g %g %g %g %g %g\n", cov(0,0), cov(0,1), cov(0,2), cov(1,1), cov(1,2), cov(2,2));
+  if (SLAM_LOG_ENABLED(SLAM_LOG_DEBUG)) {
+    SLAM_LOGD("calMotionCovarianceSimple\n");
+    SLAM_LOGD("vt=%g, wt=%g\n", vt, wt);
+    double vals[2], vec1[2], vec2[2];
+    calEigen(cov, vals, vec1, vec2);
+    SLAM_LOGD("cov : %g %g %g %g %g %g\n", cov(0,0), cov(0,1), cov(0,2), cov(1,1), cov(1,2), cov(2,2));
+  }
 }
 
 ///////// 運動モデルの計算 /////////
@@ -196,8 +189,8 @@ double CovarianceCalculator::calEigen(const Eigen::Matrix3d &cov, double *vals,
   double ratio = vals[0]/vals[1];
 
   // 確認用
-  printf("Eigen: ratio=%g, val1=%g, val2=%g\n", ratio, vals[0], vals[1]);
-  printf("Eigen: vec1=(%g, %g), ang=%g\n", vec1[0], vec1[1], RAD2DEG(atan2(vec1[1], vec1[0])));
+  SLAM_LOGD("Eigen: ratio=%g, val1=%g, val2=%g\n", ratio, vals[0], vals[1]);
+  SLAM_LOGD("Eigen: vec1=(%g, %g), ang=%g\n", vec1[0], vec1[1], RAD2DEG(atan2(vec1[1], vec1[0])));
 
   return(ratio);
 }
@@ -19,6 +19,7 @@
 #include "MyUtil.h"
 #include "LPoint2D.h"
 #include "Pose2D.h"
+#include "CorrespondenceSet.h"
 
 // ICPによる推定値の共分散、および、オドメトリによる推定値の共分散を計算する。
 class CovarianceCalculator
@@ -43,8 +44,8 @@ public:
 
 ////////
 
-  double calIcpCovariance(const Pose2D &pose, std::vector<const LPoint2D*> &curLps, std::vector<const LPoint2D*> &refLps, Eigen::Matrix3d &cov);
-  double calPDistance(const LPoint2D *clp, const LPoint2D *rlp, double tx, double ty, double th);
+  double calIcpCovariance(const Pose2D &pose, const CorrespondenceSet &corrs, Eigen::Matrix3d &cov);
+  double calPDistance(const CorrPair &cp, double tx, double ty, double th);
 
   void calMotionCovarianceSimple(const Pose2D &motion, double dT, Eigen::Matrix3d &cov);
   void calMotionCovariance(double th, double dx, double dy, double dth, double dt, Eigen::Matrix3d &cov, bool accum=false);
@@ -20,12 +20,14 @@
 #include "LPoint2D.h"
 #include "Pose2D.h"
 #include "Scan2D.h"
+#include "LPointSpan.h"
+#include "CorrespondenceSet.h"
+#include "NNGridIndex.h"
 
 class DataAssociator
 {
 public:
-  std::vector<const LPoint2D*> curLps;            // 対応がとれた現在スキャンの点群
-  std::vector<const LPoint2D*> refLps;            // 対応がとれた参照スキャンの点群
+  CorrespondenceSet corrs;                        // 対応がとれた点の組。コスト関数などは参照で使う
 
   DataAssociator() {
   }
@@ -33,7 +35,14 @@ public:
   ~DataAssociator() {
   }
 
-  virtual void setRefBase(const std::vector<LPoint2D> &lps) = 0;
+  // 参照スキャンの点群lpsを登録する。lpsは地図の点群を直接指すことがあるので、点はコピーせずポインタで使う
+  virtual void setRefBase(const LPointSpan &lps) = 0;
+
+  // 作成済みの格子テーブルを参照スキャンにする。格子テーブルを使わないクラスでは、その点群を登録する
+  virtual void setRefIndex(const NNGridIndex *index) {
+    setRefBase(index->getPoints());
+  }
+
   virtual double findCorrespondence(const Scan2D *curScan, const Pose2D &predPose) = 0;
 };
 
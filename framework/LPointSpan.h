@@ -0,0 +1,58 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file LPointSpan.h
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#ifndef LPOINT_SPAN_H_
+#define LPOINT_SPAN_H_
+
+#include <vector>
+#include "LPoint2D.h"
+
+// 点群の参照（先頭と点数）。点は持たないので、元の点群が変わるまでの間だけ使える
+// 参照スキャンのように、地図がもつ点群をコピーせずに渡すときに使う
+struct LPointSpan
+{
+  const LPoint2D *lps;         // 先頭の点
+  size_t num;                  // 点数
+
+  LPointSpan() : lps(nullptr), num(0) {
+  }
+
+  LPointSpan(const LPoint2D *p, size_t n) : lps(p), num(n) {
+  }
+
+  LPointSpan(const std::vector<LPoint2D> &v) : lps(v.data()), num(v.size()) {     // vectorからは暗黙に変換する
+  }
+
+  size_t size() const {
+    return(num);
+  }
+
+  bool empty() const {
+    return(num == 0);
+  }
+
+  const LPoint2D &operator[](size_t i) const {
+    return(lps[i]);
+  }
+
+  const LPoint2D *begin() const {
+    return(lps);
+  }
+
+  const LPoint2D *end() const {
+    return(lps + num);
+  }
+};
+
+#endif
@@ -0,0 +1,242 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file LikelihoodField.cpp
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "LikelihoodField.h"
+#include "SlamLog.h"
+
+using namespace std;
+
+const uint32_t LikelihoodField::MAGIC = 0x444c464c;          // "LFLD"
+const uint32_t LikelihoodField::VERSION = 1;
+
+//////////
+
+// 地図点lpsから距離場を作る。csizeはセルサイズ[m]、maxDistは距離の上限[m]
+// 点のあるセルを距離0として、ユークリッド距離変換（Felzenszwalbの方法）を縦横に1回ずつかけ、各セルに最も近い点のあるセルを求める
+// 距離はそのセルの点からセル中心までの実際の距離にする。点をセル中心に丸めないので、セルサイズより細かい位置ずれも距離に出る
+// 作り直すときは前の領域を使い回すので、大きさが同程度ならヒープ確保をしない
+void LikelihoodField::build(const LPointSpan &lps, double csize, double maxDist) {
+  if (mapAddr != nullptr)
+    release();
+  dist = nullptr;
+  hd.csize = csize;
+  hd.maxDist = maxDist;
+  if (lps.empty()) {
+    hd.width = hd.height = 0;
+    return;
+  }
+
+  double xmin=HUGE_VAL, ymin=HUGE_VAL, xmax=-HUGE_VAL, ymax=-HUGE_VAL;
+  for (size_t i=0; i<lps.size(); i++) {
+    xmin = min(xmin, lps[i].x);
+    ymin = min(ymin, lps[i].y);
+    xmax = max(xmax, lps[i].x);
+    ymax = max(ymax, lps[i].y);
+  }
+  hd.xmin = xmin - maxDist - csize;               // 周りにmaxDist分の余白をつける
+  hd.ymin = ymin - maxDist - csize;
+  hd.width = static_cast<int>((xmax - hd.xmin + maxDist)/csize) + 2;
+  hd.height = static_cast<int>((ymax - hd.ymin + maxDist)/csize) + 2;
+  int w = hd.width;
+  int h = hd.height;
+
+  const float INF = 1.0E20f;
+  size_t cnum = static_cast<size_t>(w)*h;
+  buf.assign(cnum, INF);                           // セル単位の距離の2乗
+  seed.assign(cnum, -1);
+  nearRow.resize(cnum);
+  for (size_t i=0; i<lps.size(); i++) {
+    int xi = static_cast<int>((lps[i].x - hd.xmin)/csize);
+    int yi = static_cast<int>((lps[i].y - hd.ymin)/csize);
+    size_t k = static_cast<size_t>(yi)*w + xi;
+    buf[k] = 0;
+    seed[k] = static_cast<int>(i);                 // 同じセルに複数あれば最後の点を使う
+  }
+
+  size_t n = max(w, h);
+  if (tf.size() < n) {
+    tf.resize(n);
+    td.resize(n);
+    tz.resize(n+1);
+    tv.resize(n);
+    ta.resize(n);
+  }
+  for (int x=0; x<w; x++) {                       // 列ごと
+    for (int y=0; y<h; y++)
+      tf[y] = buf[static_cast<size_t>(y)*w + x];
+    transform1D(tf.data(), h, td.data(), tv.data(), tz.data(), ta.data());
+    for (int y=0; y<h; y++) {
+      buf[static_cast<size_t>(y)*w + x] = td[y];
+      nearRow[static_cast<size_t>(y)*w + x] = ta[y];
+    }
+  }
+  for (int y=0; y<h; y++) {                       // 行ごと
+    float *row = &buf[static_cast<size_t>(y)*w];
+    transform1D(row, w, td.data(), tv.data(), tz.data(), ta.data());
+    double cy = hd.ymin + (y + 0.5)*csize;        // セル中心
+    for (int x=0; x<w; x++) {
+      int xs = ta[x];                             // 最も近い点のあるセル(xs, ys)
+      int ys = nearRow[static_cast<size_t>(y)*w + xs];
+      const LPoint2D &lp = lps[seed[static_cast<size_t>(ys)*w + xs]];
+      double dx = lp.x - (hd.xmin + (x + 0.5)*csize);
+      double dy = lp.y - cy;
+      row[x] = static_cast<float>(min(sqrt(dx*dx + dy*dy), maxDist));
+    }
+  }
+  dist = buf.data();
+
+  SLAM_LOGD("LikelihoodField: %d x %d cells, csize=%g, maxDist=%g, points=%lu\n", w, h, csize, maxDist, lps.size());
+}
+
+// 1次元の距離変換。d[q] = min_p ((q-p)^2 + f[p])で、最小を与えるpをa[q]に入れる。v、zは作業用で、それぞれn個、n+1個
+void LikelihoodField::transform1D(const float *f, int n, float *d, int *v, float *z, int *a) {
+  const float INF = 1.0E20f;
+  int k = 0;
+  v[0] = 0;
+  z[0] = -INF;
+  z[1] = INF;
+  for (int q=1; q<n; q++) {
+    float s = ((f[q] + q*q) - (f[v[k]] + v[k]*v[k]))/(2.0f*(q - v[k]));
+    while (s <= z[k]) {
+      --k;
+      s = ((f[q] + q*q) - (f[v[k]] + v[k]*v[k]))/(2.0f*(q - v[k]));
+    }
+    ++k;
+    v[k] = q;
+    z[k] = s;
+    z[k+1] = INF;
+  }
+  k = 0;
+  for (int q=0; q<n; q++) {
+    while (z[k+1] < q)
+      ++k;
+    d[q] = (q - v[k])*(q - v[k]) + f[v[k]];
+    a[q] = v[k];
+  }
+}
+
+//////////
+
+// ファイルpathに保存する。一時ファイルに書いてから置き換える
+bool LikelihoodField::save(const string &path) const {
+  if (empty()) {
+    SLAM_LOGE("Error: LikelihoodField is empty.\n");
+    return(false);
+  }
+
+  string tmp = path + ".tmp";
+  FILE *fp = fopen(tmp.c_str(), "wb");
+  if (fp == nullptr) {
+    SLAM_LOGE("Error: cannot open %s\n", tmp.c_str());
+    return(false);
+  }
+  size_t num = static_cast<size_t>(hd.width)*hd.height;
+  bool flag = (fwrite(&hd, sizeof(hd), 1, fp) == 1);
+  flag = flag && (fwrite(dist, sizeof(float), num, fp) == num);
+  flag = (fclose(fp) == 0) && flag;
+  if (flag)
+    flag = (rename(tmp.c_str(), path.c_str()) == 0);
+  if (!flag) {
+    SLAM_LOGE("Error: cannot write %s\n", path.c_str());
+    remove(tmp.c_str());
+  }
+
+  return(flag);
+}
+
+// ファイルpathを読む。Linuxではファイルをメモリに写像するだけで、距離は使ったところからOSが読み込む
+bool LikelihoodField::load(const string &path) {
+  release();
+
+  const char *addr = nullptr;
+  size_t size = 0;
+#ifndef _WIN32
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    SLAM_LOGE("Error: cannot open %s\n", path.c_str());
+    return(false);
+  }
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    size = static_cast<size_t>(st.st_size);
+    void *p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+      mapAddr = p;
+      mapSize = size;
+      addr = static_cast<const char*>(p);
+    }
+  }
+  close(fd);
+#else
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (fp == nullptr) {
+    SLAM_LOGE("Error: cannot open %s\n", path.c_str());
+    return(false);
+  }
+  FieldHeader h;
+  if (fread(&h, sizeof(h), 1, fp) == 1 && h.width > 0 && h.height > 0) {
+    buf.resize(static_cast<size_t>(h.width)*h.height);
+    if (fread(buf.data(), sizeof(float), buf.size(), fp) == buf.size()) {
+      hd = h;
+      size = sizeof(h) + buf.size()*sizeof(float);
+      addr = reinterpret_cast<const char*>(&hd);       // ヘッダの確認を写像したときと共通にする
+    }
+  }
+  fclose(fp);
+#endif
+
+  FieldHeader h;
+  bool flag = (addr != nullptr && size >= sizeof(h));
+  if (flag) {
+    memcpy(&h, addr, sizeof(h));
+    flag = (h.magic == MAGIC && h.version == VERSION && h.width > 0 && h.height > 0 &&
+            size == sizeof(h) + static_cast<size_t>(h.width)*h.height*sizeof(float));
+  }
+  if (!flag) {
+    SLAM_LOGE("Error: %s is not a likelihood field of this version.\n", path.c_str());
+    release();
+    return(false);
+  }
+
+  hd = h;
+  if (mapAddr != nullptr)
+    dist = reinterpret_cast<const float*>(addr + sizeof(h));
+  else
+    dist = buf.data();
+  SLAM_LOGI("LikelihoodField loaded: %s (%d x %d cells, csize=%g)\n", path.c_str(), hd.width, hd.height, hd.csize);
+
+  return(true);
+}
+
+// 距離を捨てる。写像していれば解除する
+void LikelihoodField::release() {
+#ifndef _WIN32
+  if (mapAddr != nullptr)
+    munmap(mapAddr, mapSize);
+#endif
+  mapAddr = nullptr;
+  mapSize = 0;
+  dist = nullptr;
+  buf.clear();
+  buf.shrink_to_fit();
+}
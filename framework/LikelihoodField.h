@@ -0,0 +1,120 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file LikelihoodField.h
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#ifndef LIKELIHOOD_FIELD_H_
+#define LIKELIHOOD_FIELD_H_
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "MyUtil.h"
+#include "LPoint2D.h"
+#include "LPointSpan.h"
+
+// 距離場（尤度場）。格子の各セルに、地図点までの最短距離[m]を入れておく
+// 地図点から一度だけ作ってファイルに保存し、使うときはファイルをメモリに写像するので、読み込みは大きさによらずすぐ終わる
+class LikelihoodField
+{
+private:
+  // ファイルの先頭に置く。続けてfloatの距離がwidth*height個、行（y）順に並ぶ
+  struct FieldHeader
+  {
+    uint32_t magic;                 // 識別子
+    uint32_t version;               // 形式の版
+    int32_t width, height;          // セル数
+    double csize;                   // セルサイズ[m]
+    double xmin, ymin;              // 左下のセルの角の位置[m]
+    double maxDist;                 // 距離の上限[m]。これより遠いセルはmaxDistにする
+  };
+
+  static const uint32_t MAGIC;
+  static const uint32_t VERSION;
+
+  FieldHeader hd;
+  const float *dist;                // 各セルの距離。bufかファイルの写像を指す
+  std::vector<float> buf;           // 作ったとき、または写像できなかったときの距離
+  void *mapAddr;                    // ファイルを写像した領域。nullptrなら写像していない
+  size_t mapSize;                   // 写像した大きさ[byte]
+  std::vector<float> tf, td, tz;    // 距離変換の作業用
+  std::vector<int> tv, ta;
+  std::vector<int> seed;            // セルに入った地図点の番号。なければ-1
+  std::vector<int> nearRow;         // 縦の距離変換で得た、各セルに最も近い点のあるセルの行
+
+public:
+  LikelihoodField() : dist(nullptr), mapAddr(nullptr), mapSize(0) {
+    hd.magic = MAGIC;
+    hd.version = VERSION;
+    hd.width = hd.height = 0;
+    hd.csize = 0.05;
+    hd.xmin = hd.ymin = 0;
+    hd.maxDist = 0.5;
+  }
+
+  ~LikelihoodField() {
+    release();
+  }
+
+  bool empty() const {
+    return(dist == nullptr);
+  }
+
+  double getCellSize() const {
+    return(hd.csize);
+  }
+
+  double getMaxDist() const {
+    return(hd.maxDist);
+  }
+
+  int getWidth() const {
+    return(hd.width);
+  }
+
+  int getHeight() const {
+    return(hd.height);
+  }
+
+  // 位置(x,y)の地図点までの距離[m]。セル中心の値を双線形補間する。格子の外はmaxDist
+  // 距離の勾配を(gx,gy)に入れる
+  double calDistance(double x, double y, double &gx, double &gy) const {
+    double u = (x - hd.xmin)/hd.csize - 0.5;        // セル中心を格子点とした座標
+    double v = (y - hd.ymin)/hd.csize - 0.5;
+    int i = static_cast<int>(floor(u));
+    int j = static_cast<int>(floor(v));
+    if (i < 0 || j < 0 || i+1 >= hd.width || j+1 >= hd.height) {
+      gx = gy = 0;
+      return(hd.maxDist);
+    }
+    double a = u - i;
+    double b = v - j;
+    const float *p = dist + static_cast<size_t>(j)*hd.width + i;
+    double d00 = p[0], d10 = p[1];
+    double d01 = p[hd.width], d11 = p[hd.width + 1];
+    gx = ((1 - b)*(d10 - d00) + b*(d11 - d01))/hd.csize;
+    gy = ((1 - a)*(d01 - d00) + a*(d11 - d10))/hd.csize;
+    return((1 - b)*((1 - a)*d00 + a*d10) + b*((1 - a)*d01 + a*d11));
+  }
+
+//////////
+
+  void build(const LPointSpan &lps, double csize, double maxDist);
+  bool save(const std::string &path) const;
+  bool load(const std::string &path);
+  void release();
+
+private:
+  static void transform1D(const float *f, int n, float *d, int *v, float *z, int *a);
+};
+
+#endif
@@ -13,6 +13,7 @@
  ****************************************************************************/
 
 #include "MyUtil.h"
+#include "SlamLog.h"
 #include <Eigen/SVD>
 
 using namespace std;
@@ -55,18 +56,17 @@ double MyUtil::addR(double a1, double a2) {
 
 ////////////
 
-// SVDを用いた逆行列計算
+// SVDを用いた逆行列計算。固定サイズの行列で計算するので、ヒープ確保をしない
 Eigen::Matrix3d MyUtil::svdInverse(const Matrix3d &A) {
-  size_t m = A.rows();
   size_t n = A.cols();
 
-  JacobiSVD<MatrixXd> svd(A, ComputeThinU | ComputeThinV);
+  JacobiSVD<Matrix3d> svd(A, ComputeFullU | ComputeFullV);      // 正方行列なので、FullでもThinと同じ
 
-  MatrixXd eU = svd.matrixU();
-  MatrixXd eV = svd.matrixV();
-  VectorXd eS = svd.singularValues();  
+  const Matrix3d &eU = svd.matrixU();
+  const Matrix3d &eV = svd.matrixV();
+  const Vector3d &eS = svd.singularValues();
 
-  MatrixXd M1(m, n);
+  Matrix3d M1;
   for (size_t i=0; i<n; i++) {
 //    if (eS[i] < 1.0E-10)                   // AがSingularかどうかのチェック。今回はしない
 //      return;
@@ -87,6 +87,28 @@ Eigen::Matrix3d MyUtil::svdInverse(const Matrix3d &A) {
   return(IA);
 }
 
+// 対称行列Aの逆行列を余因子で直接求める。ICPの共分散のように毎スキャン計算する3x3の対称行列に使う
+// Aが特異なら、svdInverseと同じく要素は無限大になる
+Eigen::Matrix3d MyUtil::symInverse(const Matrix3d &A) {
+  double a = A(0,0), b = A(0,1), c = A(0,2);
+  double d = A(1,1), e = A(1,2), f = A(2,2);
+
+  double c00 = d*f - e*e;                    // 余因子
+  double c01 = c*e - b*f;
+  double c02 = b*e - c*d;
+  double c11 = a*f - c*c;
+  double c12 = b*c - a*e;
+  double c22 = a*d - b*b;
+  double idet = 1.0/(a*c00 + b*c01 + c*c02);  // 行列式の逆数
+
+  Matrix3d IA;
+  IA << c00*idet, c01*idet, c02*idet,
+        c01*idet, c11*idet, c12*idet,
+        c02*idet, c12*idet, c22*idet;
+
+  return(IA);
+}
+
 /////////
 
 // 2次正方行列の固有値分解
@@ -120,11 +142,11 @@ void MyUtil::calEigen2D( double (*mat)[2], double *vals, double *vec1, double *v
   double ax2 = x1*vec1[0];
   double ay1 = c*vec1[0] + d*vec1[1];
   double ay2 = x1*vec1[1];
-  printf("ax1=%g, ax2=%g\n", ax1, ax2);
-  printf("ay1=%g, ay2=%g\n", ay1, ay2);
+  SLAM_LOGD("ax1=%g, ax2=%g\n", ax1, ax2);
+  SLAM_LOGD("ay1=%g, ay2=%g\n", ay1, ay2);
 
   double prod = vec1[0]*vec2[0] + vec1[1]*vec2[1];
-  printf("prod=%g\n", prod);
+  SLAM_LOGD("prod=%g\n", prod);
 */
 
 }
@@ -50,6 +50,7 @@ public:
   static double addR(double a1, double a2);
 
   static Eigen::Matrix3d svdInverse(const Eigen::Matrix3d &A);
+  static Eigen::Matrix3d symInverse(const Eigen::Matrix3d &A);
   static void calEigen2D( double (*mat)[2], double *vals, double *vec1, double *vec2);
 
 };
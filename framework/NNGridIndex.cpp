@@ -0,0 +1,112 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file NNGridIndex.cpp
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#include <algorithm>
+#include "NNGridIndex.h"
+
+using namespace std;
+
+////////////
+
+// 点群rlpsをコピーして格子テーブルを作る
+void NNGridIndex::build(const vector<LPoint2D> &rlps) {
+  lps = rlps;
+
+  // 各点のテーブルインデックス。対象領域の外の点は使わない
+  vector<int> xis(lps.size()), yis(lps.size());
+  int xmax=-1, ymax=-1;
+  xmin = 2*tsize+1;
+  ymin = 2*tsize+1;
+  for (size_t i=0; i<lps.size(); i++) {
+    int xi = static_cast<int>(lps[i].x/csize) + tsize;
+    int yi = static_cast<int>(lps[i].y/csize) + tsize;
+    if (xi < 0 || xi > 2*tsize || yi < 0 || yi > 2*tsize) {     // 対象領域の外
+      xis[i] = -1;
+      continue;
+    }
+    xis[i] = xi;
+    yis[i] = yi;
+    xmin = min(xmin, xi);
+    xmax = max(xmax, xi);
+    ymin = min(ymin, yi);
+    ymax = max(ymax, yi);
+  }
+  width = max(xmax - xmin + 1, 0);
+  height = max(ymax - ymin + 1, 0);
+
+  // 点のあるセル範囲だけテーブルを作る。セルごとの点数を数えてから詰めて並べる
+  cellStart.assign(static_cast<size_t>(width)*height + 1, 0);
+  for (size_t i=0; i<lps.size(); i++) {
+    if (xis[i] < 0)
+      continue;
+    size_t idx = static_cast<size_t>(yis[i] - ymin)*width + (xis[i] - xmin);
+    ++cellStart[idx+1];
+  }
+  for (size_t k=1; k<cellStart.size(); k++)
+    cellStart[k] += cellStart[k-1];
+
+  cellLps.resize(cellStart.back());
+  vector<unsigned int> pos(cellStart.begin(), cellStart.end()-1);   // 各セルの次の書き込み位置
+  for (size_t i=0; i<lps.size(); i++) {
+    if (xis[i] < 0)
+      continue;
+    size_t idx = static_cast<size_t>(yis[i] - ymin)*width + (xis[i] - xmin);
+    cellLps[pos[idx]++] = static_cast<unsigned int>(i);
+  }
+}
+
+///////////
+
+// スキャン点clpをpredPoseで座標変換した位置に最も近い点を探す
+const LPoint2D *NNGridIndex::findClosestPoint(const LPoint2D *clp, const Pose2D &predPose) const {
+  LPoint2D glp;                           // clpの予測位置
+  predPose.globalPoint(*clp, glp);        // relPoseで座標変換
+
+  // clpのテーブルインデックス。対象領域内にあるかチェックする。
+  int cxi = static_cast<int>(glp.x/csize) + tsize;
+  if (cxi < 0 || cxi > 2*tsize)
+    return(nullptr);
+  int cyi = static_cast<int>(glp.y/csize) + tsize;
+  if (cyi < 0 || cyi > 2*tsize)
+    return(nullptr);
+
+  double dmin=1000000;
+  const LPoint2D *lpmin = nullptr;        // 最も近い点（目的の点）
+  int R=static_cast<int>(dthre/csize);
+
+  // ±R四方を探す。点のあるセル範囲の外は飛ばす
+  for (int i=-R; i<=R; i++) {
+    int yi = cyi+i - ymin;
+    if (yi < 0 || yi >= height)
+      continue;
+    for (int j=-R; j<=R; j++) {
+      int xi = cxi+j - xmin;
+      if (xi < 0 || xi >= width)
+        continue;
+
+      size_t idx = static_cast<size_t>(yi)*width + xi;    // テーブルインデックス
+      for (unsigned int k=cellStart[idx]; k<cellStart[idx+1]; k++) {
+        const LPoint2D *lp = &lps[cellLps[k]];
+        double d = (lp->x - glp.x)*(lp->x - glp.x) + (lp->y - glp.y)*(lp->y - glp.y);
+
+        if (d <= dthre*dthre && d < dmin) {         // dthre内で距離が最小となる点を保存
+          dmin = d;
+          lpmin = lp;
+        }
+      }
+    }
+  }
+
+  return(lpmin);
+}
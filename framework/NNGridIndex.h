@@ -0,0 +1,62 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file NNGridIndex.h
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#ifndef _NN_GRID_INDEX_H_
+#define _NN_GRID_INDEX_H_
+
+#include <vector>
+#include "MyUtil.h"
+#include "Pose2D.h"
+
+// 作成後は変更しない格子テーブル
+// 確定した部分地図のように何度も参照する点群に使う。点群のコピーをもつので、元の点群が消えても使える。
+// セルの割り当てと探索の順番はNNGridTableと同じなので、同じ最近傍点が得られる。
+class NNGridIndex
+{
+private:
+  double csize;                       // セルサイズ[m]
+  double rsize;                       // 対象領域のサイズ[m]。正方形の1辺の半分。
+  int tsize;                          // テーブルサイズの半分
+  double dthre;                       // これより遠い点は除外する[m]
+  int xmin, ymin;                     // 点があるセル範囲の左下（テーブルインデックス）
+  int width, height;                  // 点があるセル範囲の幅と高さ
+  std::vector<LPoint2D> lps;          // 点群（元の順番）
+  std::vector<unsigned int> cellStart;  // 各セルの点がcellLpsのどこから始まるか。セル数+1個
+  std::vector<unsigned int> cellLps;  // セル順に並べた点のインデックス。セル内は登録順
+
+public:
+  NNGridIndex() : csize(0.05), rsize(40), dthre(0.2), xmin(0), ymin(0), width(0), height(0) {   // NNGridTableと同じ設定
+    tsize = static_cast<int>(rsize/csize);
+  }
+
+  ~NNGridIndex() {
+  }
+
+  const std::vector<LPoint2D> &getPoints() const {
+    return(lps);
+  }
+
+  // 使用メモリ量[byte]
+  size_t byteSize() const {
+    return(sizeof(NNGridIndex) + lps.capacity()*sizeof(LPoint2D)
+           + (cellStart.capacity() + cellLps.capacity())*sizeof(unsigned int));
+  }
+
+////////////
+
+  void build(const std::vector<LPoint2D> &rlps);
+  const LPoint2D *findClosestPoint(const LPoint2D *clp, const Pose2D &predPose) const;
+};
+
+#endif
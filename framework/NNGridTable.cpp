@@ -12,7 +12,9 @@
  * @author Masahiro Tomono
  ****************************************************************************/
 
+#include <algorithm>
 #include "NNGridTable.h"
+#include "SlamLog.h"
 
 using namespace std;
 
@@ -28,8 +30,47 @@ void NNGridTable::addPoint(const LPoint2D *lp) {
   if (yi < 0 || yi > 2*tsize)                      // 対象領域の外
     return;
 
-  size_t idx = static_cast<size_t>(yi*(2*tsize +1) + xi);   // テーブルのインデックス
-  table[idx].lps.push_back(lp);                             // 目的のセルに入れる
+  lps.push_back(lp);                               // 並べ直すまで、登録順にためておく
+  xis.push_back(xi);
+  yis.push_back(yi);
+  built = false;
+}
+
+// 登録した点を、点のあるセル範囲でセル順に並べ直す。セルごとの点数を数えてから詰めて並べる
+void NNGridTable::build() {
+  int xmax=-1, ymax=-1;
+  xmin = 2*tsize+1;
+  ymin = 2*tsize+1;
+  for (size_t i=0; i<lps.size(); i++) {
+    xmin = min(xmin, xis[i]);
+    xmax = max(xmax, xis[i]);
+    ymin = min(ymin, yis[i]);
+    ymax = max(ymax, yis[i]);
+  }
+  width = max(xmax - xmin + 1, 0);
+  height = max(ymax - ymin + 1, 0);
+
+  size_t cnum = static_cast<size_t>(width)*height;   // セル数
+  if (cellStart.capacity() < cnum + 1) {             // 点のある範囲は少しずつ広がるので、余裕をもって確保する
+    cellStart.reserve(2*cnum + 1);
+    cellPos.reserve(2*cnum);
+  }
+  cellStart.assign(cnum + 1, 0);
+  for (size_t i=0; i<lps.size(); i++) {
+    size_t idx = static_cast<size_t>(yis[i] - ymin)*width + (xis[i] - xmin);
+    ++cellStart[idx+1];
+  }
+  for (size_t k=1; k<cellStart.size(); k++)
+    cellStart[k] += cellStart[k-1];
+
+  cellLps.resize(lps.size());
+  cellPos.assign(cellStart.begin(), cellStart.end()-1);
+  for (size_t i=0; i<lps.size(); i++) {
+    size_t idx = static_cast<size_t>(yis[i] - ymin)*width + (xis[i] - xmin);
+    cellLps[cellPos[idx]++] = lps[i];
+  }
+
+  built = true;
 }
 
 ///////////
@@ -47,27 +88,27 @@ const LPoint2D *NNGridTable::findClosestPoint(const LPoint2D *clp, const Pose2D
   if (cyi < 0 || cyi > 2*tsize)
     return(nullptr);
 
-  size_t pn=0;                            // 探したセル内の点の総数。確認用
+  if (!built)
+    build();
+
   double dmin=1000000;
   const LPoint2D *lpmin = nullptr;        // 最も近い点（目的の点）
   double dthre=0.2;                       // これより遠い点は除外する[m]
   int R=static_cast<int>(dthre/csize);
 
-  // ±R四方を探す
+  // ±R四方を探す。点のあるセル範囲の外は飛ばす
   for (int i=-R; i<=R; i++) {
-    int yi = cyi+i;                       // cyiから広げる
-    if (yi < 0 || yi > 2*tsize)
+    int yi = cyi+i - ymin;                // cyiから広げる
+    if (yi < 0 || yi >= height)
       continue;
     for (int j=-R; j<=R; j++) {
-      int xi = cxi+j;                     // cxiから広げる
-      if (xi < 0 || xi > 2*tsize)
+      int xi = cxi+j - xmin;              // cxiから広げる
+      if (xi < 0 || xi >= width)
         continue;
 
-      size_t idx = yi*(2*tsize+1) + xi;             // テーブルインデックス
-      NNGridCell &cell = table[idx];                // そのセル
-      vector<const LPoint2D*> &lps = cell.lps;      // セルがもつスキャン点群
-      for (size_t k=0; k<lps.size(); k++) {
-        const LPoint2D *lp = lps[k];
+      size_t idx = static_cast<size_t>(yi)*width + xi;    // テーブルインデックス
+      for (unsigned int k=cellStart[idx]; k<cellStart[idx+1]; k++) {
+        const LPoint2D *lp = cellLps[k];
         double d = (lp->x - glp.x)*(lp->x - glp.x) + (lp->y - glp.y)*(lp->y - glp.y);
 
         if (d <= dthre*dthre && d < dmin) {         // dthre内で距離が最小となる点を保存
@@ -75,10 +116,8 @@ const LPoint2D *NNGridTable::findClosestPoint(const LPoint2D *clp, const Pose2D
           lpmin = lp;
         }
       }
-      pn += lps.size();
     }
   }
-//  printf("pn=%d\n", pn);                 // 探したセル内の点の総数。確認用
 
   return(lpmin);
 }
@@ -91,16 +130,20 @@ void NNGridTable::makeCellPoints(int nthre, vector<LPoint2D> &ps) {
   // スキャン番号の最新値をとる場合は、その部分のコメントをはずし、
   // 平均とる場合（2行）をコメントアウトする。
 
+  if (!built)
+    build();
+
   size_t nn=0;                           // テーブル内の全セル数。確認用
-  for (size_t i=0; i<table.size(); i++) {
-    vector<const LPoint2D*> &lps = table[i].lps;      // セルのスキャン点群
-    nn += lps.size();
-    if (lps.size() >= nthre) {           // 点数がnthreより多いセルだけ処理する
+  for (size_t c=0; c+1<cellStart.size(); c++) {
+    size_t n = cellStart[c+1] - cellStart[c];         // セルの点数
+    nn += n;
+    if (n >= nthre) {                    // 点数がnthreより多いセルだけ処理する
+      const LPoint2D * const *clps = &cellLps[cellStart[c]];   // セルのスキャン点群
       double gx=0, gy=0;                 // 点群の重心位置
       double nx=0, ny=0;                 // 点群の法線ベクトルの平均
       int sid=0;
-      for (size_t j=0; j<lps.size(); j++) {
-        const LPoint2D *lp = lps[j];
+      for (size_t j=0; j<n; j++) {
+        const LPoint2D *lp = clps[j];
         gx += lp->x;                     // 位置を累積
         gy += lp->y;
         nx += lp->nx;                    // 法線ベクトル成分を累積
@@ -108,14 +151,14 @@ void NNGridTable::makeCellPoints(int nthre, vector<LPoint2D> &ps) {
         sid += lp->sid;                  // スキャン番号の平均とる場合
 //        if (lp->sid > sid)             // スキャン番号の最新値とる場合
 //          sid = lp->sid;
-//        printf("sid=%d\n", lp->sid);
+//        SLAM_LOGD("sid=%d\n", lp->sid);
       }
-      gx /= lps.size();                  // 平均
-      gy /= lps.size();
+      gx /= n;                           // 平均
+      gy /= n;
       double L = sqrt(nx*nx + ny*ny);
       nx /=  L;                          // 平均（正規化）
       ny /=  L;
-      sid /= lps.size();                 // スキャン番号の平均とる場合
+      sid /= n;                          // スキャン番号の平均とる場合
 
       LPoint2D newLp(sid, gx, gy);       // セルの代表点を生成
       newLp.setNormal(nx, ny);           // 法線ベクトル設定
@@ -124,5 +167,5 @@ void NNGridTable::makeCellPoints(int nthre, vector<LPoint2D> &ps) {
     }
   }
 
-//  printf("nn=%d\n", nn);               // テーブル内の全セル数。確認用
+//  SLAM_LOGD("nn=%d\n", nn);            // テーブル内の全セル数。確認用
 }
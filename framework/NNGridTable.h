@@ -19,40 +19,37 @@
 #include "MyUtil.h"
 #include "Pose2D.h"
 
-struct NNGridCell
-{
-  std::vector<const LPoint2D*> lps;         // このセルに格納されたスキャン点群
-
-  void clear() {
-    lps.clear();                            // 空にする
-  }
-};
-
-///////
-
 // 格子テーブル
+// 登録した点はセルごとの配列にせず、検索や代表点の生成の前に、点のあるセル範囲だけセル順に並べ直す（NNGridIndexと同じ形）。
+// 作業用の配列は使い回すので、点数が同程度ならスキャンごとにヒープ確保をしない。セルの割り当てと探索の順番は以前と同じ
 class NNGridTable
 {
 private:
   double csize;                       // セルサイズ[m]
   double rsize;                       // 対象領域のサイズ[m]。正方形の1辺の半分。
   int tsize;                          // テーブルサイズの半分
-  std::vector<NNGridCell> table;      // テーブル本体
+  std::vector<const LPoint2D*> lps;   // 登録した点（登録順）
+  std::vector<int> xis, yis;          // 登録した点のテーブルインデックス
+  int xmin, ymin;                     // 点があるセル範囲の左下（テーブルインデックス）
+  int width, height;                  // 点があるセル範囲の幅と高さ
+  std::vector<unsigned int> cellStart;  // 各セルの点がcellLpsのどこから始まるか。セル数+1個
+  std::vector<unsigned int> cellPos;  // 各セルの次の書き込み位置。作業用
+  std::vector<const LPoint2D*> cellLps; // セル順に並べた点。セル内は登録順
+  bool built;                         // 登録後にセル順に並べ直したか
 
 public:
-  NNGridTable() : csize(0.05), rsize(40){            // セル5cm、対象領域40x2m四方
+  NNGridTable() : csize(0.05), rsize(40), xmin(0), ymin(0), width(0), height(0), built(true) {   // セル5cm、対象領域40x2m四方
     tsize = static_cast<int>(rsize/csize);           // テーブルサイズの半分
-    size_t w = static_cast<int>(2*tsize+1);          // テーブルサイズ
-    table.resize(w*w);                               // 領域確保
-    clear();                                         // tableの初期化
   }
 
   ~NNGridTable() {
   }
   
   void clear() {
-    for (size_t i=0; i<table.size(); i++)
-      table[i].clear();                         // 各セルを空にする
+    lps.clear();                                     // 登録した点を空にする。領域は残す
+    xis.clear();
+    yis.clear();
+    built = false;
   }
   
 ////////////
@@ -60,6 +57,9 @@ public:
   void addPoint(const LPoint2D *lp);
   const LPoint2D *findClosestPoint(const LPoint2D *clp, const Pose2D &predPose);
   void makeCellPoints(int nthre, std::vector<LPoint2D> &ps);
+
+private:
+  void build();
 };
 
 #endif
@@ -13,6 +13,7 @@
  ****************************************************************************/
 
 #include "P2oDriver2D.h"
+#include "SlamLog.h"
 #include "p2o.h"
 
 using namespace std;
@@ -50,7 +51,7 @@ void P2oDriver2D::doP2o( PoseGraph &pg, vector<Pose2D> &newPoses, int N) {
     pcons.push_back(con);
   }
 
-//  printf("knodes.size=%lu, kcons.size=%lu\n", knodes.size(), kcons.size());    // 確認用
+//  SLAM_LOGD("knodes.size=%lu, kcons.size=%lu\n", knodes.size(), kcons.size()); // 確認用
 
   p2o::Optimizer2D opt;                                          // p2oインスタンス
   std::vector<p2o::Pose2D> result = opt.optimizePath(pnodes, pcons, N);  // N回実行
@@ -20,6 +20,7 @@
 #include "LPoint2D.h"
 #include "Pose2D.h"
 #include "Scan2D.h"
+#include "CheckpointIO.h"
 
 // 点群地図の基底クラス
 class PointCloudMap
@@ -68,6 +69,32 @@ public:
   virtual void makeGlobalMap() = 0;
   virtual void makeLocalMap() = 0;
   virtual void remakeMaps(const std::vector<Pose2D> &newPoses) = 0;
+
+  // 結果の出力用に、全部の点を入れた全体地図を作る。キーフレームでの全体地図に入れない点がある派生クラスは、これを変える
+  virtual void makeExportMap() {
+    makeGlobalMap();
+  }
+
+  // 地図の状態をwに書く。派生クラスは、これを呼んでから自分の状態を書く
+  virtual void writeState(CheckpointWriter &w) {
+    w.put(nthre);
+    w.putVector(poses);
+    w.put(lastPose);
+    w.putScan(lastScan);
+    w.putVector(globalMap);
+    w.putVector(localMap);
+  }
+
+  // writeStateで書いた状態を読む
+  virtual bool readState(CheckpointReader &r) {
+    r.get(nthre);
+    r.getVector(poses);
+    r.get(lastPose);
+    r.getScan(lastScan);
+    r.getVector(globalMap);
+    r.getVector(localMap);
+    return(r.isOk());
+  }
 };
 
 #endif
@@ -12,8 +12,9 @@
  * @author Masahiro Tomono
  ****************************************************************************/
 
-#include <boost/timer.hpp>
 #include "PoseEstimatorICP.h"
+#include "SlamLog.h"
+#include "StageProfiler.h"
 
 using namespace std;
 
@@ -21,7 +22,10 @@ using namespace std;
 
 // 初期値initPoseを与えて、ICPによりロボット位置の推定値estPoseを求める
 double PoseEstimatorICP::estimatePose(Pose2D &initPose, Pose2D &estPose){
-  boost::timer tim;
+  if (!popt->usesCorrespondence())
+    return(estimatePoseDirect(initPose, estPose));
+
+  chrono::steady_clock::time_point t0 = chrono::steady_clock::now();    // 処理時間は実時間で測る。clock()はプロセス全体のCPU時間なので、スレッドが多いと合わない
 
   double evmin = HUGE_VAL;             // コスト最小値。初期値は大きく
   double evthre = 0.000001;            // コスト変化閾値。変化量がこれ以下なら繰り返し終了
@@ -33,40 +37,88 @@ double PoseEstimatorICP::estimatePose(Pose2D &initPose, Pose2D &estPose){
   double evold = evmin;                // 1つ前の値。収束判定のために使う。
   Pose2D pose = initPose;
   Pose2D poseMin = initPose;
-  for (int i=0; abs(evold-ev) > evthre && i<100; i++) {           // i<100は振動対策
+  deadlineHit = false;
+  for (int i=0; abs(evold-ev) > evthre && i<maxIter; i++) {       // i<maxIterは振動対策
     if (i > 0)
       evold = ev;
-    double mratio = dass->findCorrespondence(curScan, pose);      // データ対応づけ
+    double mratio;
+    {
+      StageTimer st(PS_ASSOCIATE);
+      mratio = dass->findCorrespondence(curScan, pose);           // データ対応づけ
+    }
+    corrPose = pose;
+    corrValid = true;
     Pose2D newPose;
-    popt->setPoints(dass->curLps, dass->refLps);                  // 対応結果を渡す
-    ev = popt->optimizePose(pose, newPose);                       // その対応づけにおいてロボット位置の最適化
+    {
+      StageTimer st(PS_OPTIMIZE);
+      popt->setPoints(dass->corrs);                               // 対応結果を渡す
+      ev = popt->optimizePose(pose, newPose);                     // その対応づけにおいてロボット位置の最適化
+    }
     pose = newPose;
+    profCount(PC_ICP_ITERATION);
+    profCount(PC_CORRESPONDENCE, dass->corrs.size());
 
     if (ev < evmin) {                                             // コスト最小結果を保存
       poseMin = newPose;
       evmin = ev;
     }
 
-//    printf("dass.curLps.size=%lu, dass.refLps.size=%lu\n", dass->curLps.size(), dass->refLps.size());
-//    printf("mratio=%g\n", mratio);
-//    printf("i=%d: ev=%g, evold=%g\n", i, ev, evold);
+    if (useDeadline && chrono::steady_clock::now() >= deadline) { // 時間切れ
+      deadlineHit = true;
+      break;
+    }
+
+//    SLAM_LOGD("dass.corrs.size=%lu\n", dass->corrs.size());
+//    SLAM_LOGD("mratio=%g\n", mratio);
+//    SLAM_LOGD("i=%d: ev=%g, evold=%g\n", i, ev, evold);
   }
 
   pnrate = popt->getPnrate();
-  usedNum = dass->curLps.size();
+  usedNum = dass->corrs.size();
 
   estPose = poseMin;
 
-  printf("finalError=%g, pnrate=%g\n", evmin, pnrate);
-  printf("estPose:  tx=%g, ty=%g, th=%g\n", pose.tx, pose.ty, pose.th);      // 確認用
+  SLAM_LOGD("finalError=%g, pnrate=%g\n", evmin, pnrate);
+  SLAM_LOGD("estPose:  tx=%g, ty=%g, th=%g\n", pose.tx, pose.ty, pose.th);   // 確認用
 
-  double t1 = 1000*tim.elapsed();
-  printf("PoseEstimatorICP: t1=%g\n", t1);                 // 処理時間
+  double t1 = 1000*chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+  SLAM_LOGD("PoseEstimatorICP: t1=%g\n", t1);              // 処理時間
 
   if (evmin < HUGE_VAL)
     totalError += evmin;                                   // 誤差合計
   totalTime += t1;                                         // 処理時間合計
-  printf("totalError=%g, totalTime=%g\n", totalError, totalTime);    // 確認用
+  SLAM_LOGD("totalError=%g, totalTime=%g\n", totalError, totalTime); // 確認用
 
   return(evmin);
 }
+
+// 対応づけを使わないコスト関数（距離場など）では、データ対応づけと最適化を交互に繰り返す必要がない
+// 最適化器がコストの収束まで繰り返すので、1回呼ぶだけでよい
+// 繰り返し回数の上限と締切は、最適化器の繰り返しにそのまま渡す
+double PoseEstimatorICP::estimatePoseDirect(Pose2D &initPose, Pose2D &estPose) {
+  popt->setEvthre(0.000001);
+  popt->setEvlimit(0.2);               // evlimitは外れ値の閾値[m]
+  popt->setMaxIteration(maxIter);
+  if (useDeadline)
+    popt->setDeadline(deadline);
+  else
+    popt->clearDeadline();
+  corrValid = false;
+
+  double ev;
+  {
+    StageTimer st(PS_OPTIMIZE);
+    ev = popt->optimizePose(initPose, estPose);
+  }
+  deadlineHit = popt->isDeadlineHit();
+  pnrate = popt->getPnrate();
+  usedNum = popt->getUsedNum();
+  profCount(PC_ICP_ITERATION, popt->getIterNum());
+  profCount(PC_CORRESPONDENCE, usedNum);
+
+  if (ev < HUGE_VAL)
+    totalError += ev;
+  SLAM_LOGD("PoseEstimatorICP: direct ev=%g, pnrate=%g, usedNum=%lu\n", ev, pnrate, usedNum);
+
+  return(ev);
+}
@@ -16,6 +16,7 @@
 #define _POSEESTIMATOR_ICP_H_
 
 #include <vector>
+#include <chrono>
 #include "MyUtil.h"
 #include "LPoint2D.h"
 #include "Pose2D.h"
@@ -31,6 +32,12 @@ private:
   const Scan2D *curScan;       // 現在スキャン
   size_t usedNum;              // ICPに使われた点数。LoopDetectorで信頼性チェックに使う
   double pnrate;               // 正しく対応づけされた点の比率
+  int maxIter;                 // 繰り返し回数の上限
+  bool useDeadline;            // 締切を使うか
+  bool deadlineHit;            // 締切で繰り返しを打ち切ったか
+  std::chrono::steady_clock::time_point deadline;    // この時刻を過ぎたら繰り返しを打ち切る
+  Pose2D corrPose;             // 最後にデータ対応づけをした位置。dassの対応づけ結果はこの位置でのもの
+  bool corrValid;              // 直近の推定でデータ対応づけをしたか。対応づけを使わないコスト関数ではfalse
   
   PoseOptimizer *popt;         // 最適化クラス
   DataAssociator *dass;        // データ対応づけクラス
@@ -41,7 +48,7 @@ public:
 
 public:
 
-  PoseEstimatorICP() : usedNum(0), pnrate(0), totalError(0), totalTime(0) {
+  PoseEstimatorICP() : usedNum(0), pnrate(0), maxIter(100), useDeadline(false), deadlineHit(false), corrValid(false), totalError(0), totalTime(0) {
   }
 
   ~PoseEstimatorICP() {
@@ -56,6 +63,19 @@ public:
   void setDataAssociator(DataAssociator *d) {
     dass = d;
   }
+
+  DataAssociator *getDataAssociator() {
+    return(dass);
+  }
+
+  // 最後のデータ対応づけの位置。その対応づけ結果はgetDataAssociator()->corrsにある
+  const Pose2D &getCorrespondencePose() {
+    return(corrPose);
+  }
+
+  bool hasCorrespondence() {
+    return(corrValid);
+  }
      
   double getPnrate() {
     return(pnrate);
@@ -64,20 +84,54 @@ public:
   size_t getUsedNum() {
     return(usedNum);
   }
+
+  void setMaxIteration(int n) {
+    maxIter = n;
+  }
+
+  int getMaxIteration() {
+    return(maxIter);
+  }
+
+  // 締切tを過ぎたら、そこまでの最良の結果で終える。最低1回は繰り返す
+  void setDeadline(const std::chrono::steady_clock::time_point &t) {
+    deadline = t;
+    useDeadline = true;
+  }
+
+  void clearDeadline() {
+    useDeadline = false;
+  }
+
+  bool isDeadlineHit() {
+    return(deadlineHit);
+  }
   
   void setScanPair(const Scan2D *c, const Scan2D *r) {
     curScan = c;
     dass->setRefBase(r->lps);           // データ対応づけのために参照スキャン点を登録
   }
 
-  void setScanPair(const Scan2D *c, const std::vector<LPoint2D> &refLps) {
+  // refLpsは推定が終わるまで変えないこと
+  void setScanPair(const Scan2D *c, const LPointSpan &refLps) {
     curScan = c;
-    dass->setRefBase(refLps);           // データ対応づけのために参照スキャン点を登録
+    if (popt->usesCorrespondence())
+      dass->setRefBase(refLps);         // データ対応づけのために参照スキャン点を登録
+    else
+      popt->setScanPair(c, refLps);     // 対応づけを使わないコスト関数には点群をそのまま渡す
+  }
+
+  void setScanPair(const Scan2D *c, const NNGridIndex *refIndex) {
+    curScan = c;
+    dass->setRefIndex(refIndex);        // 作成済みの格子テーブルを参照スキャンにする
   }
 
 ////////////
 
   double estimatePose(Pose2D &initPose, Pose2D &estPose);
+
+private:
+  double estimatePoseDirect(Pose2D &initPose, Pose2D &estPose);
 };
 
 #endif
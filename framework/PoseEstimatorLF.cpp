@@ -0,0 +1,142 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file PoseEstimatorLF.cpp
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#include "PoseEstimatorLF.h"
+#include "SlamLog.h"
+#include "StageProfiler.h"
+
+using namespace std;
+
+//////////////
+
+const double PoseEstimatorLF::COV_SCALE = 0.1;
+
+//////////////
+
+// 初期値initPoseを与えて、距離場との照合によりロボット位置の推定値estPoseを求める
+// 戻り値は使った点の距離の2乗平均[m^2]。使える点がなければHUGE_VAL
+// 減衰は対角に足す（H+λI）。掛ける方式だと、スキャンが拘束しない方向（対角がほぼ0）では減衰が効かず大きく飛ぶ
+double PoseEstimatorLF::estimatePose(const Scan2D &scan, const Pose2D &initPose, Pose2D &estPose) {
+  StageTimer st(PS_OPTIMIZE);
+  const vector<LPoint2D> &lps = scan.lps;
+  estPose = initPose;
+  usedNum = 0;
+  if (field == nullptr || field->empty())
+    return(HUGE_VAL);
+
+  double tx = initPose.tx;
+  double ty = initPose.ty;
+  double th = DEG2RAD(initPose.th);
+  double ev = evalPose(lps, tx, ty, th);           // 外れ値をdthre^2で打ち切ったコスト
+  Eigen::Matrix3d H = hes;
+  Eigen::Vector3d g = grad;
+  double hscale = max(H.diagonal().maxCoeff(), 1.0);     // 減衰係数の尺度
+  double lambda = 0.001*hscale;                    // 減衰係数
+  for (int i=0; i<maxIter; i++) {
+    profCount(PC_ICP_ITERATION);
+    Eigen::Matrix3d A = H;
+    for (int k=0; k<3; k++)
+      A(k,k) += lambda;
+    Eigen::Vector3d dp = -MyUtil::symInverse(A)*g;
+    double ntx = tx + dp(0);
+    double nty = ty + dp(1);
+    double nth = th + dp(2);
+    double nev = evalPose(lps, ntx, nty, nth);
+    if (nev < ev) {                                // 良くなれば進んで、減衰を弱める
+      tx = ntx;  ty = nty;  th = nth;
+      ev = nev;
+      H = hes;
+      g = grad;
+      lambda = max(lambda/10, 1.0E-7*hscale);
+      if (fabs(dp(0)) < 1.0E-5 && fabs(dp(1)) < 1.0E-5 && fabs(dp(2)) < 1.0E-6)
+        break;
+    }
+    else {                                         // 悪くなれば戻って、減衰を強める
+      lambda *= 10;
+      if (lambda > 1.0E5*hscale)
+        break;
+    }
+  }
+
+  evalPose(lps, tx, ty, th);                       // 推定位置でのヘッセ行列と使った点数にする
+  profCount(PC_CORRESPONDENCE, usedNum);
+  estPose.setVal(tx, ty, RAD2DEG(th));
+  if (usedNum == 0)
+    return(HUGE_VAL);
+
+  double score = inlierSum/usedNum;
+  SLAM_LOGD("PoseEstimatorLF: ev=%g, score=%g, usedNum=%lu\n", ev, score, usedNum);
+
+  return(score);
+}
+
+// 位置(tx,ty,th[rad])でのコストを求める。あわせて、その位置でのヘッセ行列hes、勾配grad、使った点数を求める
+// 予測位置があれば、そこからのずれのマハラノビス距離もコスト、ヘッセ行列、勾配に加える
+double PoseEstimatorLF::evalPose(const vector<LPoint2D> &lps, double tx, double ty, double th) {
+  double cs = cos(th);
+  double sn = sin(th);
+  double dthre2 = dthre*dthre;
+  double h00=0, h01=0, h02=0, h11=0, h12=0, h22=0;
+  double g0=0, g1=0, g2=0;
+  double ev = 0;
+  inlierSum = 0;
+  usedNum = 0;
+  validNum = 0;
+  for (size_t i=0; i<lps.size(); i++) {
+    const LPoint2D &lp = lps[i];
+    if (lp.type == ISOLATE)                        // 孤立点は地図に入れていないので使わない
+      continue;
+    ++validNum;
+    double x = cs*lp.x - sn*lp.y + tx;
+    double y = sn*lp.x + cs*lp.y + ty;
+    double gx, gy;
+    double d = field->calDistance(x, y, gx, gy);
+    if (d >= dthre) {
+      ev += dthre2;
+      continue;
+    }
+    ev += d*d;
+    inlierSum += d*d;
+    ++usedNum;
+
+    double Jx = gx;                                // 距離の偏微分
+    double Jy = gy;
+    double Jt = gx*(-sn*lp.x - cs*lp.y) + gy*(cs*lp.x - sn*lp.y);
+    h00 += Jx*Jx;
+    h01 += Jx*Jy;
+    h02 += Jx*Jt;
+    h11 += Jy*Jy;
+    h12 += Jy*Jt;
+    h22 += Jt*Jt;
+    g0 += Jx*d;
+    g1 += Jy*d;
+    g2 += Jt*d;
+  }
+
+  hes << h00, h01, h02,
+         h01, h11, h12,
+         h02, h12, h22;
+  grad << g0, g1, g2;
+
+  if (usePrior) {
+    double dth = th - DEG2RAD(priorPose.th);
+    Eigen::Vector3d r(tx - priorPose.tx, ty - priorPose.ty, atan2(sin(dth), cos(dth)));   // 角度差は(-pi, pi]に収める
+    Eigen::Vector3d Pr = priorInf*r;
+    ev += r.dot(Pr);
+    hes += priorInf;
+    grad += Pr;
+  }
+
+  return(ev);
+}
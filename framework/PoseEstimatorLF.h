@@ -0,0 +1,107 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file PoseEstimatorLF.h
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#ifndef _POSEESTIMATOR_LF_H_
+#define _POSEESTIMATOR_LF_H_
+
+#include <vector>
+#include "MyUtil.h"
+#include "LPoint2D.h"
+#include "Pose2D.h"
+#include "Scan2D.h"
+#include "LikelihoodField.h"
+
+//////
+
+// 距離場を用いたロボット位置の推定。地図が変わらない位置推定で使う
+// スキャン点の地図点までの距離の2乗和を、ガウス・ニュートン法（レーベンバーグ・マーカート法）で最小化する
+// 距離場が距離とその勾配を直接返すので、データ対応づけはしない
+// 予測位置を事前分布として与えると、そのマハラノビス距離もコストに加える。長い通路のようにスキャンが拘束しない方向は予測位置に従う
+class PoseEstimatorLF
+{
+private:
+  static const double COV_SCALE;  // 距離の2乗和の尺度と共分散の比。共分散は近似ヘッセ行列の逆行列をこの倍数にしたもの
+
+  const LikelihoodField *field;  // 地図の距離場
+  double dthre;                  // 外れ値の閾値[m]。地図点からこれより遠いスキャン点は使わない
+  int maxIter;                   // 繰り返し回数の上限
+  size_t usedNum;                // 推定に使われた点数
+  size_t validNum;               // 照合に使える点数（孤立点以外）
+  double inlierSum;              // 使った点の距離の2乗和
+  bool usePrior;                 // 予測位置を事前分布として使うか
+  Pose2D priorPose;              // 予測位置
+  Eigen::Matrix3d priorInf;      // 予測位置の情報行列をコストの尺度にしたもの。角度はラジアン
+  Eigen::Matrix3d hes;           // 近似ヘッセ行列J^TJ。角度はラジアン
+  Eigen::Vector3d grad;          // 勾配J^Td
+
+public:
+  PoseEstimatorLF() : field(nullptr), dthre(0.2), maxIter(30), usedNum(0), validNum(0), inlierSum(0), usePrior(false) {
+    priorInf.setZero();
+    hes.setZero();
+    grad.setZero();
+  }
+
+  ~PoseEstimatorLF() {
+  }
+
+  void setField(const LikelihoodField *f) {
+    field = f;
+  }
+
+  const LikelihoodField *getField() {
+    return(field);
+  }
+
+  void setDthre(double d) {
+    dthre = d;
+  }
+
+  void setMaxIteration(int n) {
+    maxIter = n;
+  }
+
+  size_t getUsedNum() {
+    return(usedNum);
+  }
+
+  // 照合に使える点のうち、推定に使われた点の割合。位置を見失うと小さくなる
+  double getInlierRatio() {
+    return((validNum > 0)? (double)usedNum/validNum : 0);
+  }
+
+  // 次のestimatePoseで使う予測位置pとその共分散cov（角度はラジアン）
+  void setPrior(const Pose2D &p, const Eigen::Matrix3d &cov) {
+    usePrior = true;
+    priorPose = p;
+    priorInf = COV_SCALE*MyUtil::symInverse(cov);
+  }
+
+  void clearPrior() {
+    usePrior = false;
+  }
+
+  // 推定位置の共分散。ICPと同じく、近似ヘッセ行列の逆行列を0.1倍する。事前分布があれば、それと融合したものになる
+  void getCovariance(Eigen::Matrix3d &cov) {
+    cov = COV_SCALE*MyUtil::symInverse(hes);
+  }
+
+////////////
+
+  double estimatePose(const Scan2D &scan, const Pose2D &initPose, Pose2D &estPose);
+
+private:
+  double evalPose(const std::vector<LPoint2D> &lps, double tx, double ty, double th);
+};
+
+#endif
@@ -13,22 +13,37 @@
  ****************************************************************************/
 
 #include "PoseFuser.h"
+#include "SlamLog.h"
+#include "StageProfiler.h"
 
 using namespace std;
 
+// ICPは収束するとほとんど動かないので、最後の対応づけの位置と推定位置の差はたいていこれより小さい
+const double PoseFuser::REUSE_DIST = 0.001;
+const double PoseFuser::REUSE_ANGLE = 0.01;
+
 ////////////// 逐次SLAM用のセンサ融合 ////////////////
 
 // 逐次SLAMでのICPとオドメトリの推定移動量を融合する。dassに参照スキャンを入れておくこと。covに移動量の共分散行列が入る。
 double PoseFuser::fusePose(Scan2D *curScan, const Pose2D &estPose, const Pose2D &odoMotion, const Pose2D &lastPose, Pose2D &fusedPose, Eigen::Matrix3d &fusedCov) {
+  StageTimer st(PS_FUSE);                                                          // 処理時間の記録
+
   // ICPの共分散
-  dass->findCorrespondence(curScan, estPose);                                      // 推定位置estPoseで現在スキャン点群と参照スキャン点群の対応づけ
-  double ratio = cvc.calIcpCovariance(estPose, dass->curLps, dass->refLps, ecov);  // ここで得られるのは、地図座標系での位置の共分散
+  // ICPの最後の対応づけが推定位置に十分近い位置でのものなら、それを使う。共分散は推定位置で計算するので、点の組が同じなら結果も同じ
+  double dx = estPose.tx - corrPose.tx;
+  double dy = estPose.ty - corrPose.ty;
+  bool near = (corrReady && dx*dx + dy*dy <= REUSE_DIST*REUSE_DIST && fabs(MyUtil::add(estPose.th, -corrPose.th)) <= REUSE_ANGLE);
+  if (near)
+    profCount(PC_FUSE_REUSED);
+  else
+    dass->findCorrespondence(curScan, estPose);                                    // 推定位置estPoseで現在スキャン点群と参照スキャン点群の対応づけ
+  corrReady = false;
+  double ratio = cvc.calIcpCovariance(estPose, dass->corrs, ecov);                 // ここで得られるのは、地図座標系での位置の共分散
 
   // オドメトリの位置と共分散。速度運動モデルを使うと、短期間では共分散が小さすぎるため、簡易版で大きめに計算する
   Pose2D predPose;                                                                 // 予測位置
   Pose2D::calGlobalPose(odoMotion, lastPose, predPose);                            // 直前位置lastPoseに移動量を加えて予測位置を計算
   Eigen::Matrix3d mcovL;
-  double dT=0.1;
   cvc.calMotionCovarianceSimple(odoMotion, dT, mcovL);                             // オドメトリで得た移動量の共分散（簡易版）
   CovarianceCalculator::rotateCovariance(estPose, mcovL, mcov);                    // 現在位置estPoseで回転させて、地図座標系での共分散mcovを得る
 
@@ -42,26 +57,27 @@ double PoseFuser::fusePose(Scan2D *curScan, const Pose2D &estPose, const Pose2D
 
   totalCov = fusedCov;
 
-  // 確認用
-  printf("fusePose\n");
-  double vals[2], vec1[2], vec2[2];
-  printf("ecov: det=%g, ", ecov.determinant());
-  cvc.calEigen(ecov, vals, vec1, vec2);
-  printf("mcov: det=%g, ", mcov.determinant());
-  cvc.calEigen(mcov, vals, vec1, vec2);
-  printf("fusedCov: det=%g, ", fusedCov.determinant());
-  cvc.calEigen(fusedCov, vals, vec1, vec2);
-
-  printf("predPose: tx=%g, ty=%g, th=%g\n", predPose.tx, predPose.ty, predPose.th);
-  printf("estPose: tx=%g, ty=%g, th=%g\n", estPose.tx, estPose.ty, estPose.th);
-  printf("fusedPose: tx=%g, ty=%g, th=%g\n", fusedPose.tx, fusedPose.ty, fusedPose.th);
+  // 確認用。固有値は表示のためだけに計算するので、ログを出すときだけにする
+  if (SLAM_LOG_ENABLED(SLAM_LOG_DEBUG)) {
+    SLAM_LOGD("fusePose\n");
+    double vals[2], vec1[2], vec2[2];
+    SLAM_LOGD("ecov: det=%g, ", ecov.determinant());
+    cvc.calEigen(ecov, vals, vec1, vec2);
+    SLAM_LOGD("mcov: det=%g, ", mcov.determinant());
+    cvc.calEigen(mcov, vals, vec1, vec2);
+    SLAM_LOGD("fusedCov: det=%g, ", fusedCov.determinant());
+    cvc.calEigen(fusedCov, vals, vec1, vec2);
+  }
+
+  SLAM_LOGD("predPose: tx=%g, ty=%g, th=%g\n", predPose.tx, predPose.ty, predPose.th);
+  SLAM_LOGD("estPose: tx=%g, ty=%g, th=%g\n", estPose.tx, estPose.ty, estPose.th);
+  SLAM_LOGD("fusedPose: tx=%g, ty=%g, th=%g\n", fusedPose.tx, fusedPose.ty, fusedPose.th);
 
   return(ratio);
 }
 
 void PoseFuser::calOdometryCovariance(const Pose2D &odoMotion, const Pose2D &lastPose, Eigen::Matrix3d &mcov) {
   Eigen::Matrix3d mcovL;
-  double dT=0.1;
   cvc.calMotionCovarianceSimple(odoMotion, dT, mcovL);                             // オドメトリで得た移動量の共分散（簡易版）
   CovarianceCalculator::rotateCovariance(lastPose, mcovL, mcov);                   // 直前位置lastPoseで回転させて、位置の共分散mcovを得る
 }
@@ -106,11 +122,11 @@ double PoseFuser::fuse(const Eigen::Vector3d &mu1, const Eigen::Matrix3d &cv1,
   double K = A1+A2-A;
 
 /*
-  printf("cv1: det=%g\n", cv1.determinant());
+  SLAM_LOGD("cv1: det=%g\n", cv1.determinant());
   printMatrix(cv1);
-  printf("cv2: det=%g\n", cv2.determinant());
+  SLAM_LOGD("cv2: det=%g\n", cv2.determinant());
   printMatrix(cv2);
-  printf("cv: det=%g\n", cv.determinant());
+  SLAM_LOGD("cv: det=%g\n", cv.determinant());
   printMatrix(cv);
 */
 
@@ -119,5 +135,5 @@ double PoseFuser::fuse(const Eigen::Vector3d &mu1, const Eigen::Matrix3d &cv1,
 
 void PoseFuser::printMatrix(const Eigen::Matrix3d &mat) {
   for (int i=0; i<3; i++) 
-    printf("%g %g %g\n", mat(i,0), mat(i,1), mat(i,2));
+    SLAM_LOGD("%g %g %g\n", mat(i,0), mat(i,1), mat(i,2));
 }
@@ -32,9 +32,15 @@ public:
   
   DataAssociator *dass;                      // データ対応づけ器
   CovarianceCalculator cvc;                 // 共分散計算器
+  double dT;                                 // スキャン間隔[s]。オドメトリの共分散の計算に使う
+  bool corrReady;                            // dassにcorrPoseでの対応づけ結果がすでにあるか
+  Pose2D corrPose;                           // その対応づけの位置
+
+  static const double REUSE_DIST;            // fusePoseの位置がcorrPoseからこの距離[m]以内なら、対応づけをやり直さない
+  static const double REUSE_ANGLE;           // 同じく角度[度]
 
 public:
-  PoseFuser() {
+  PoseFuser() : dass(nullptr), dT(0.1), corrReady(false) {
   }
 
   ~PoseFuser() {
@@ -48,10 +54,28 @@ public:
 
   void setRefScan(const Scan2D *refScan) {
     dass->setRefBase(refScan->lps);
+    corrReady = false;
   }
 
-  void setRefLps(const std::vector<LPoint2D> &refLps) {
+  void setRefLps(const LPointSpan &refLps) {
     dass->setRefBase(refLps);
+    corrReady = false;
+  }
+
+  // ICPの結果を引き継ぐ。icpDassはICPで使ったデータ対応づけ器で、最後にpで対応づけをしている
+  // 同じ対応づけ器なら参照スキャンは登録済みなので作り直さず、fusePoseの位置がpに十分近ければその対応づけ結果も使う
+  void setIcpResult(const DataAssociator *icpDass, const Pose2D &p, const LPointSpan &refLps) {
+    if (icpDass == dass) {
+      corrReady = true;
+      corrPose = p;
+    }
+    else
+      setRefLps(refLps);
+  }
+
+  // スキャン間隔dt[s]を設定する。スキャンに時刻がない（dtが0以下）ときは0.1秒とみなす
+  void setScanInterval(double dt) {
+    dT = (dt > 0)? dt : 0.1;
   }
 
   // ICPの共分散行列の計算。setRefLpsの後に行うこと。
@@ -59,7 +83,7 @@ public:
     dass->findCorrespondence(curScan, estMotion);
 
     // ICPの共分散。ここで得られるのは、世界座標系での共分散
-    double ratio = cvc.calIcpCovariance(estMotion, dass->curLps, dass->refLps, cov);
+    double ratio = cvc.calIcpCovariance(estMotion, dass->corrs, cov);
     return(ratio);
   }
 
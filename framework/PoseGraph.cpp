@@ -13,6 +13,7 @@
  ****************************************************************************/
 
 #include "PoseGraph.h"
+#include "SlamLog.h"
 
 using namespace std;
 
@@ -77,32 +78,82 @@ PoseArc *PoseGraph::findArc(int srcNid, int dstNid) {
   return(nullptr);
 }
 
+//////////// チェックポイント ////////////
+
+// ノードの位置と、アークの端点・相対位置・情報行列をwに書く。アークは追加した順に書く
+void PoseGraph::writeState(CheckpointWriter &w) const {
+  w.put<uint64_t>(nodes.size());
+  for (size_t i=0; i<nodes.size(); i++)
+    w.put(nodes[i]->pose);
+
+  w.put<uint64_t>(arcs.size());
+  for (size_t i=0; i<arcs.size(); i++) {
+    const PoseArc *a = arcs[i];
+    w.put(a->src->nid);
+    w.put(a->dst->nid);
+    w.put(a->relPose);
+    w.putMatrix(a->inf);
+  }
+}
+
+// writeStateで書いたポーズグラフを読んで作り直す
+bool PoseGraph::readState(CheckpointReader &r) {
+  reset();
+
+  uint64_t nn=0;
+  r.get(nn);
+  for (uint64_t i=0; i<nn && r.isOk(); i++) {
+    Pose2D pose;
+    r.get(pose);
+    addNode(pose);
+  }
+
+  uint64_t an=0;
+  r.get(an);
+  for (uint64_t i=0; i<an && r.isOk(); i++) {
+    int srcNid=-1, dstNid=-1;
+    Pose2D relPose;
+    Eigen::Matrix3d inf;
+    r.get(srcNid);
+    r.get(dstNid);
+    r.get(relPose);
+    r.getMatrix(inf);
+    if (srcNid < 0 || dstNid < 0 || srcNid >= (int)nodes.size() || dstNid >= (int)nodes.size())
+      return(false);
+    PoseArc *arc = allocArc();
+    arc->setup(nodes[srcNid], nodes[dstNid], relPose, inf);    // 情報行列をそのまま使う。makeArcだと逆行列を計算し直してしまう
+    addArc(arc);
+  }
+
+  return(r.isOk());
+}
+
 ////////////////
 
 // 確認用
 void PoseGraph::printNodes() {
-  printf("--- printNodes ---\n");
-  printf("nodes.size=%lu\n", nodes.size());
+  SLAM_LOGD("--- printNodes ---\n");
+  SLAM_LOGD("nodes.size=%lu\n", nodes.size());
   for (size_t i=0; i<nodes.size(); i++) {
     PoseNode *node = nodes[i];
-    printf("i=%lu: nid=%d, tx=%g, ty=%g, th=%g\n", i, node->nid, node->pose.tx, node->pose.ty, node->pose.th);
+    SLAM_LOGD("i=%lu: nid=%d, tx=%g, ty=%g, th=%g\n", i, node->nid, node->pose.tx, node->pose.ty, node->pose.th);
 
     for (size_t j=0; j<node->arcs.size(); j++) {
       PoseArc *a = node->arcs[j];
-      printf("arc j=%lu: srcId=%d, dstId=%d, src=%p, dst=%p\n", j, a->src->nid, a->dst->nid, a->src, a->dst);
+      SLAM_LOGD("arc j=%lu: srcId=%d, dstId=%d, src=%p, dst=%p\n", j, a->src->nid, a->dst->nid, a->src, a->dst);
     }
   }
 }
 
 // 確認用
 void PoseGraph::printArcs() {
-  printf("--- printArcs ---\n");
-  printf("arcs.size=%lu\n", arcs.size());
+  SLAM_LOGD("--- printArcs ---\n");
+  SLAM_LOGD("arcs.size=%lu\n", arcs.size());
   for (size_t j=0; j<arcs.size(); j++) {
     PoseArc *a = arcs[j];
     double dis = (a->src->pose.tx - a->dst->pose.tx)*(a->src->pose.tx - a->dst->pose.tx) + (a->src->pose.ty - a->dst->pose.ty)*(a->src->pose.ty - a->dst->pose.ty);
 
     Pose2D &rpose = a->relPose;
-    printf("j=%lu, srcId=%d, dstId=%d, tx=%g, ty=%g, th=%g\n", j, a->src->nid, a->dst->nid, rpose.tx, rpose.ty, rpose.th);
+    SLAM_LOGD("j=%lu, srcId=%d, dstId=%d, tx=%g, ty=%g, th=%g\n", j, a->src->nid, a->dst->nid, rpose.tx, rpose.ty, rpose.th);
   }
 }
@@ -16,8 +16,11 @@
 #define POSE_GRAPH_H_
 
 #include <vector>
+#include <list>
 #include "MyUtil.h"
 #include "Pose2D.h"
+#include "SlamLog.h"
+#include "CheckpointIO.h"
 
 struct PoseArc;
 
@@ -98,16 +101,18 @@ class PoseGraph
 {
 private:
   static const int POOL_SIZE=100000;
-  std::vector<PoseNode> nodePool;     // ノード生成用のメモリプール
-  std::vector<PoseArc> arcPool;       // アーク生成用のメモリプール
+  std::list<std::vector<PoseNode> > nodePool;  // ノード生成用のメモリプール。POOL_SIZE個ずつのブロックのリスト
+  std::list<std::vector<PoseArc> > arcPool;    // アーク生成用のメモリプール。POOL_SIZE個ずつのブロックのリスト
 
 public:
   std::vector<PoseNode*> nodes;       // ノードの集合
   std::vector<PoseArc*> arcs;         // アークの集合。アークは片方向のみもつ
 
   PoseGraph() {
-    nodePool.reserve(POOL_SIZE);      // メモリプールの領域を最初に確保。vectorはサイズが変わると中身が移動するのでこうしないと危険
-    arcPool.reserve(POOL_SIZE);
+    nodePool.emplace_back();
+    nodePool.back().reserve(POOL_SIZE);    // ブロックの領域を最初に確保。vectorはサイズが変わると中身が移動するのでこうしないと危険
+    arcPool.emplace_back();
+    arcPool.back().reserve(POOL_SIZE);
   }
 
   ~PoseGraph() {
@@ -118,32 +123,34 @@ public:
   void reset() {
     nodes.clear();
     arcs.clear();
-    nodePool.clear();
-    arcPool.clear();
+    nodePool.resize(1);               // 最初のブロックだけ残す
+    nodePool.front().clear();
+    arcPool.resize(1);
+    arcPool.front().clear();
   }
 
   // ノードの生成
   PoseNode *allocNode() {
-    if (nodePool.size() >= POOL_SIZE) {
-      printf("Error: exceeds nodePool capacity\n");
-      return(nullptr);
+    if (nodePool.back().size() >= POOL_SIZE) {     // ブロックが満杯なら新しいブロックを足す。既存のノードは動かない
+      nodePool.emplace_back();
+      nodePool.back().reserve(POOL_SIZE);
     }
-   
+
     PoseNode node;
-    nodePool.emplace_back(node);      // メモリプールに追加して、それを参照する。
-    return(&(nodePool.back()));
+    nodePool.back().emplace_back(node);      // メモリプールに追加して、それを参照する。
+    return(&(nodePool.back().back()));
   }
 
   // アークの生成
   PoseArc *allocArc() {
-    if (arcPool.size() >= POOL_SIZE) {
-      printf("Error: exceeds arcPool capacity\n");
-      return(nullptr);
+    if (arcPool.back().size() >= POOL_SIZE) {      // ブロックが満杯なら新しいブロックを足す。既存のアークは動かない
+      arcPool.emplace_back();
+      arcPool.back().reserve(POOL_SIZE);
     }
 
     PoseArc arc;
-    arcPool.emplace_back(arc);       // メモリプールに追加して、それを参照する。
-    return(&(arcPool.back()));
+    arcPool.back().emplace_back(arc);       // メモリプールに追加して、それを参照する。
+    return(&(arcPool.back().back()));
   }
 
 //////////////
@@ -159,6 +166,9 @@ public:
   void printNodes();
   void printArcs();
 
+  void writeState(CheckpointWriter &w) const;
+  bool readState(CheckpointReader &r);
+
 };
 
 #endif
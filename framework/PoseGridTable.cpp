@@ -0,0 +1,66 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file PoseGridTable.cpp
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#include <algorithm>
+#include "PoseGridTable.h"
+
+using namespace std;
+
+////////////
+
+// 位置(x, y)を含むセルの番号
+pair<int, int> PoseGridTable::cellIndex(double x, double y) const {
+  int xi = static_cast<int>(floor(x/csize));        // 負の座標もあるのでfloorで切り捨てる
+  int yi = static_cast<int>(floor(y/csize));
+  return(make_pair(xi, yi));
+}
+
+// idx番目のロボット位置pを登録する
+void PoseGridTable::addPose(size_t idx, const Pose2D &p) {
+  PoseGridEntry e;
+  e.idx = idx;
+  e.x = p.tx;
+  e.y = p.ty;
+  table[cellIndex(p.tx, p.ty)].push_back(e);
+}
+
+///////////
+
+// 位置pから距離radius以内にあり、インデックスがidxE未満のロボット位置を探す。
+// candsには(距離の2乗, インデックス)を入れ、距離の近い順に並べる。距離が同じならインデックスの小さい順。
+void PoseGridTable::findPoses(const Pose2D &p, double radius, size_t idxE, vector<pair<double, size_t> > &cands) const {
+  cands.clear();
+  double r2 = radius*radius;
+  pair<int, int> c1 = cellIndex(p.tx - radius, p.ty - radius);    // 探索範囲の左下のセル
+  pair<int, int> c2 = cellIndex(p.tx + radius, p.ty + radius);    // 探索範囲の右上のセル
+  for (int yi=c1.second; yi<=c2.second; yi++) {
+    for (int xi=c1.first; xi<=c2.first; xi++) {
+      boost::unordered_map<pair<int, int>, vector<PoseGridEntry> >::const_iterator it = table.find(make_pair(xi, yi));
+      if (it == table.end())
+        continue;
+
+      const vector<PoseGridEntry> &es = it->second;
+      for (size_t i=0; i<es.size(); i++) {
+        const PoseGridEntry &e = es[i];
+        if (e.idx >= idxE)                           // 対象外のロボット位置
+          continue;
+        double d = (p.tx - e.x)*(p.tx - e.x) + (p.ty - e.y)*(p.ty - e.y);
+        if (d <= r2)
+          cands.push_back(make_pair(d, e.idx));
+      }
+    }
+  }
+
+  sort(cands.begin(), cands.end());
+}
@@ -0,0 +1,65 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file PoseGridTable.h
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#ifndef _POSE_GRID_TABLE_H_
+#define _POSE_GRID_TABLE_H_
+
+#include <vector>
+#include <utility>
+#include <boost/unordered_map.hpp>
+#include "Pose2D.h"
+
+// 格子テーブルに登録するロボット位置
+struct PoseGridEntry
+{
+  size_t idx;                         // ロボット軌跡でのインデックス
+  double x, y;                        // 位置
+};
+
+///////
+
+// ロボット位置の格子テーブル（格子ハッシュ）
+// 軌跡の長さによらず、ある位置の近くのロボット位置を定数時間で取り出す
+class PoseGridTable
+{
+private:
+  double csize;                       // セルサイズ[m]
+  boost::unordered_map<std::pair<int, int>, std::vector<PoseGridEntry> > table;   // セル番号をキーにしたテーブル
+
+public:
+  PoseGridTable() : csize(4) {                       // ループ検出の探索半径くらいにする
+  }
+
+  ~PoseGridTable() {
+  }
+
+  void setCellSize(double s) {
+    csize = s;
+    clear();
+  }
+
+  void clear() {
+    table.clear();
+  }
+
+////////////
+
+  void addPose(size_t idx, const Pose2D &p);
+  void findPoses(const Pose2D &p, double radius, size_t idxE, std::vector<std::pair<double, size_t> > &cands) const;
+
+private:
+  std::pair<int, int> cellIndex(double x, double y) const;
+};
+
+#endif
@@ -16,6 +16,7 @@
 #define _POSE_OPTIMIZER_H_
 
 #include <vector>
+#include <chrono>
 #include "MyUtil.h"
 #include "LPoint2D.h"
 #include "Pose2D.h"
@@ -31,11 +32,16 @@ protected:
   double evthre;                // コスト変化閾値。変化量がこれ以下なら繰り返し終了
   double dd;                    // 数値微分の刻み（並進）
   double da;                    // 数値微分の刻み（回転）
+  int maxIter;                  // 繰り返し回数の上限。0なら上限なし
+  bool useDeadline;             // 締切を使うか
+  bool deadlineHit;             // 締切で繰り返しを打ち切ったか
+  int iterNum;                  // 直近のoptimizePoseでの繰り返し回数
+  std::chrono::steady_clock::time_point deadline;    // この時刻を過ぎたら繰り返しを打ち切る
 
   CostFunction *cfunc;          // コスト関数
 
 public:
-  PoseOptimizer(): evthre(0.000001), dd(0.00001), da(0.00001), cfunc(nullptr) {
+  PoseOptimizer(): evthre(0.000001), dd(0.00001), da(0.00001), maxIter(0), useDeadline(false), deadlineHit(false), iterNum(0), cfunc(nullptr) {
     allN=0; sum=0;
   }
 
@@ -52,8 +58,22 @@ public:
     cfunc->setEvlimit(l);
   }
 
-  void setPoints(std::vector<const LPoint2D*> &curLps, std::vector<const LPoint2D*> &refLps) {
-    cfunc->setPoints(curLps, refLps);
+  void setPoints(const CorrespondenceSet &corrs) {
+    cfunc->setPoints(corrs);
+  }
+
+  bool usesCorrespondence() {
+    return(cfunc->usesCorrespondence());
+  }
+
+  // 対応づけを使わないコスト関数に、現在スキャンcurScanと参照スキャンrefLpsを渡す
+  void setScanPair(const Scan2D *curScan, const LPointSpan &refLps) {
+    cfunc->setScan(curScan);
+    cfunc->setRefBase(refLps);
+  }
+
+  size_t getUsedNum() {
+    return(cfunc->getUsedNum());
   }
 
   void setEvthre(double inthre) {
@@ -68,6 +88,42 @@ public:
     da = a;
   }
 
+  // 繰り返しの上限と締切。ICPの中で対応づけごとに呼ぶときは使わず、コスト関数を直接最小化するときに使う
+  void setMaxIteration(int n) {
+    maxIter = n;
+  }
+
+  void setDeadline(const std::chrono::steady_clock::time_point &t) {
+    deadline = t;
+    useDeadline = true;
+  }
+
+  void clearDeadline() {
+    useDeadline = false;
+  }
+
+  bool isDeadlineHit() {
+    return(deadlineHit);
+  }
+
+  int getIterNum() {
+    return(iterNum);
+  }
+
+protected:
+  // n回繰り返した後で、上限か締切により打ち切るか
+  bool checkStop(int n) {
+    if (maxIter > 0 && n >= maxIter)
+      return(true);
+    if (useDeadline && std::chrono::steady_clock::now() >= deadline) {
+      deadlineHit = true;
+      return(true);
+    }
+    return(false);
+  }
+
+public:
+
 ////////
 
   virtual double optimizePose(Pose2D &initPose, Pose2D &estPose) = 0;
@@ -20,13 +20,14 @@
 #include "LPoint2D.h"
 #include "Pose2D.h"
 #include "Scan2D.h"
+#include "LPointSpan.h"
 #include "PointCloudMap.h"
 
 class RefScanMaker
 {
 protected:
   const PointCloudMap *pcmap;           // 点群地図
-  Scan2D refScan;                       // 参照スキャン本体。これを外に提供
+  Scan2D refScan;                       // 参照スキャンの点群を作るときの置き場所
 
 public:
   RefScanMaker() : pcmap(nullptr) {
@@ -39,7 +40,8 @@ public:
     pcmap = p;
   }
 
-  virtual const Scan2D *makeRefScan() = 0;
+  // 参照スキャンの点群（地図座標系）を返す。地図の点群を直接指すことがあるので、次に地図を更新するまでに使い終えること
+  virtual LPointSpan makeRefScan() = 0;
 
 };
 
@@ -16,6 +16,6 @@
 
 using namespace std;
 
-double Scan2D::MAX_SCAN_RANGE = 6;
-double Scan2D::MIN_SCAN_RANGE = 0.1;
+const double Scan2D::MAX_SCAN_RANGE = 6;
+const double Scan2D::MIN_SCAN_RANGE = 0.1;
 
@@ -25,14 +25,16 @@
 // スキャン
 struct Scan2D
 {
-  static double MAX_SCAN_RANGE;              // スキャン点の距離値上限[m]
-  static double MIN_SCAN_RANGE;              // スキャン点の距離値下限[m]
+  static const double MAX_SCAN_RANGE;        // スキャン点の距離値上限の既定値[m]。使う値はSensorDataReaderがもつ
+  static const double MIN_SCAN_RANGE;        // スキャン点の距離値下限の既定値[m]
 
   int sid;                                   // スキャンid
+  double stamp;                              // スキャン取得時刻[s]。時刻がなければ0
   Pose2D pose;                               // スキャン取得時のオドメトリ値
   std::vector<LPoint2D> lps;                 // スキャン点群
+  std::vector<float> phases;                 // 点ごとの走査内の位置（最初のビーム0〜最後のビーム1）。歪み補正に使う。空なら不明
 
-  Scan2D() : sid(0) {
+  Scan2D() : sid(0), stamp(0) {
   }
 
   ~Scan2D() {
@@ -44,6 +46,10 @@ struct Scan2D
     sid = s;
   }
 
+  void setStamp(double t) {
+    stamp = t;
+  }
+
   void setLps (const std::vector<LPoint2D> &ps) {
     lps = ps;
   }
@@ -0,0 +1,82 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file ScanDeskewer.cpp
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#include "ScanDeskewer.h"
+#include "SlamLog.h"
+
+using namespace std;
+
+/////////
+
+const double ScanDeskewer::SMALL_ANGLE = 0.2;
+
+// scanの点群の歪みを補正する。prevScanは1つ前のスキャンで、そのオドメトリ値と時刻を補間に使う
+// 点ごとの走査内の位置（scan.phases）がなければ何もしない。補正したらtrueを返す
+bool ScanDeskewer::deskewPoints(Scan2D &scan, const Scan2D &prevScan) {
+  vector<LPoint2D> &lps = scan.lps;
+  const vector<float> &phases = scan.phases;
+  if (sweepTime <= 0 || lps.empty() || phases.size() != lps.size())
+    return(false);
+
+  double dT = scan.stamp - prevScan.stamp;           // スキャン間隔
+  if (dT <= 0)
+    dT = defaultInterval;
+  double ratio = sweepTime/dT;                        // スキャン間の移動量のうち、走査中に動く割合
+
+  // 前スキャンから見た移動量m。オドメトリは時間に比例して動くとする
+  Pose2D m;
+  Pose2D::calRelativePose(scan.pose, prevScan.pose, m);
+  double mth = DEG2RAD(m.th);
+  double cm = cos(mth);
+  double sm = sin(mth);
+
+  // 最初のビームの時点のロボット位置を、最後のビームの時点のセンサ座標系で表したもの
+  // 走査の残り割合u（最初のビームで1、最後で0）の点は、この回転角と並進にuを掛けたもので移す
+  double a = -ratio*mth;
+  double bx = -ratio*( cm*m.tx + sm*m.ty);
+  double by = -ratio*(-sm*m.tx + cm*m.ty);
+
+  size_t n = lps.size();
+  LPoint2D *lp = lps.data();
+  const float *ph = phases.data();
+  if (fabs(a) < SMALL_ANGLE) {
+    // 回転が小さいときは、cos,sinを多項式で近似する（誤差は1e-7以下）。分岐も関数呼び出しもないので、ループはベクトル化できる
+    for (size_t i=0; i<n; i++) {
+      double u = 1.0 - ph[i];
+      double t = u*a;
+      double t2 = t*t;
+      double c = 1.0 - t2*(0.5 - t2*(1.0/24));
+      double s = t*(1.0 - t2*(1.0/6 - t2*(1.0/120)));
+      double x = lp[i].x;
+      double y = lp[i].y;
+      lp[i].x = c*x - s*y + u*bx;
+      lp[i].y = s*x + c*y + u*by;
+    }
+  }
+  else {
+    for (size_t i=0; i<n; i++) {
+      double u = 1.0 - ph[i];
+      double c = cos(u*a);
+      double s = sin(u*a);
+      double x = lp[i].x;
+      double y = lp[i].y;
+      lp[i].x = c*x - s*y + u*bx;
+      lp[i].y = s*x + c*y + u*by;
+    }
+  }
+
+  SLAM_LOGD("ScanDeskewer: dT=%g, ratio=%g, motion=(%g, %g, %g)\n", dT, ratio, m.tx, m.ty, m.th);
+
+  return(true);
+}
@@ -0,0 +1,61 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file ScanDeskewer.h
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#ifndef SCAN_DESKEWER_H_
+#define SCAN_DESKEWER_H_
+
+#include <vector>
+#include "MyUtil.h"
+#include "LPoint2D.h"
+#include "Pose2D.h"
+#include "Scan2D.h"
+
+// 走査中のロボットの動きによるスキャンの歪みを補正する
+// スキャンの時刻とオドメトリ値は最後のビームのものとし、走査は最初のビームから最後のビームまで等速で進むとする。
+// 各点を計測したときのロボット位置を、前スキャンとのオドメトリ値の間で線形補間して求め、最後のビームの時点のセンサ座標系に移す
+class ScanDeskewer
+{
+private:
+  static const double SMALL_ANGLE;   // 補正の回転角がこれより小さければ、cos,sinを多項式で近似する[rad]
+
+  double sweepTime;                  // 1回の走査にかかる時間[s]。0なら補正しない
+  double defaultInterval;            // スキャンに時刻がないときのスキャン間隔[s]
+
+public:
+  ScanDeskewer() : sweepTime(0), defaultInterval(0.1) {
+  }
+
+  ~ScanDeskewer() {
+  }
+
+///////
+
+  void setSweepTime(double t) {
+    sweepTime = t;
+  }
+
+  double getSweepTime() const {
+    return(sweepTime);
+  }
+
+  void setDefaultInterval(double t) {
+    defaultInterval = t;
+  }
+
+///////
+
+  bool deskewPoints(Scan2D &scan, const Scan2D &prevScan);
+};
+
+#endif
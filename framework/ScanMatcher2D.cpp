@@ -13,24 +13,60 @@
  ****************************************************************************/
 
 #include "ScanMatcher2D.h"
+#include "SlamLog.h"
+#include "StageProfiler.h"
 
 using namespace std;
 
 /////////
 
+const double ScanMatcher2D::ICP_BUDGET_RATIO = 0.8;
+const double ScanMatcher2D::COARSE_RATIO = 2.0;
+const double ScanMatcher2D::LF_INIT_SIGMA = 0.1;
+const double ScanMatcher2D::LF_INIT_SIGMA_TH = 5.0;
+const double ScanMatcher2D::LF_INLIER_RATIO = 0.5;
+const double ScanMatcher2D::LF_JUMP_THRE = 16.3;                 // 自由度3のカイ2乗分布の99.9%点
+
+/////////
+
 // スキャンマッチングの実行
 bool ScanMatcher2D::matchScan(Scan2D &curScan) {
   ++cnt;
+  chrono::steady_clock::time_point tstart = chrono::steady_clock::now();
+  degrade = DEGRADE_NONE;
 
-  printf("----- ScanMatcher2D: cnt=%d start -----\n", cnt);
+  SLAM_LOGD("----- ScanMatcher2D: cnt=%d start -----\n", cnt);
+
+  // sdesが設定されていれば、走査中の移動によるスキャンの歪みを補正する。前スキャンのオドメトリ値との補間なので2個目から
+  if (sdes != nullptr && cnt > 0) {
+    StageTimer st(PS_DESKEW);
+    sdes->deskewPoints(curScan, prevScan);
+  }
+  curScan.phases.clear();                  // 均一化で点が変わるので、ここで捨てる
 
   // spresが設定されていれば、スキャン点間隔を均一化する
-  if (spres != nullptr)
+  if (spres != nullptr) {
+    StageTimer st(PS_RESAMPLE);
+    double dthreS = spres->getDthreS();
+    bool coarse = (timeBudget > 0 && degLevel >= 2);
+    if (coarse) {                                  // 縮退時は点を間引いて、以降の処理を軽くする
+      spres->setDthreS(COARSE_RATIO*dthreS);
+      degrade |= DEGRADE_RESAMPLE;
+    }
     spres->resamplePoints(&curScan);
+    if (coarse)
+      spres->setDthreS(dthreS);
+  }
 
   // spanaが設定されていれば、スキャン点の法線を計算する
-  if (spana != nullptr)
+  if (spana != nullptr) {
+    StageTimer st(PS_ANALYSE);
     spana->analysePoints(curScan.lps);
+  }
+
+  // 位置推定モードでは、静的地図と照合するだけで地図は作らない
+  if (lfest != nullptr)
+    return(localizeScan(curScan));
 
   // 最初のスキャンは単に地図に入れるだけ
   if (cnt == 0) {
@@ -47,31 +83,51 @@ bool ScanMatcher2D::matchScan(Scan2D &curScan) {
   Pose2D predPose;                                               // オドメトリによる予測位置
   Pose2D::calGlobalPose(odoMotion, lastPose, predPose);          // 直前位置に移動量を加えて予測位置を得る
 
-  const Scan2D *refScan = rsm->makeRefScan();                    // 参照スキャンの生成
-  estim->setScanPair(&curScan, refScan);                         // ICPにスキャンを設定
-  printf("curScan.size=%lu, refScan.size=%lu\n", curScan.lps.size(), refScan->lps.size());
+  LPointSpan refLps = rsm->makeRefScan();                        // 参照スキャンの生成
+  estim->setScanPair(&curScan, refLps);                          // ICPにスキャンを設定
+  SLAM_LOGD("curScan.size=%lu, refScan.size=%lu\n", curScan.lps.size(), refLps.size());
+
+  // 処理時間の上限があれば、ICPに締切を設ける。推定器はループ検出と共用なので、終わったら戻す
+  int maxIter = estim->getMaxIteration();
+  if (timeBudget > 0) {
+    if (degLevel >= 1) {
+      estim->setMaxIteration(min(maxIter, ICP_ITER_DEGRADED));
+      degrade |= DEGRADE_ICP_ITER;
+    }
+    chrono::duration<double> icpBudget(ICP_BUDGET_RATIO*timeBudget);
+    estim->setDeadline(tstart + chrono::duration_cast<chrono::steady_clock::duration>(icpBudget));
+  }
 
   Pose2D estPose;                                                // ICPによる推定位置
   double score = estim->estimatePose(predPose, estPose);         // 予測位置を初期値にしてICPを実行
   size_t usedNum = estim->getUsedNum();
 
+  if (timeBudget > 0) {
+    if (estim->isDeadlineHit())
+      degrade |= DEGRADE_ICP_DEADLINE;
+    estim->setMaxIteration(maxIter);
+    estim->clearDeadline();
+  }
+
   bool successful;                                               // スキャンマッチングに成功したかどうか
   if (score <= scthre && usedNum >= nthre)                       // スコアが閾値より小さければ成功とする
     successful = true;
   else 
     successful = false;
-  printf("score=%g, usedNum=%lu, successful=%d\n", score, usedNum, successful);
+  SLAM_LOGD("score=%g, usedNum=%lu, successful=%d\n", score, usedNum, successful);
 
   if (dgcheck) {                         // 退化の対処をする場合
+    pfu->setScanInterval(curScan.stamp - prevScan.stamp);     // オドメトリの共分散はスキャン間隔で決まる
     if (successful) {
       Pose2D fusedPose;                       // 融合結果
       Eigen::Matrix3d fusedCov;               // センサ融合後の共分散
-      pfu->setRefScan(refScan);
+      const DataAssociator *icpDass = estim->hasCorrespondence()? estim->getDataAssociator() : nullptr;
+      pfu->setIcpResult(icpDass, estim->getCorrespondencePose(), refLps);   // 対応づけはICPのものを使えることがある
       // センサ融合器pfuで、ICP結果とオドメトリ値を融合する
       double ratio = pfu->fusePose(&curScan, estPose, odoMotion, lastPose, fusedPose, fusedCov);
       estPose = fusedPose;
       cov = fusedCov;
-      printf("ratio=%g. Pose fused.\n", ratio);     // ratioは退化度。確認用
+      SLAM_LOGD("ratio=%g. Pose fused.\n", ratio);  // ratioは退化度。確認用
 
       // 共分散を累積する
       Eigen::Matrix3d covL;               // 移動量の共分散
@@ -94,39 +150,103 @@ bool ScanMatcher2D::matchScan(Scan2D &curScan) {
   prevScan = curScan;                      // 直前スキャンの設定
 
   // 確認用
-//  printf("lastPose: tx=%g, ty=%g, th=%g\n", lastPose.tx, lastPose.ty, lastPose.th);
-  printf("predPose: tx=%g, ty=%g, th=%g\n", predPose.tx, predPose.ty, predPose.th);     // 確認用
-  printf("estPose: tx=%g, ty=%g, th=%g\n", estPose.tx, estPose.ty, estPose.th);
-  printf("cov: %g, %g, %g, %g\n", totalCov(0,0), totalCov(0,1), totalCov(1,0), totalCov(1,1));
-  printf("mcov: %g, %g, %g, %g\n", pfu->mcov(0,0), pfu->mcov(0,1), pfu->mcov(1,0), pfu->mcov(1,1));
-  printf("ecov: %g, %g, %g, %g\n", pfu->ecov(0,0), pfu->ecov(0,1), pfu->ecov(1,0), pfu->ecov(1,1));
+//  SLAM_LOGD("lastPose: tx=%g, ty=%g, th=%g\n", lastPose.tx, lastPose.ty, lastPose.th);
+  SLAM_LOGD("predPose: tx=%g, ty=%g, th=%g\n", predPose.tx, predPose.ty, predPose.th);  // 確認用
+  SLAM_LOGD("estPose: tx=%g, ty=%g, th=%g\n", estPose.tx, estPose.ty, estPose.th);
+  SLAM_LOGD("cov: %g, %g, %g, %g\n", totalCov(0,0), totalCov(0,1), totalCov(1,0), totalCov(1,1));
+  SLAM_LOGD("mcov: %g, %g, %g, %g\n", pfu->mcov(0,0), pfu->mcov(0,1), pfu->mcov(1,0), pfu->mcov(1,1));
+  SLAM_LOGD("ecov: %g, %g, %g, %g\n", pfu->ecov(0,0), pfu->ecov(0,1), pfu->ecov(1,0), pfu->ecov(1,1));
 
   // 共分散の保存（確認用）
 //  PoseCov pcov(estPose, cov);
 //  PoseCov pcov(estPose, totalCov);
 //  PoseCov pcov(estPose, pfu->mcov);
   PoseCov pcov(estPose, pfu->ecov);
-  poseCovs.emplace_back(pcov);
+  poseCovs.push_back(pcov);
 
   // 累積走行距離の計算（確認用）
   Pose2D estMotion;                                                    // 推定移動量
   Pose2D::calRelativePose(estPose, lastPose, estMotion);
   atd += sqrt(estMotion.tx*estMotion.tx + estMotion.ty*estMotion.ty); 
-  printf("atd=%g\n", atd);
+  SLAM_LOGD("atd=%g\n", atd);
 
   return(successful);
 }
 
 ////////////////////
 
+// 前処理を済ませた現在スキャンを、静的地図の距離場と照合してロボット位置を求める
+// 地図、部分地図、ポーズグラフは更新せず、点群地図には直前位置だけを入れるので、メモリは増えない
+// 最初のスキャンは初期位置initPoseの近く（LF_INIT_SIGMA程度）にあるとする
+// totalCovを位置の共分散として、オドメトリで予測し、距離場との照合で更新する。予測位置は照合の事前分布にもする
+// 照合結果が予測から離れすぎるか、使えた点の割合が小さければ、見失ったとみなして予測位置を使う。共分散が広がるので、後で引き戻せる
+bool ScanMatcher2D::localizeScan(Scan2D &curScan) {
+  Pose2D odoMotion;                                              // オドメトリに基づく移動量
+  Pose2D lastPose = initPose;                                    // 直前位置
+  Pose2D predPose = initPose;                                    // オドメトリによる予測位置
+  Eigen::Matrix3d mcov;                                          // オドメトリによる移動の共分散（地図座標系）
+  Eigen::Matrix3d predCov;                                       // 予測位置の共分散
+  if (cnt == 0) {
+    mcov.setZero();
+    predCov.setZero();
+    predCov(0,0) = predCov(1,1) = LF_INIT_SIGMA*LF_INIT_SIGMA;
+    predCov(2,2) = DEG2RAD(LF_INIT_SIGMA_TH)*DEG2RAD(LF_INIT_SIGMA_TH);
+  }
+  else {
+    Pose2D::calRelativePose(curScan.pose, prevScan.pose, odoMotion);
+    lastPose = pcmap->getLastPose();
+    Pose2D::calGlobalPose(odoMotion, lastPose, predPose);
+    pfu->setScanInterval(curScan.stamp - prevScan.stamp);
+    pfu->calOdometryCovariance(odoMotion, lastPose, mcov);
+    Eigen::Matrix3d mcovL;                                       // 移動量の共分散
+    CovarianceCalculator::rotateCovariance(lastPose, mcov, mcovL, true);
+    CovarianceCalculator::accumulateCovariance(predPose, lastPose, totalCov, mcovL, predCov);
+  }
+
+  Pose2D estPose;
+  lfest->setPrior(predPose, predCov);
+  double score = lfest->estimatePose(curScan, predPose, estPose);
+  lfest->clearPrior();
+  size_t usedNum = lfest->getUsedNum();
+  double inlierRatio = lfest->getInlierRatio();
+
+  // 予測位置からのずれのマハラノビス距離の2乗
+  Eigen::Vector3d r(estPose.tx - predPose.tx, estPose.ty - predPose.ty, DEG2RAD(MyUtil::add(estPose.th, -predPose.th)));
+  double jump = r.dot(MyUtil::symInverse(predCov)*r);
+
+  bool successful = (score <= lfthre && usedNum >= nthre && inlierRatio >= LF_INLIER_RATIO && jump <= LF_JUMP_THRE);
+  SLAM_LOGD("score=%g, usedNum=%lu, inlierRatio=%g, jump=%g, successful=%d\n", score, usedNum, inlierRatio, jump, successful);
+
+  if (successful) {
+    lfest->getCovariance(cov);             // 予測と融合した共分散
+    totalCov = cov;
+  }
+  else {                                   // 照合に失敗したら、オドメトリによる予測位置を使う
+    estPose = predPose;
+    cov = mcov;
+    totalCov = predCov;
+  }
+
+  pcmap->setLastPose(estPose);
+  prevScan = curScan;
+
+  Pose2D estMotion;                                              // 推定移動量
+  Pose2D::calRelativePose(estPose, lastPose, estMotion);
+  atd += sqrt(estMotion.tx*estMotion.tx + estMotion.ty*estMotion.ty);
+  SLAM_LOGD("estPose: tx=%g, ty=%g, th=%g\n", estPose.tx, estPose.ty, estPose.th);
+
+  return(successful);
+}
+
 // 現在スキャンを追加して、地図を成長させる
 void ScanMatcher2D::growMap(const Scan2D &scan, const Pose2D &pose) {
+  StageTimer st(PS_GROWMAP);                             // 局所地図の生成も含む
   const vector<LPoint2D> &lps = scan.lps;                // スキャン点群(ロボット座標系)
   const double (*R)[2] = pose.Rmat;                      // 推定したロボット位置
   double tx = pose.tx;
   double ty = pose.ty;
 
-  vector<LPoint2D> scanG;                                // 地図座標系での点群
+  scanG.clear();                                         // 地図座標系での点群。領域は使い回す
   for(size_t i=0; i<lps.size(); i++) {
     const LPoint2D &lp = lps[i];
     if (lp.type == ISOLATE)                              // 孤立点（法線なし）は除外
@@ -147,7 +267,46 @@ void ScanMatcher2D::growMap(const Scan2D &scan, const Pose2D &pose) {
   pcmap->addPoints(scanG);
   pcmap->setLastPose(pose);
   pcmap->setLastScan(scan);          // 参照スキャン用に保存
-  pcmap->makeLocalMap();             // 局所地図を生成
+  {
+    StageTimer stl(PS_LOCALMAP);
+    pcmap->makeLocalMap();           // 局所地図を生成
+  }
   
-  printf("ScanMatcher: estPose: tx=%g, ty=%g, th=%g\n", pose.tx, pose.ty, pose.th);    // 確認用
+  SLAM_LOGD("ScanMatcher: estPose: tx=%g, ty=%g, th=%g\n", pose.tx, pose.ty, pose.th); // 確認用
+}
+
+// 1スキャン全体の処理時間elapsed[s]から、次のスキャンの縮退段階を決める
+// 上限を超えたら1段階上げ、上限の半分に収まったら1段階戻す
+void ScanMatcher2D::updateDegradeLevel(double elapsed) {
+  if (timeBudget <= 0)
+    return;
+
+  if (elapsed > timeBudget && degLevel < DEGRADE_LEVEL_MAX)
+    ++degLevel;
+  else if (elapsed < 0.5*timeBudget && degLevel > 0)
+    --degLevel;
+}
+
+////////////////////
+
+// 次のスキャンの処理に使う状態をwに書く
+void ScanMatcher2D::writeState(CheckpointWriter &w) const {
+  w.put(cnt);
+  w.putScan(prevScan);
+  w.put(initPose);
+  w.put(atd);
+  w.put(degLevel);
+  w.putMatrix(cov);
+  w.putMatrix(totalCov);
+}
+
+bool ScanMatcher2D::readState(CheckpointReader &r) {
+  r.get(cnt);
+  r.getScan(prevScan);
+  r.get(initPose);
+  r.get(atd);
+  r.get(degLevel);
+  r.getMatrix(cov);
+  r.getMatrix(totalCov);
+  return(r.isOk());
 }
@@ -16,43 +16,72 @@
 #define SCAN_MATCHER2D_H_
 
 #include <vector>
+#include <boost/circular_buffer.hpp>
 #include "MyUtil.h"
 #include "LPoint2D.h"
 #include "Pose2D.h"
 #include "Scan2D.h"
 #include "PointCloudMap.h"
 #include "RefScanMaker.h"
+#include "ScanDeskewer.h"
 #include "ScanPointResampler.h"
 #include "ScanPointAnalyser.h"
 #include "PoseEstimatorICP.h"
+#include "PoseEstimatorLF.h"
 #include "PoseFuser.h"
+#include "CheckpointIO.h"
+
+// 1スキャンの処理時間の上限を守るために行った縮退。論理和で組み合わせる
+enum DegradeFlag {
+  DEGRADE_NONE=0,
+  DEGRADE_ICP_ITER=1,           // ICPの繰り返し回数の上限を下げた
+  DEGRADE_ICP_DEADLINE=2,       // 時間切れでICPを打ち切った
+  DEGRADE_RESAMPLE=4,           // スキャン点の間隔を粗くした
+  DEGRADE_SKIP_GLOBALMAP=8      // キーフレームでの全体地図の生成を省いた
+};
 
 // ICPを用いてスキャンマッチングを行う
 class ScanMatcher2D
 {
 private:
+  static const int DEGRADE_LEVEL_MAX = 3;       // 縮退段階の最大。1:ICP回数、2:点間隔、3:全体地図
+  static const int ICP_ITER_DEGRADED = 10;      // 縮退時のICPの繰り返し回数の上限
+  static const double ICP_BUDGET_RATIO;         // 処理時間の上限のうちICPに使える割合
+  static const double COARSE_RATIO;             // 縮退時にスキャン点の間隔を何倍にするか
+  static const double LF_INIT_SIGMA;            // 位置推定で、最初の位置の標準偏差[m]
+  static const double LF_INIT_SIGMA_TH;         // 同じく角度[度]
+  static const double LF_INLIER_RATIO;          // 位置推定で、使えた点の割合がこれより小さいと見失ったとみなす
+  static const double LF_JUMP_THRE;             // 位置推定で、予測位置からのずれのマハラノビス距離の2乗がこれより大きいと見失ったとみなす
+
   int cnt;                                // 論理時刻。スキャン番号に対応
   Scan2D prevScan;                        // 1つ前のスキャン
   Pose2D initPose;                        // 地図の原点の位置。通常(0,0,0)
 
   double scthre;                          // スコア閾値。これより大きいとICP失敗とみなす
   double nthre;                           // 使用点数閾値。これより小さいとICP失敗とみなす
+  double lfthre;                          // 位置推定のスコア閾値[m^2]。距離の2乗平均がこれより大きいと失敗とみなす
   double atd;                             // 累積走行距離。確認用
   bool dgcheck;                           // 退化処理をするか
+  double timeBudget;                      // 1スキャンの処理時間の上限[s]。0なら上限なし
+  int degLevel;                           // 現在の縮退段階。0なら縮退しない
+  unsigned int degrade;                   // 直近のスキャンで行った縮退（DegradeFlagの論理和）
 
   PoseEstimatorICP *estim;                // ロボット位置推定器
+  PoseEstimatorLF *lfest;                 // 静的地図の距離場による位置推定器。設定されていれば地図を作らず位置推定だけ行う
   PointCloudMap *pcmap;                   // 点群地図
+  ScanDeskewer *sdes;                     // スキャンの歪み補正
   ScanPointResampler *spres;              // スキャン点間隔均一化
   ScanPointAnalyser *spana;               // スキャン点法線計算
   RefScanMaker *rsm;                      // 参照スキャン生成
   PoseFuser *pfu;                         // センサ融合器
   Eigen::Matrix3d cov;                    // ロボット移動量の共分散行列
   Eigen::Matrix3d totalCov;               // ロボット位置の共分散行列
+  std::vector<LPoint2D> scanG;            // 地図座標系に変換した現在スキャンの点群。作業用
 
-  std::vector<PoseCov> poseCovs;          // デバッグ用
+  boost::circular_buffer<PoseCov> poseCovs;   // デバッグ用。直近のものだけ残す
 
 public:
-  ScanMatcher2D() : cnt(-1), scthre(1.0), nthre(50), dgcheck(false), atd(0), pcmap(nullptr), spres(nullptr), spana(nullptr), estim(nullptr), rsm(nullptr), pfu(nullptr) {
+  ScanMatcher2D() : cnt(-1), scthre(1.0), nthre(50), lfthre(0.01), dgcheck(false), timeBudget(0), degLevel(0), degrade(DEGRADE_NONE), atd(0), pcmap(nullptr), sdes(nullptr), spres(nullptr), spana(nullptr), estim(nullptr), lfest(nullptr), rsm(nullptr), pfu(nullptr), poseCovs(1000) {
   }
 
   ~ScanMatcher2D() {
@@ -68,6 +97,19 @@ public:
     pfu = p;
   }
 
+  // 位置推定モードにする。nullptrならSLAMに戻す
+  void setFieldEstimator(PoseEstimatorLF *p) {
+    lfest = p;
+  }
+
+  bool isLocalizing() {
+    return(lfest != nullptr);
+  }
+
+  void setScanDeskewer(ScanDeskewer *s) {
+    sdes = s;
+  }
+
   void setScanPointResampler(ScanPointResampler *s) {
     spres = s;
   }
@@ -107,14 +149,41 @@ public:
   }
 
   // デバッグ用
-  std::vector<PoseCov> &getPoseCovs() {
+  boost::circular_buffer<PoseCov> &getPoseCovs() {
     return(poseCovs);
   }
+
+  // 残す共分散の個数。長時間走行でメモリが増え続けないようにする
+  void setPoseCovCapacity(size_t n) {
+    poseCovs.set_capacity(n);
+  }
+
+  // 1スキャンの処理時間の上限[s]。超えそうなときは精度を落として間に合わせる。0なら上限なし
+  void setTimeBudget(double t) {
+    timeBudget = t;
+    degLevel = 0;
+  }
+
+  double getTimeBudget() {
+    return(timeBudget);
+  }
+
+  int getDegradeLevel() {
+    return(degLevel);
+  }
+
+  unsigned int getDegradation() {
+    return(degrade);
+  }
   
 //////////
 
   bool matchScan(Scan2D &scan);
+  bool localizeScan(Scan2D &scan);
   void growMap(const Scan2D &scan, const Pose2D &pose);
+  void updateDegradeLevel(double elapsed);
+  void writeState(CheckpointWriter &w) const;
+  bool readState(CheckpointReader &r);
 
 };
 
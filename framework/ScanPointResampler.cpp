@@ -13,6 +13,7 @@
  ****************************************************************************/
 
 #include "ScanPointResampler.h"
+#include "SlamLog.h"
 
 using namespace std;
 
@@ -23,7 +24,7 @@ void ScanPointResampler::resamplePoints(Scan2D *scan) {
   if (lps.size() == 0)
     return;
 
-  vector<LPoint2D> newLps;                     // リサンプル後の点群
+  newLps.clear();                              // リサンプル後の点群。領域は使い回す
 
   dis = 0;                                     // disは累積距離
   LPoint2D lp = lps[0];
@@ -47,9 +48,9 @@ void ScanPointResampler::resamplePoints(Scan2D *scan) {
       prevLp = lp;                             // 今のlpが直前点になる
   }
 
-  scan->setLps(newLps);
+  SLAM_LOGD("lps.size=%lu, newLps.size=%lu\n", lps.size(), newLps.size()); // 確認用
 
-  printf("lps.size=%lu, newLps.size=%lu\n", lps.size(), newLps.size());    // 確認用
+  lps.swap(newLps);                            // コピーせずに入れ替える。元の点群の領域は次回のnewLpsになる
 }
 
 bool ScanPointResampler::findInterpolatePoint(const LPoint2D &cp, const LPoint2D &pp, LPoint2D &np, bool &inserted) {
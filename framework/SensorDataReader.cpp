@@ -12,12 +12,16 @@
  * @author Masahiro Tomono
  ****************************************************************************/
 
+#include <cstdlib>
+#include <algorithm>
 #include "SensorDataReader.h"
+#include "StageProfiler.h"
 
 using namespace std;
 
 // ファイルからスキャンを1個読む
 bool SensorDataReader::loadScan(size_t cnt, Scan2D &scan) {
+  StageTimer st(PS_READ);                // 処理時間の記録
   bool isScan=false;
   while (!inFile.eof() && !isScan) {     // スキャンを読むまで続ける
     isScan = loadLaserScan(cnt, scan);
@@ -38,43 +42,101 @@ bool SensorDataReader::loadLaserScan(size_t cnt, Scan2D &scan) {
   if (type == "LASERSCAN") {             // スキャンの場合
     scan.setSid(cnt);
 
-    int sid, sec, nsec;
-    inFile >> sid >> sec >> nsec;        // これらは使わない
-
-    vector<LPoint2D> lps;
-    int pnum;                            // スキャン点数
-    inFile >> pnum;
-    lps.reserve(pnum);
-    for (int i=0; i<pnum; i++) {
-      float angle, range;
-      inFile >> angle >> range;          // スキャン点の方位と距離
-      angle += angleOffset;              // レーザスキャナの方向オフセットを考慮
-      if (range <= Scan2D::MIN_SCAN_RANGE || range >= Scan2D::MAX_SCAN_RANGE) {
-//      if (range <= Scan2D::MIN_SCAN_RANGE || range >= 3.5) {         // わざと退化を起こしやすく
-        continue;
-      }
-
-      LPoint2D lp;
-      lp.setSid(cnt);                    // スキャン番号はcnt（通し番号）にする
-      lp.calXY(range, angle);            // angle,rangeから点の位置xyを計算
-      lps.emplace_back(lp);
+    // 1行をまとめて読んで、数値はstrtol,strtodで取り出す。ストリームで1個ずつ読むより速い
+    getline(inFile, line);
+    char *p = &line[0];
+
+    strtol(p, &p, 10);                   // sidは使わない
+    long sec = strtol(p, &p, 10);
+    long nsec = strtol(p, &p, 10);
+    scan.setStamp(sec + 1.0E-9*nsec);    // 取得時刻[s]
+
+    long pnum = strtol(p, &p, 10);       // スキャン点数
+    if (pnum < 0)
+      pnum = 0;
+    angles.resize(pnum);
+    ranges.resize(pnum);
+    for (long i=0; i<pnum; i++) {
+      float angle = strtof(p, &p);       // スキャン点の方位と距離
+      float range = strtof(p, &p);
+      angles[i] = angle + angleOffset;   // レーザスキャナの方向オフセットを考慮
+      ranges[i] = range;
     }
-    scan.setLps(lps);
+    convertPoints(cnt, scan);            // 方位と距離から点の位置xyを計算
 
     // スキャンに対応するオドメトリ情報
     Pose2D &pose = scan.pose;
-    inFile >> pose.tx >> pose.ty;
-    double th;
-    inFile >> th;
+    pose.tx = strtod(p, &p);
+    pose.ty = strtod(p, &p);
+    double th = strtod(p, &p);
     pose.setAngle(RAD2DEG(th));          // オドメトリ角度はラジアンなので度にする
     pose.calRmat();
 
     return(true);
   }
   else {                                 // スキャン以外の場合
-    string line;
     getline(inFile, line);               // 読み飛ばす
 
     return(false);
   }
 }
+
+//////////////
+
+// ビームの方位が前のスキャンと違えば、cos,sinの表を作り直す。普通は最初のスキャンで1回だけ作る
+void SensorDataReader::updateBeamTable() {
+  if (tabAngles.size() == angles.size() && equal(angles.begin(), angles.end(), tabAngles.begin()))
+    return;
+
+  size_t n = angles.size();
+  tabAngles = angles;
+  cosTab.resize(n);
+  sinTab.resize(n);
+  for (size_t i=0; i<n; i++) {
+    double a = DEG2RAD(angles[i]);
+    cosTab[i] = cos(a);
+    sinTab[i] = sin(a);
+  }
+  SLAM_LOGD("SensorDataReader: beam table updated. n=%lu\n", n);
+}
+
+// 読んだ方位と距離からスキャン点群を作る。距離が範囲外の点は入れない
+// 座標の計算と範囲の判定は、分岐のない配列演算にしてベクトル化できるようにし、点群に詰めるところだけ別にする
+void SensorDataReader::convertPoints(size_t cnt, Scan2D &scan) {
+  updateBeamTable();
+
+  size_t n = ranges.size();
+  xs.resize(n);
+  ys.resize(n);
+  valid.resize(n);
+  const float *r = ranges.data();
+  const double *ct = cosTab.data();
+  const double *st = sinTab.data();
+  double *x = xs.data();
+  double *y = ys.data();
+  unsigned char *v = valid.data();
+  double rmin = minRange;
+  double rmax = maxRange;
+//double rmax = 3.5;                     // わざと退化を起こしやすく
+  for (size_t i=0; i<n; i++) {
+    double ri = r[i];
+    x[i] = ri*ct[i];
+    y[i] = ri*st[i];
+    v[i] = (ri > rmin) & (ri < rmax);
+  }
+
+  vector<LPoint2D> &lps = scan.lps;
+  lps.clear();
+  lps.reserve(n);
+  scan.phases.clear();
+  double dphase = (n > 1)? 1.0/(n - 1) : 0;
+  for (size_t i=0; i<n; i++) {
+    if (!v[i])
+      continue;
+    LPoint2D lp;
+    lp.setSid(cnt);                      // スキャン番号はcnt（通し番号）にする
+    lp.setXY(x[i], y[i]);
+    lps.emplace_back(lp);
+    scan.phases.push_back(static_cast<float>(i*dphase));    // 走査内の位置。歪み補正に使う
+  }
+}
@@ -17,11 +17,13 @@
 
 #include <iostream>
 #include <fstream>
+#include <string>
 #include <vector>
 #include "MyUtil.h"
 #include "LPoint2D.h"
 #include "Pose2D.h"
 #include "Scan2D.h"
+#include "SlamLog.h"
 
 /////////
 
@@ -29,10 +31,22 @@ class SensorDataReader
 {
 private:
   int angleOffset;                      // レーザスキャナとロボットの向きのオフセット
+  double minRange;                      // スキャン点の距離値下限[m]。これ以下の点は捨てる
+  double maxRange;                      // スキャン点の距離値上限[m]。これ以上の点は捨てる
   std::ifstream inFile;                 // データファイル
+  std::string line;                     // 読んだ1行。作業用
+
+  // 極座標から直交座標への変換用。方位はセンサが同じなら毎スキャン同じなので、cos,sinを表にしておく
+  std::vector<float> angles;            // 読んだスキャンのビームの方位[度]（オフセット込み）
+  std::vector<float> ranges;            // 読んだスキャンのビームの距離[m]
+  std::vector<float> tabAngles;         // 表を作ったときのビームの方位。anglesと違えば作り直す
+  std::vector<double> cosTab;           // ビームごとのcos
+  std::vector<double> sinTab;           // ビームごとのsin
+  std::vector<double> xs, ys;           // 変換結果。作業用
+  std::vector<unsigned char> valid;     // 距離が範囲内か。作業用
 
 public:
-  SensorDataReader() : angleOffset(180) {
+  SensorDataReader() : angleOffset(180), minRange(Scan2D::MIN_SCAN_RANGE), maxRange(Scan2D::MAX_SCAN_RANGE) {
   }
 
   ~SensorDataReader() {
@@ -43,7 +57,7 @@ public:
   bool openScanFile(const char *filepath) {
     inFile.open(filepath);
     if (!inFile.is_open()) {
-      std::cerr << "Error: cannot open file " << filepath << std::endl;
+      SLAM_LOGE("Error: cannot open file %s\n", filepath);
       return(false);
     }
 
@@ -58,10 +72,19 @@ public:
      angleOffset = o;
   }
 
+  void setScanRange(double rmin, double rmax) {
+    minRange = rmin;
+    maxRange = rmax;
+  }
+
 //////////
 
   bool loadScan(size_t cnt, Scan2D &scan);
   bool loadLaserScan(size_t cnt, Scan2D &scan);
+
+private:
+  void updateBeamTable();
+  void convertPoints(size_t cnt, Scan2D &scan);
 };
 
 #endif
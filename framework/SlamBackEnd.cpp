@@ -13,6 +13,7 @@
  ****************************************************************************/
 
 #include "SlamBackEnd.h"
+#include "SlamLog.h"
 #include "P2oDriver2D.h"
 
 using namespace std;
@@ -41,7 +42,7 @@ void SlamBackEnd::remakeMaps() {
     PoseNode *pnode = pnodes[i];              // ノードはロボット位置と1:1対応
     pnode->setPose(npose);                    // 各ノードの位置を更新
   }
-  printf("newPoses.size=%lu, nodes.size=%lu\n", newPoses.size(), pnodes.size());
+  SLAM_LOGD("newPoses.size=%lu, nodes.size=%lu\n", newPoses.size(), pnodes.size());
 
   // PointCloudMapの修正
   pcmap->remakeMaps(newPoses);
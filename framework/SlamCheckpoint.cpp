@@ -0,0 +1,170 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file SlamCheckpoint.cpp
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#include <cstdio>
+#include <chrono>
+#include <algorithm>
+#include "SlamCheckpoint.h"
+#include "SlamLog.h"
+
+using namespace std;
+
+const uint32_t SlamCheckpoint::MAGIC = 0x50434c53;          // "SLCP"
+const uint32_t SlamCheckpoint::VERSION = 2;
+
+//////////
+
+// 状態をwに書く。先頭に識別子、版、型の大きさを置き、違う形式のファイルを読まないようにする
+// 退避した部分地図のリンクは、ここで（SLAMを進める前に）作るので、書いた時点の中身が残る
+void SlamCheckpoint::snapshot(SlamFrontEnd &sfront, const string &path, CheckpointWriter &w) {
+  int cnt = sfront.getCnt();
+  w.clear();
+  w.setFilePrefix(filePrefix(path, cnt));
+  w.put(MAGIC);
+  w.put(VERSION);
+  w.put(static_cast<uint32_t>(sizeof(LPoint2D)));
+  w.put(static_cast<uint32_t>(sizeof(Pose2D)));
+  w.put(cnt);                               // 一緒に残すファイルの名前に使う
+  sfront.writeState(w);
+  w.put<uint64_t>(w.getFiles().size());
+}
+
+// writerの内容をファイルpathに書き、領域を解放する
+// 書けたら前のチェックポイントと一緒に残したファイルを消し、書けなければ今回残したファイルを消す
+bool SlamCheckpoint::commit(const string &path) {
+  bool flag = writeFile(path, writer.getBuffer());
+  writer.release();
+
+  const vector<string> &files = writer.getFiles();
+  const vector<string> &used = flag? files : keptFiles;        // 残っているチェックポイントが使うファイル
+  const vector<string> &unused = flag? keptFiles : files;
+  for (size_t i=0; i<unused.size(); i++) {
+    if (find(used.begin(), used.end(), unused[i]) == used.end())
+      remove(unused[i].c_str());
+  }
+  if (flag)
+    keptFiles = files;
+
+  return(flag);
+}
+
+// 状態をファイルpathに保存する。終わるまで戻らない
+bool SlamCheckpoint::save(SlamFrontEnd &sfront, const string &path) {
+  wait();                                   // 非同期保存が残っていれば先に終える
+  snapshot(sfront, path, writer);
+  return(commit(path));
+}
+
+// 状態をメモリに写してから戻り、ファイルへの書き出しは別スレッドで行う
+// 前の書き出しが終わっていなければ、それを待ってから写す
+bool SlamCheckpoint::saveAsync(SlamFrontEnd &sfront, const string &path) {
+  wait();
+  if (!lastOk)
+    SLAM_LOGW("Warning: previous checkpoint was not written.\n");
+
+  chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+  snapshot(sfront, path, writer);
+  double t = 1000*chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+  SLAM_LOGD("SlamCheckpoint: snapshot %lu bytes, %lu files in %g ms\n", writer.getBuffer().size(), writer.getFiles().size(), t);
+
+  lastOk = true;
+  worker = thread([this, path]() {
+    lastOk = commit(path);
+  });
+
+  return(true);
+}
+
+// 非同期保存の書き出しが終わるまで待つ
+void SlamCheckpoint::wait() {
+  if (worker.joinable())
+    worker.join();
+}
+
+// ファイルpathから状態を読み戻す。読めなければfalseを返す。途中で壊れていたときはsfrontの状態は使えない
+bool SlamCheckpoint::load(SlamFrontEnd &sfront, const string &path) {
+  chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (fp == nullptr) {
+    SLAM_LOGE("Error: cannot open checkpoint %s\n", path.c_str());
+    return(false);
+  }
+  vector<char> buf;
+  if (fseek(fp, 0, SEEK_END) == 0) {
+    long size = ftell(fp);
+    if (size > 0) {
+      buf.resize(size);
+      fseek(fp, 0, SEEK_SET);
+      if (fread(buf.data(), 1, buf.size(), fp) != buf.size())
+        buf.clear();
+    }
+  }
+  fclose(fp);
+
+  CheckpointReader r(buf.data(), buf.size());
+  uint32_t magic=0, version=0, lpSize=0, poseSize=0;
+  int cnt=0;
+  r.get(magic);
+  r.get(version);
+  r.get(lpSize);
+  r.get(poseSize);
+  r.get(cnt);
+  if (!r.isOk() || magic != MAGIC || version != VERSION || lpSize != sizeof(LPoint2D) || poseSize != sizeof(Pose2D)) {
+    SLAM_LOGE("Error: %s is not a checkpoint of this version.\n", path.c_str());
+    return(false);
+  }
+  r.setFilePrefix(filePrefix(path, cnt));
+
+  uint64_t fileNum=0;
+  bool flag = sfront.readState(r);
+  r.get(fileNum);
+  if (!flag || !r.atEnd()) {
+    SLAM_LOGE("Error: broken checkpoint %s\n", path.c_str());
+    return(false);
+  }
+
+  keptFiles.clear();                        // 次のチェックポイントを書き終えたら消す
+  for (uint64_t k=0; k<fileNum; k++)
+    keptFiles.push_back(r.getFilePath(k));
+
+  double t = 1000*chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+  SLAM_LOGI("Checkpoint loaded: %s (%lu bytes, cnt=%d) in %g ms\n", path.c_str(), buf.size(), sfront.getCnt(), t);
+
+  return(true);
+}
+
+// 論理時刻cntのチェックポイントpathと一緒に残すファイルの名前の先頭
+string SlamCheckpoint::filePrefix(const string &path, int cnt) {
+  return(path + "." + to_string(cnt) + ".");
+}
+
+// bufをファイルpathに書く。途中で止まっても前のファイルが残るように、一時ファイルに書いてから置き換える
+bool SlamCheckpoint::writeFile(const string &path, const vector<char> &buf) {
+  string tmp = path + ".tmp";
+  FILE *fp = fopen(tmp.c_str(), "wb");
+  if (fp == nullptr) {
+    SLAM_LOGE("Error: cannot open %s\n", tmp.c_str());
+    return(false);
+  }
+  bool flag = (fwrite(buf.data(), 1, buf.size(), fp) == buf.size());
+  flag = (fclose(fp) == 0) && flag;
+  if (flag)
+    flag = (rename(tmp.c_str(), path.c_str()) == 0);
+  if (!flag) {
+    SLAM_LOGE("Error: cannot write checkpoint %s\n", path.c_str());
+    remove(tmp.c_str());
+  }
+
+  return(flag);
+}
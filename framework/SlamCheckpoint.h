@@ -0,0 +1,65 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file SlamCheckpoint.h
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#ifndef SLAM_CHECKPOINT_H_
+#define SLAM_CHECKPOINT_H_
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include "CheckpointIO.h"
+#include "SlamFrontEnd.h"
+
+// SLAMの状態（ポーズグラフ、点群地図、スキャンマッチングの状態、論理時刻）をファイルに保存し、読み戻す
+// 読み戻した後は、保存した次のスキャンから処理を続ければ、止めずに処理した場合と同じ結果になる
+// ファイルに退避した部分地図は読み戻さず、「ファイル名.論理時刻.番号」というハードリンクとして一緒に残す
+class SlamCheckpoint
+{
+private:
+  static const uint32_t MAGIC;              // ファイルの先頭に書く識別子
+  static const uint32_t VERSION;            // 形式の版。中身を変えたら上げる
+
+  CheckpointWriter writer;                  // 非同期保存で書き出す内容
+  std::thread worker;                       // 非同期保存の書き出しスレッド
+  std::atomic<bool> lastOk;                 // 直前の非同期保存が成功したか
+  std::vector<std::string> keptFiles;       // 書き終えたチェックポイントと一緒に残したファイル
+
+public:
+  SlamCheckpoint() : lastOk(true) {
+  }
+
+  ~SlamCheckpoint() {
+    wait();
+  }
+
+  bool getLastResult() const {
+    return(lastOk);
+  }
+
+//////////
+
+  bool save(SlamFrontEnd &sfront, const std::string &path);
+  bool saveAsync(SlamFrontEnd &sfront, const std::string &path);
+  void wait();
+  bool load(SlamFrontEnd &sfront, const std::string &path);
+
+private:
+  void snapshot(SlamFrontEnd &sfront, const std::string &path, CheckpointWriter &w);
+  bool commit(const std::string &path);
+  static bool writeFile(const std::string &path, const std::vector<char> &buf);
+  static std::string filePrefix(const std::string &path, int cnt);
+};
+
+#endif
@@ -13,6 +13,8 @@
  ****************************************************************************/
 
 #include "SlamFrontEnd.h"
+#include "SlamLog.h"
+#include "StageProfiler.h"
 
 using namespace std;
 
@@ -29,12 +31,39 @@ void SlamFrontEnd::init() {
 
 // 現在スキャンscanを処理する。
 void SlamFrontEnd::process(Scan2D &scan) {
+  StageTimer st(PS_PROCESS);                      // 処理時間の記録
+  chrono::steady_clock::time_point tstart = chrono::steady_clock::now();
+
   if (cnt == 0) 
     init();                                       // 開始時に初期化
 
   // スキャンマッチング
   smat->matchScan(scan);
 
+  degrade = smat->getDegradation();
+  if (!smat->isLocalizing())                      // 位置推定モードでは地図を作らない
+    updateMap(scan);
+
+  // 処理時間の上限がある場合は、行った縮退を記録して、次のスキャンの縮退段階を決める
+  if (smat->getTimeBudget() > 0) {
+    if (degrade & DEGRADE_ICP_ITER)
+      profCount(PC_DEGRADE_ICP_ITER);
+    if (degrade & DEGRADE_ICP_DEADLINE)
+      profCount(PC_DEGRADE_ICP_DEADLINE);
+    if (degrade & DEGRADE_RESAMPLE)
+      profCount(PC_DEGRADE_RESAMPLE);
+    if (degrade & DEGRADE_SKIP_GLOBALMAP)
+      profCount(PC_DEGRADE_SKIP_GLOBALMAP);
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - tstart).count();
+    SLAM_LOGD("degrade=%u, level=%d, elapsed=%g\n", degrade, smat->getDegradeLevel(), elapsed);
+    smat->updateDegradeLevel(elapsed);
+  }
+
+  ++cnt;
+}
+
+// スキャンマッチングの結果で、ポーズグラフと全体地図を更新し、ループ閉じ込みを行う
+void SlamFrontEnd::updateMap(Scan2D &scan) {
   Pose2D curPose = pcmap->getLastPose();          // これはスキャンマッチングで推定した現在のロボット位置
   
   // ポーズグラフにオドメトリアークを追加
@@ -47,27 +76,37 @@ void SlamFrontEnd::process(Scan2D &scan) {
   }
 
   if (cnt%keyframeSkip==0) {                             // キーフレームのときだけ行う
-    if (cnt == 0)
-      pcmap->setNthre(1);                                // cnt=0のときは地図が小さいのでサンプリング多くする
-    else
-      pcmap->setNthre(5);
-    pcmap->makeGlobalMap();                              // 点群地図の全体地図を生成
+    if (cnt > 0 && smat->getDegradeLevel() >= 3)         // 処理が間に合わないときは、次のキーフレームに回す
+      degrade |= DEGRADE_SKIP_GLOBALMAP;
+    else {
+      if (cnt == 0)
+        pcmap->setNthre(1);                              // cnt=0のときは地図が小さいのでサンプリング多くする
+      else
+        pcmap->setNthre(5);
+      StageTimer stg(PS_GLOBALMAP);
+      pcmap->makeGlobalMap();                            // 点群地図の全体地図を生成
+    }
   }
 
   // ループ閉じ込み
   if (cnt > keyframeSkip && cnt%keyframeSkip==0) {       // キーフレームのときだけ行う
-    bool flag = lpd->detectLoop(&scan, curPose, cnt);    // ループ検出を起動
+    bool flag;
+    {
+      StageTimer stl(PS_LOOP);
+      flag = lpd->detectLoop(&scan, curPose, cnt);       // ループ検出を起動
+    }
     if (flag) {
+      StageTimer stb(PS_BACKEND);
       sback.adjustPoses();                               // ループが見つかったらポーズ調整
       sback.remakeMaps();                                // 地図やポーズグラフの修正
+      profCount(PC_LOOP_CLOSURE);
     }
   }
 
-  printf("pcmap.size=%lu\n", pcmap->globalMap.size());   // 確認用
-
-  countLoopArcs();            // 確認用
+  SLAM_LOGD("pcmap.size=%lu\n", pcmap->globalMap.size());   // 確認用
 
-  ++cnt;
+  if (SLAM_LOG_ENABLED(SLAM_LOG_DEBUG))
+    countLoopArcs();          // 確認用。全アークをたどるので、ログを出すときだけにする
 }
 
 ////////////
@@ -83,7 +122,7 @@ bool SlamFrontEnd::makeOdometryArc(Pose2D &curPose, const Eigen::Matrix3d &fused
   Pose2D &lastPose = lastNode->pose;
   Pose2D relPose;
   Pose2D::calRelativePose(curPose, lastPose, relPose);   // 現在位置と直前位置の相対位置（移動量）の計算
-  printf("sfront: lastPose:  tx=%g, ty=%g, th=%g\n", lastPose.tx, lastPose.ty, lastPose.th);
+  SLAM_LOGD("sfront: lastPose:  tx=%g, ty=%g, th=%g\n", lastPose.tx, lastPose.ty, lastPose.th);
 
   Eigen::Matrix3d cov;
   CovarianceCalculator::rotateCovariance(lastPose, fusedCov, cov, true);     // 移動量の共分散に変換
@@ -106,5 +145,25 @@ void SlamFrontEnd::countLoopArcs() {
     if (src->nid != dst->nid-1)             // オドメトリアークは始点と終点が連番になっている
       ++an;                                 // オドメトリアークでなければループアーク
   }
-  printf("loopArcs.size=%d\n", an);         // 確認用
+  SLAM_LOGD("loopArcs.size=%d\n", an);      // 確認用
+}
+
+////////////
+
+// 論理時刻、スキャンマッチング、点群地図、ポーズグラフの状態をwに書く。SlamCheckpointから呼ぶ
+void SlamFrontEnd::writeState(CheckpointWriter &w) {
+  w.put(cnt);
+  smat->writeState(w);
+  pcmap->writeState(w);
+  pg->writeState(w);
+}
+
+// writeStateで書いた状態を読む。最初のスキャンで行う初期化はここで済ませる
+bool SlamFrontEnd::readState(CheckpointReader &r) {
+  init();
+  r.get(cnt);
+  if (!smat->readState(r) || !pcmap->readState(r) || !pg->readState(r))
+    return(false);
+
+  return(cnt > 0);
 }
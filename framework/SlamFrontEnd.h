@@ -22,6 +22,7 @@
 #include "PoseGraph.h"
 #include "LoopDetector.h"
 #include "SlamBackEnd.h"
+#include "CheckpointIO.h"
 
 ////////
 
@@ -31,6 +32,7 @@ class SlamFrontEnd
 private:
   int cnt;                               // 論理時刻
   int keyframeSkip;                      // キーフレーム間隔
+  unsigned int degrade;                  // 直近のスキャンで行った縮退（DegradeFlagの論理和）
 
   PointCloudMap *pcmap;                  // 点群地図
   PoseGraph *pg;                         // ポーズグラフ
@@ -39,7 +41,7 @@ private:
   SlamBackEnd sback;                     // SLAMバックエンド
 
 public:
-  SlamFrontEnd()  : cnt(0), keyframeSkip(10), smat(nullptr), lpd(nullptr) {
+  SlamFrontEnd()  : cnt(0), keyframeSkip(10), degrade(DEGRADE_NONE), smat(nullptr), lpd(nullptr) {
     pg = new PoseGraph();
     sback.setPoseGraph(pg);
   }
@@ -79,6 +81,20 @@ public:
     return(cnt);
   }
 
+  // 1スキャンの処理時間の上限[s]。超えそうなときは精度を落として間に合わせる。0なら上限なし
+  void setTimeBudget(double t) {
+    smat->setTimeBudget(t);
+  }
+
+  unsigned int getDegradation() {
+    return(degrade);
+  }
+
+  // 直近のスキャンマッチングによるロボット移動量の共分散。センサ融合をしない構成では使えない
+  const Eigen::Matrix3d &getCovariance() {
+    return(smat->getCovariance());
+  }
+
   void setDgCheck(bool p){
     smat->setDgCheck(p);
   }
@@ -89,7 +105,7 @@ public:
   }
 
   // デバッグ用
-  std::vector<PoseCov> &getPoseCovs() {
+  boost::circular_buffer<PoseCov> &getPoseCovs() {
     return(smat->getPoseCovs());
   }
 
@@ -97,9 +113,13 @@ public:
 
   void init();
   void process(Scan2D &scan);
+  void updateMap(Scan2D &scan);
   bool makeOdometryArc(Pose2D &curPose, const Eigen::Matrix3d &cov);
 
   void countLoopArcs();
+
+  void writeState(CheckpointWriter &w);
+  bool readState(CheckpointReader &r);
 };
 
 #endif
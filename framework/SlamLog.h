@@ -0,0 +1,61 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file SlamLog.h
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#ifndef SLAM_LOG_H_
+#define SLAM_LOG_H_
+
+#include <cstdio>
+#include <atomic>
+
+// ログレベル。数字が大きいほど詳しい
+#define SLAM_LOG_NONE  0           // 何も出さない
+#define SLAM_LOG_ERROR 1           // エラー
+#define SLAM_LOG_WARN  2           // 警告
+#define SLAM_LOG_INFO  3           // 開始・終了や集計結果など
+#define SLAM_LOG_DEBUG 4           // スキャンごとの確認用の表示
+
+// コンパイル時のログレベルの上限。これより詳しいログはコードから消えるので、引数の計算も書式化もしない。
+// 組込み向けなどでは、-DSLAM_LOG_MAX_LEVEL=3 のように指定する
+#ifndef SLAM_LOG_MAX_LEVEL
+#define SLAM_LOG_MAX_LEVEL SLAM_LOG_DEBUG
+#endif
+
+// 実行時のログレベル
+class SlamLog
+{
+private:
+  static std::atomic<int> level;   // これより詳しいログは出さない
+
+public:
+  static int getLevel() {
+    return(level.load(std::memory_order_relaxed));
+  }
+
+  static void setLevel(int l) {
+    level.store(l, std::memory_order_relaxed);
+  }
+};
+
+// レベルlのログを出すかどうか。確認用の表示のためだけの計算を省くのにも使う
+#define SLAM_LOG_ENABLED(l) ((l) <= SLAM_LOG_MAX_LEVEL && (l) <= SlamLog::getLevel())
+
+// printfと同じ書式でレベルlのログを出す。出さないときは引数も評価しない
+#define SLAM_LOG(l, ...) do { if (SLAM_LOG_ENABLED(l)) printf(__VA_ARGS__); } while (0)
+
+#define SLAM_LOGE(...) SLAM_LOG(SLAM_LOG_ERROR, __VA_ARGS__)
+#define SLAM_LOGW(...) SLAM_LOG(SLAM_LOG_WARN, __VA_ARGS__)
+#define SLAM_LOGI(...) SLAM_LOG(SLAM_LOG_INFO, __VA_ARGS__)
+#define SLAM_LOGD(...) SLAM_LOG(SLAM_LOG_DEBUG, __VA_ARGS__)
+
+#endif
@@ -0,0 +1,197 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file SlamStream.cpp
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#include "SlamStream.h"
+#include "SlamLog.h"
+
+using namespace std;
+
+//////////
+
+// srcの中身をdstに移す。点群はコピーしない
+void SlamStream::moveItem(StreamItem &dst, StreamItem &src) {
+  dst.scan.lps.swap(src.scan.lps);
+  dst.scan.phases.swap(src.scan.phases);
+  dst.scan.sid = src.scan.sid;
+  dst.scan.stamp = src.scan.stamp;
+  dst.scan.pose = src.scan.pose;
+  dst.stamp = src.stamp;
+  dst.tin = src.tin;
+}
+
+// 処理スレッドを起動する
+bool SlamStream::start() {
+  if (sfront == nullptr) {
+    SLAM_LOGE("Error: SlamStream has no SlamFrontEnd.\n");
+    return(false);
+  }
+
+  lock_guard<mutex> lock(mtx);
+  if (running)
+    return(true);
+  stopping = false;
+  running = true;
+  worker = thread(&SlamStream::run, this);
+
+  return(true);
+}
+
+// 処理スレッドを止める。drainがtrueならキューに残ったスキャンを処理してから止める
+void SlamStream::stop(bool drain) {
+  {
+    lock_guard<mutex> lock(mtx);
+    if (!running)
+      return;
+    if (!drain) {
+      dropped += queue.size();
+      queue.clear();
+    }
+    stopping = true;
+  }
+  cvar.notify_all();
+  worker.join();
+
+  lock_guard<mutex> lock(mtx);
+  running = false;
+}
+
+//////////
+
+// スキャンを投入する。待たずに戻る。stampはスキャンの取得時刻[s]で、オドメトリの共分散の計算にも使う
+// キューが満杯のときは方針に従ってスキャンを捨てて、falseを返す
+bool SlamStream::pushScan(const Scan2D &scan, double stamp) {
+  StreamItem item;
+  item.scan = scan;                         // コピーはロックの外で行う
+  item.scan.setStamp(stamp);
+  item.stamp = stamp;
+  item.tin = chrono::steady_clock::now();
+
+  bool flag = true;
+  {
+    lock_guard<mutex> lock(mtx);
+    item.scan.setSid(nextSid++);
+    if (queue.size() >= capacity) {
+      ++dropped;
+      flag = false;
+      if (policy == DROP_NEWEST)
+        return(flag);
+      queue.pop_front();
+    }
+    queue.emplace_back();
+    moveItem(queue.back(), item);
+  }
+  cvar.notify_all();
+
+  return(flag);
+}
+
+// スキャン点群lpsとそのときのオドメトリ値odomを投入する
+bool SlamStream::pushScan(const vector<LPoint2D> &lps, const Pose2D &odom, double stamp) {
+  Scan2D scan;
+  scan.setLps(lps);
+  Pose2D p = odom;
+  p.calRmat();
+  scan.setPose(p);
+  return(pushScan(scan, stamp));
+}
+
+// 結果を1個取り出す。なければ待たずにfalseを返す
+bool SlamStream::popResult(StreamResult &r) {
+  lock_guard<mutex> lock(mtx);
+  if (results.empty())
+    return(false);
+  r = results.front();
+  results.pop_front();
+  return(true);
+}
+
+// キューが空になり、処理中のスキャンもなくなるまで待つ
+void SlamStream::waitIdle() {
+  unique_lock<mutex> lock(mtx);
+  cvar.wait(lock, [this]{ return(!running || (queue.empty() && !busy)); });
+}
+
+size_t SlamStream::getDropped() {
+  lock_guard<mutex> lock(mtx);
+  return(dropped);
+}
+
+size_t SlamStream::getProcessed() {
+  lock_guard<mutex> lock(mtx);
+  return(processed);
+}
+
+StageHistogram SlamStream::getLatencyHistogram() {
+  lock_guard<mutex> lock(mtx);
+  return(latHist);
+}
+
+//////////
+
+// 処理スレッド。キューからスキャンを取り出してSLAMフロントエンドで処理する
+void SlamStream::run() {
+  StageProfiler::setCurrent(prof);          // 集計器はスレッドごとなので、このスレッドで設定する
+
+  while (true) {
+    StreamItem item;
+    {
+      unique_lock<mutex> lock(mtx);
+      cvar.wait(lock, [this]{ return(stopping || !queue.empty()); });
+      if (queue.empty())                    // stoppingで、キューも空
+        break;
+      moveItem(item, queue.front());
+      queue.pop_front();
+      busy = true;
+    }
+
+    vector<LPoint2D> &lps = item.scan.lps;
+    for (size_t i=0; i<lps.size(); i++)
+      lps[i].setSid(item.scan.sid);         // SensorDataReaderと同じく、点にもスキャン番号をつける
+
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    sfront->process(item.scan);
+    if (prof != nullptr)
+      prof->endScan();
+    chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+
+    StreamResult r;
+    r.sid = item.scan.sid;
+    r.stamp = item.stamp;
+    r.pose = sfront->getPointCloudMap()->getLastPose();
+    r.cov = sfront->getCovariance();
+    r.queueTime = chrono::duration<double>(t0 - item.tin).count();
+    r.procTime = chrono::duration<double>(t1 - t0).count();
+    r.latency = chrono::duration<double>(t1 - item.tin).count();
+    r.degrade = sfront->getDegradation();
+    SLAM_LOGD("SlamStream: sid=%d, latency=%g, queue=%g, proc=%g\n", r.sid, r.latency, r.queueTime, r.procTime);
+
+    if (callback)
+      callback(r);
+
+    {
+      lock_guard<mutex> lock(mtx);
+      if (resultCapacity > 0) {
+        if (results.size() >= resultCapacity)
+          results.pop_front();              // 取り出されない古い結果は捨てる
+        results.push_back(r);
+      }
+      latHist.add(r.latency);
+      ++processed;
+      busy = false;
+    }
+    cvar.notify_all();
+  }
+
+  StageProfiler::setCurrent(nullptr);
+}
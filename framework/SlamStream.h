@@ -0,0 +1,138 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file SlamStream.h
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#ifndef SLAM_STREAM_H_
+#define SLAM_STREAM_H_
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include "MyUtil.h"
+#include "Pose2D.h"
+#include "Scan2D.h"
+#include "SlamFrontEnd.h"
+#include "StageProfiler.h"
+
+// 処理が追いつかずキューが満杯のときに、どのスキャンを捨てるか
+enum StreamDropPolicy {
+  DROP_OLDEST=0,         // キューの一番古いスキャンを捨てて、新しいスキャンを入れる
+  DROP_NEWEST            // 新しいスキャンを入れずに捨てる
+};
+
+// 1スキャン分の処理結果
+struct StreamResult
+{
+  int sid;                         // スキャン番号（投入順の通し番号）
+  double stamp;                    // 投入時に与えた時刻（スキャンの取得時刻）[s]
+  Pose2D pose;                     // 推定したロボット位置
+  Eigen::Matrix3d cov;             // ロボット移動量の共分散（スキャンマッチングのもの）
+  double queueTime;                // キューで待った時間[s]
+  double procTime;                 // 処理時間[s]
+  double latency;                  // 投入から結果が出るまでの時間[s]
+  unsigned int degrade;            // 処理時間の上限を守るために行った縮退（DegradeFlagの論理和）
+};
+
+///////
+
+// スキャンを逐次投入してSLAMを実行する
+// pushScanはキューに入れるだけで待たない。処理は別スレッドで行い、結果はpopResultかコールバックで受け取る
+class SlamStream
+{
+private:
+  // キューに入れるスキャン
+  struct StreamItem
+  {
+    Scan2D scan;
+    double stamp;
+    std::chrono::steady_clock::time_point tin;     // 投入した時刻
+  };
+
+  SlamFrontEnd *sfront;                     // SLAMフロントエンド
+  size_t capacity;                          // キューの長さ
+  size_t resultCapacity;                    // 取り出されていない結果を残す数
+  StreamDropPolicy policy;                  // キューが満杯のときの方針
+  std::function<void(const StreamResult &)> callback;   // 結果ごとに呼ぶ。処理スレッドで呼ばれる
+  StageProfiler *prof;                      // 処理段階ごとの処理時間の記録先。nullptrなら記録しない
+
+  std::mutex mtx;                           // 以下を守る
+  std::condition_variable cvar;
+  std::deque<StreamItem> queue;             // 処理待ちのスキャン
+  std::deque<StreamResult> results;         // 取り出されていない結果
+  bool running;                             // 処理スレッドが動いているか
+  bool stopping;                            // 処理スレッドに終了を指示したか
+  bool busy;                                // 処理スレッドがスキャンを処理中か
+  int nextSid;                              // 次に投入するスキャンの番号
+  size_t dropped;                           // 捨てたスキャン数
+  size_t processed;                         // 処理したスキャン数
+  StageHistogram latHist;                   // 投入から結果までの時間の分布
+
+  std::thread worker;                       // 処理スレッド
+
+public:
+  SlamStream() : sfront(nullptr), capacity(4), resultCapacity(1000), policy(DROP_OLDEST), prof(nullptr),
+                 running(false), stopping(false), busy(false), nextSid(0), dropped(0), processed(0) {
+  }
+
+  ~SlamStream() {
+    stop(false);
+  }
+
+  // 設定はstartの前に行う
+  void setSlamFrontEnd(SlamFrontEnd *f) {
+    sfront = f;
+  }
+
+  void setCapacity(size_t n) {
+    capacity = (n > 0)? n : 1;
+  }
+
+  void setResultCapacity(size_t n) {
+    resultCapacity = n;
+  }
+
+  void setDropPolicy(StreamDropPolicy p) {
+    policy = p;
+  }
+
+  void setCallback(const std::function<void(const StreamResult &)> &f) {
+    callback = f;
+  }
+
+  void setProfiler(StageProfiler *p) {
+    prof = p;
+  }
+
+//////////
+
+  bool start();
+  void stop(bool drain=true);
+  bool pushScan(const Scan2D &scan, double stamp);
+  bool pushScan(const std::vector<LPoint2D> &lps, const Pose2D &odom, double stamp);
+  bool popResult(StreamResult &r);
+  void waitIdle();
+
+  size_t getDropped();
+  size_t getProcessed();
+  StageHistogram getLatencyHistogram();
+
+private:
+  static void moveItem(StreamItem &dst, StreamItem &src);
+  void run();
+};
+
+#endif
@@ -0,0 +1,164 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file StageProfiler.cpp
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#include <cstdio>
+#include <cmath>
+#include "StageProfiler.h"
+#include "SlamLog.h"
+
+using namespace std;
+
+SLAM_THREAD_LOCAL StageProfiler *StageProfiler::cur = nullptr;
+
+////////// 処理時間の分布 //////////
+
+// 処理時間t[s]を登録する
+void StageHistogram::add(double t) {
+  double us = t*1.0e6;
+  int b = 0;                                           // 1us未満はビン0
+  if (us >= 1) {
+    b = 1 + static_cast<int>(log2(us)*BIN_PER_OCTAVE);
+    if (b >= BIN_NUM)
+      b = BIN_NUM-1;
+  }
+  ++bins[b];
+  ++num;
+  sum += t;
+  if (t > vmax)
+    vmax = t;
+}
+
+// p分位点[s]。ビンの上端の値を返すので近似値
+double StageHistogram::quantile(double p) const {
+  if (num == 0)
+    return(0);
+
+  unsigned long long k = static_cast<unsigned long long>(ceil(p*num));   // k番目のサンプルを探す
+  if (k < 1)
+    k = 1;
+  unsigned long long acc = 0;
+  for (int b=0; b<BIN_NUM; b++) {
+    acc += bins[b];
+    if (acc >= k) {
+      double t = pow(2.0, static_cast<double>(b)/BIN_PER_OCTAVE)*1.0e-6;  // ビンbの上端
+      return((t < vmax)? t : vmax);
+    }
+  }
+  return(vmax);
+}
+
+////////// 集計器 //////////
+
+const char *StageProfiler::stageName(ProfStage s) {
+  static const char *names[PS_NUM] = {
+    "read", "deskew", "resample", "analyse", "associate", "optimize", "fuse", "growMap",
+    "localMap", "globalMap", "loopDetect", "backEnd", "process", "draw"
+  };
+  return(names[s]);
+}
+
+const char *StageProfiler::counterName(ProfCounter c) {
+  static const char *names[PC_NUM] = {
+    "icpIterations", "correspondences", "fuseReusedCorrespondences", "loopClosures",
+    "degradeIcpIteration", "degradeIcpDeadline", "degradeResample", "degradeSkipGlobalMap"
+  };
+  return(names[c]);
+}
+
+void StageProfiler::reset() {
+  for (int s=0; s<PS_NUM; s++) {
+    scanTime[s] = 0;
+    scanCalls[s] = 0;
+    calls[s] = 0;
+    hists[s] = StageHistogram();
+  }
+  for (int c=0; c<PC_NUM; c++)
+    counters[c] = 0;
+  scans = 0;
+}
+
+// 1スキャン分の処理の終わり。そのスキャンで動いた処理段階の時間を分布に入れる
+void StageProfiler::endScan() {
+  for (int s=0; s<PS_NUM; s++) {
+    if (scanCalls[s] == 0)
+      continue;
+    hists[s].add(scanTime[s]);
+    calls[s] += scanCalls[s];
+    scanTime[s] = 0;
+    scanCalls[s] = 0;
+  }
+  ++scans;
+}
+
+// 集計結果を表示する。時間はミリ秒
+void StageProfiler::printSummary() const {
+  SLAM_LOGI("---- StageProfiler: scans=%llu ----\n", scans);
+  SLAM_LOGI("%-12s %10s %8s %12s %10s %10s %10s\n", "stage", "calls", "scans", "total[ms]", "p50[ms]", "p99[ms]", "max[ms]");
+  for (int s=0; s<PS_NUM; s++) {
+    const StageHistogram &h = hists[s];
+    if (h.getNum() == 0)
+      continue;
+    SLAM_LOGI("%-12s %10llu %8llu %12.3f %10.4f %10.4f %10.4f\n", stageName(static_cast<ProfStage>(s)), calls[s], h.getNum(),
+           1000*h.getSum(), 1000*h.quantile(0.5), 1000*h.quantile(0.99), 1000*h.getMax());
+  }
+  for (int c=0; c<PC_NUM; c++)
+    SLAM_LOGI("%s=%llu\n", counterName(static_cast<ProfCounter>(c)), counters[c]);
+}
+
+// CSV形式でファイルpathに書き出す
+bool StageProfiler::writeCsv(const string &path) const {
+  FILE *fp = fopen(path.c_str(), "w");
+  if (fp == nullptr) {
+    SLAM_LOGE("Error: cannot open %s\n", path.c_str());
+    return(false);
+  }
+
+  fprintf(fp, "stage,calls,scans,total_ms,mean_ms,p50_ms,p99_ms,max_ms\n");
+  for (int s=0; s<PS_NUM; s++) {
+    const StageHistogram &h = hists[s];
+    double mean = (h.getNum() > 0)? h.getSum()/h.getNum() : 0;
+    fprintf(fp, "%s,%llu,%llu,%.6f,%.6f,%.6f,%.6f,%.6f\n", stageName(static_cast<ProfStage>(s)), calls[s], h.getNum(),
+            1000*h.getSum(), 1000*mean, 1000*h.quantile(0.5), 1000*h.quantile(0.99), 1000*h.getMax());
+  }
+  for (int c=0; c<PC_NUM; c++)
+    fprintf(fp, "%s,%llu,,,,,,\n", counterName(static_cast<ProfCounter>(c)), counters[c]);
+
+  fclose(fp);
+  return(true);
+}
+
+// JSON形式でファイルpathに書き出す
+bool StageProfiler::writeJson(const string &path) const {
+  FILE *fp = fopen(path.c_str(), "w");
+  if (fp == nullptr) {
+    SLAM_LOGE("Error: cannot open %s\n", path.c_str());
+    return(false);
+  }
+
+  fprintf(fp, "{\n  \"scans\": %llu,\n  \"stages\": {\n", scans);
+  for (int s=0; s<PS_NUM; s++) {
+    const StageHistogram &h = hists[s];
+    double mean = (h.getNum() > 0)? h.getSum()/h.getNum() : 0;
+    fprintf(fp, "    \"%s\": {\"calls\": %llu, \"scans\": %llu, \"total_ms\": %.6f, \"mean_ms\": %.6f, \"p50_ms\": %.6f, \"p99_ms\": %.6f, \"max_ms\": %.6f}%s\n",
+            stageName(static_cast<ProfStage>(s)), calls[s], h.getNum(), 1000*h.getSum(), 1000*mean,
+            1000*h.quantile(0.5), 1000*h.quantile(0.99), 1000*h.getMax(), (s < PS_NUM-1)? "," : "");
+  }
+  fprintf(fp, "  },\n  \"counters\": {\n");
+  for (int c=0; c<PC_NUM; c++)
+    fprintf(fp, "    \"%s\": %llu%s\n", counterName(static_cast<ProfCounter>(c)), counters[c], (c < PC_NUM-1)? "," : "");
+  fprintf(fp, "  }\n}\n");
+
+  fclose(fp);
+  return(true);
+}
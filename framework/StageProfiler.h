@@ -0,0 +1,190 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file StageProfiler.h
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#ifndef STAGE_PROFILER_H_
+#define STAGE_PROFILER_H_
+
+#include <vector>
+#include <string>
+#include <chrono>
+
+// Visual C++ 2013はthread_localがない
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define SLAM_THREAD_LOCAL __declspec(thread)
+#else
+#define SLAM_THREAD_LOCAL thread_local
+#endif
+
+// 処理時間を測る処理段階。入れ子になるものもある（例えば、ループ検出の中でもデータ対応づけをする）
+enum ProfStage {
+  PS_READ=0,             // スキャン読み込み
+  PS_DESKEW,             // スキャンの歪み補正
+  PS_RESAMPLE,           // スキャン点間隔均一化
+  PS_ANALYSE,            // 法線計算
+  PS_ASSOCIATE,          // データ対応づけ
+  PS_OPTIMIZE,           // ロボット位置の最適化
+  PS_FUSE,               // センサ融合
+  PS_GROWMAP,            // 地図への点群追加
+  PS_LOCALMAP,           // 局所地図の生成
+  PS_GLOBALMAP,          // 全体地図の生成
+  PS_LOOP,               // ループ検出
+  PS_BACKEND,            // ポーズ調整と地図の修正
+  PS_PROCESS,            // SLAMフロントエンドの1スキャン分の処理全体
+  PS_DRAW,               // 描画
+  PS_NUM
+};
+
+// 回数を数える項目
+enum ProfCounter {
+  PC_ICP_ITERATION=0,    // ICPの繰り返し回数
+  PC_CORRESPONDENCE,     // ICPで対応づけた点の数
+  PC_FUSE_REUSED,        // センサ融合でICPの最後の対応づけを使い回したスキャン数
+  PC_LOOP_CLOSURE,       // ループ閉じ込みの回数
+  PC_DEGRADE_ICP_ITER,   // ICPの繰り返し回数の上限を下げたスキャン数
+  PC_DEGRADE_ICP_DEADLINE,      // 時間切れでICPを打ち切ったスキャン数
+  PC_DEGRADE_RESAMPLE,   // スキャン点の間隔を粗くしたスキャン数
+  PC_DEGRADE_SKIP_GLOBALMAP,    // 全体地図の生成を省いたキーフレーム数
+  PC_NUM
+};
+
+///////
+
+// 1スキャンあたりの処理時間の分布。対数スケールのビンに数えるので、メモリは一定
+class StageHistogram
+{
+private:
+  static const int BIN_PER_OCTAVE = 4;      // 2倍ごとのビン数。分位点の誤差は2^(1/4)倍以内
+  static const int BIN_NUM = 1 + BIN_PER_OCTAVE*40;   // 1us〜2^40us
+  std::vector<unsigned long long> bins;
+  unsigned long long num;                   // サンプル数
+  double sum;                               // 合計[s]
+  double vmax;                              // 最大値[s]
+
+public:
+  StageHistogram() : bins(BIN_NUM, 0), num(0), sum(0), vmax(0) {
+  }
+
+  void add(double t);
+  double quantile(double p) const;
+
+  unsigned long long getNum() const {
+    return(num);
+  }
+
+  double getSum() const {
+    return(sum);
+  }
+
+  double getMax() const {
+    return(vmax);
+  }
+};
+
+///////
+
+// 処理段階ごとの処理時間と回数を集計する
+// スレッドごとに「現在の集計器」をもち、StageTimerはそこに記録する。集計器がなければ何もしない。
+class StageProfiler
+{
+private:
+  double scanTime[PS_NUM];                  // 現在スキャンでの処理段階ごとの処理時間[s]
+  unsigned long scanCalls[PS_NUM];          // 現在スキャンでの処理段階ごとの呼び出し回数
+  unsigned long long calls[PS_NUM];         // 処理段階ごとの呼び出し回数の合計
+  StageHistogram hists[PS_NUM];             // 処理段階ごとの1スキャンあたり処理時間の分布
+  unsigned long long counters[PC_NUM];      // 回数の合計
+  unsigned long long scans;                 // 処理したスキャン数
+
+  static SLAM_THREAD_LOCAL StageProfiler *cur;     // このスレッドの現在の集計器
+
+public:
+  StageProfiler() {
+    reset();
+  }
+
+  ~StageProfiler() {
+    if (cur == this)
+      cur = nullptr;
+  }
+
+  static StageProfiler *current() {
+    return(cur);
+  }
+
+  // このスレッドで記録する集計器をpにする。nullptrなら記録しない
+  static void setCurrent(StageProfiler *p) {
+    cur = p;
+  }
+
+  void addTime(ProfStage s, double t) {
+    scanTime[s] += t;
+    ++scanCalls[s];
+  }
+
+  void count(ProfCounter c, unsigned long long n=1) {
+    counters[c] += n;
+  }
+
+  unsigned long long getScans() const {
+    return(scans);
+  }
+
+  unsigned long long getCounter(ProfCounter c) const {
+    return(counters[c]);
+  }
+
+  const StageHistogram &getHistogram(ProfStage s) const {
+    return(hists[s]);
+  }
+
+//////////
+
+  static const char *stageName(ProfStage s);
+  static const char *counterName(ProfCounter c);
+  void reset();
+  void endScan();
+  void printSummary() const;
+  bool writeCsv(const std::string &path) const;
+  bool writeJson(const std::string &path) const;
+};
+
+///////
+
+// スコープを出るまでの時間を、現在の集計器の処理段階sに記録する
+class StageTimer
+{
+private:
+  StageProfiler *prof;
+  ProfStage stage;
+  std::chrono::steady_clock::time_point t0;
+
+public:
+  explicit StageTimer(ProfStage s) : prof(StageProfiler::current()), stage(s) {
+    if (prof != nullptr)
+      t0 = std::chrono::steady_clock::now();
+  }
+
+  ~StageTimer() {
+    if (prof != nullptr)
+      prof->addTime(stage, std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+  }
+};
+
+// 現在の集計器の項目cをn増やす
+inline void profCount(ProfCounter c, unsigned long long n=1) {
+  StageProfiler *prof = StageProfiler::current();
+  if (prof != nullptr)
+    prof->count(c, n);
+}
+
+#endif
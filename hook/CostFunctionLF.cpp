@@ -0,0 +1,129 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file CostFunctionLF.cpp
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#include "CostFunctionLF.h"
+#include "SlamLog.h"
+#include "StageProfiler.h"
+
+using namespace std;
+
+// 参照スキャンの距離場を用意する
+// pcmapがあれば、局所地図refLps（直前の確定部分地図の点の後に、現在の部分地図の代表点が続く）のうち、
+// 確定部分地図の分は作り置きの距離場を使い、現在の部分地図の代表点からだけ距離場を作る。なければrefLps全体から作る
+void CostFunctionLF::setRefBase(const LPointSpan &refLps) {
+  StageTimer st(PS_ASSOCIATE);                   // 距離場の作成はデータ対応づけの代わりなので、そこに数える
+  fieldNum = 0;
+  size_t n0 = 0;                                 // refLpsのうち、作り置きの距離場で置き換える点数
+  if (pcmap != nullptr) {
+    vector<Submap> &submaps = pcmap->getSubmaps();
+    if (submaps.size() >= 2) {
+      size_t i = submaps.size()-2;
+      n0 = submaps[i].mps.size();
+      if (n0 <= refLps.size())
+        refFields[fieldNum++] = pcmap->getSubmapField(i, csize, maxDist);
+      else
+        n0 = 0;
+    }
+  }
+  curField.build(LPointSpan(refLps.begin() + n0, refLps.size() - n0), csize, maxDist);
+  if (!curField.empty())
+    refFields[fieldNum++] = &curField;
+}
+
+// 距離場によるコスト関数。外れ値はevlimitで打ち切る
+double CostFunctionLF::calValue(double tx, double ty, double th) {
+  double a = DEG2RAD(th);
+  double cs = cos(a);
+  double sn = sin(a);
+  double lim2 = evlimit*evlimit;
+
+  double error=0;
+  int pn=0;
+  int nn=0;
+  const vector<LPoint2D> &lps = curScan->lps;
+  for (size_t i=0; i<lps.size() && fieldNum>0; i++) {
+    const LPoint2D &lp = lps[i];
+    if (lp.type == ISOLATE)                      // 孤立点は使わない
+      continue;
+
+    double x = cs*lp.x - sn*lp.y + tx;           // 現在スキャンの点を参照スキャンの座標系に変換
+    double y = sn*lp.x + cs*lp.y + ty;
+    double gx, gy;
+    double d = calDistance(x, y, gx, gy);
+
+    double er = d*d;
+    if (er <= lim2)
+      ++pn;                                      // 誤差が小さい点の数
+    else
+      er = lim2;                                 // 外れ値は一定値にする
+
+    error += er;
+    ++nn;
+  }
+
+  error = (nn>0)? error/nn : HUGE_VAL;           // 有効点数が0なら、値はHUGE_VAL
+  pnrate = (nn>0)? 1.0*pn/nn : 0;
+  usedNum = pn;
+
+  error *= 100;                                  // 他のコスト関数と桁を合わせるため100かける
+
+  return(error);
+}
+
+// calValueの勾配と近似ヘッセ行列。距離場の勾配から連鎖律で求める。thは度なので、回転成分は度あたりにする
+// 距離dの位置(tx,ty,th)での微分を J = (dx, dy, -dx*ry + dy*rx) とすると、勾配は 2*100/n*Σd*J、近似ヘッセ行列は 2*100/n*ΣJJ^T
+bool CostFunctionLF::calDerivatives(double tx, double ty, double th, Eigen::Vector3d &grad, Eigen::Matrix3d &hes) {
+  double a = DEG2RAD(th);
+  double cs = cos(a);
+  double sn = sin(a);
+  double lim2 = evlimit*evlimit;
+  double rd = M_PI/180;                          // 度あたりにする係数
+
+  double g0=0, g1=0, g2=0;
+  double h00=0, h01=0, h02=0, h11=0, h12=0, h22=0;
+  int nn=0;
+  const vector<LPoint2D> &lps = curScan->lps;
+  for (size_t i=0; i<lps.size() && fieldNum>0; i++) {
+    const LPoint2D &lp = lps[i];
+    if (lp.type == ISOLATE)
+      continue;
+    ++nn;
+
+    double rx = cs*lp.x - sn*lp.y;               // 回転だけした点
+    double ry = sn*lp.x + cs*lp.y;
+    double dx, dy;
+    double d = calDistance(rx + tx, ry + ty, dx, dy);
+    if (d*d > lim2)                              // 打ち切った点は勾配0
+      continue;
+
+    double Jt = rd*(-dx*ry + dy*rx);
+    g0 += d*dx;
+    g1 += d*dy;
+    g2 += d*Jt;
+    h00 += dx*dx;
+    h01 += dx*dy;
+    h02 += dx*Jt;
+    h11 += dy*dy;
+    h12 += dy*Jt;
+    h22 += Jt*Jt;
+  }
+
+  double k = (nn>0)? 200.0/nn : 0;               // 2*100/nn
+  grad << k*g0, k*g1, k*g2;
+  hes << k*h00, k*h01, k*h02,
+         k*h01, k*h11, k*h12,
+         k*h02, k*h12, k*h22;
+
+  return(true);
+}
@@ -0,0 +1,88 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file CostFunctionLF.h
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#ifndef _COST_FUNCTION_LF_H_
+#define _COST_FUNCTION_LF_H_
+
+#include "CostFunction.h"
+#include "LikelihoodField.h"
+#include "PointCloudMapLP.h"
+
+// 参照スキャンの距離場によるコスト関数。現在スキャンの各点の、参照スキャン点までの距離の2乗平均
+// 距離は距離場の双線形補間で求め、勾配も解析的に求めるので、データ対応づけはいらない
+// 点群地図pcmapを設定すると、確定した部分地図の距離場は部分地図ごとに作り置きを使い、現在の部分地図の分だけ毎回作る
+class CostFunctionLF : public CostFunction
+{
+private:
+  static const int FIELD_MAX = 2;
+
+  double csize;                                // 距離場のセルサイズ[m]
+  double maxDist;                              // 距離場の距離の上限[m]
+  const Scan2D *curScan;                       // 現在スキャン
+  PointCloudMapLP *pcmap;                      // 点群地図。nullptrなら参照スキャンから距離場を作る
+  LikelihoodField curField;                    // 毎回作る距離場（現在の部分地図、または参照スキャン全体）
+  const LikelihoodField *refFields[FIELD_MAX]; // 使う距離場。点までの距離はこれらの最小値
+  int fieldNum;
+  size_t usedNum;                              // 外れ値でない点数
+
+public:
+  CostFunctionLF() : csize(0.05), maxDist(0.3), curScan(nullptr), pcmap(nullptr), fieldNum(0), usedNum(0) {
+  }
+
+  ~CostFunctionLF() {
+  }
+
+  void setPointCloudMap(PointCloudMapLP *p) {
+    pcmap = p;
+  }
+
+  void setFieldParams(double cs, double md) {
+    csize = cs;
+    maxDist = md;
+  }
+
+  virtual bool usesCorrespondence() {
+    return(false);
+  }
+
+  virtual size_t getUsedNum() {
+    return(usedNum);
+  }
+
+  virtual void setScan(const Scan2D *scan) {
+    curScan = scan;
+  }
+
+  virtual void setRefBase(const LPointSpan &refLps);
+  virtual double calValue(double tx, double ty, double th);
+  virtual bool calDerivatives(double tx, double ty, double th, Eigen::Vector3d &grad, Eigen::Matrix3d &hes);
+
+private:
+  // 位置(x,y)の参照スキャン点までの距離と、その勾配(gx,gy)
+  double calDistance(double x, double y, double &gx, double &gy) const {
+    double d = refFields[0]->calDistance(x, y, gx, gy);
+    for (int k=1; k<fieldNum; k++) {
+      double gx2, gy2;
+      double d2 = refFields[k]->calDistance(x, y, gx2, gy2);
+      if (d2 < d) {
+        d = d2;
+        gx = gx2;
+        gy = gy2;
+      }
+    }
+    return(d);
+  }
+};
+
+#endif
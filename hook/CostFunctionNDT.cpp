@@ -0,0 +1,225 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file CostFunctionNDT.cpp
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#include "CostFunctionNDT.h"
+#include "SlamLog.h"
+#include "StageProfiler.h"
+
+using namespace std;
+
+const double CostFunctionNDT::SCALE = 1.5;
+
+// 参照スキャン点を格子に分けて、セルごとに正規分布を当てはめる
+// 共分散は、点が直線状に並ぶと特異になるので、小さい方の固有値を大きい方の1/100以上、かつ(1cm)^2以上にする
+void CostFunctionNDT::setRefBase(const LPointSpan &refLps) {
+  StageTimer st(PS_ASSOCIATE);                   // 正規分布の作成はデータ対応づけの代わりなので、そこに数える
+  if (refLps.empty()) {
+    width = height = 0;
+    return;
+  }
+
+  double xmax=-HUGE_VAL, ymax=-HUGE_VAL;
+  xmin = ymin = HUGE_VAL;
+  for (size_t i=0; i<refLps.size(); i++) {
+    xmin = min(xmin, refLps[i].x);
+    ymin = min(ymin, refLps[i].y);
+    xmax = max(xmax, refLps[i].x);
+    ymax = max(ymax, refLps[i].y);
+  }
+  xmin -= csize;                                 // 周りに1セル分の余白をつける
+  ymin -= csize;
+  width = static_cast<int>((xmax - xmin)/csize) + 2;
+  height = static_cast<int>((ymax - ymin)/csize) + 2;
+
+  NdtCell zero = {0, 0, 0, 0, 0, 0};
+  cells.assign(static_cast<size_t>(width)*height, zero);     // 前の領域を使い回す
+  for (size_t i=0; i<refLps.size(); i++) {       // セルの角からの位置で和をとる
+    const LPoint2D &lp = refLps[i];
+    int xi = static_cast<int>((lp.x - xmin)/csize);
+    int yi = static_cast<int>((lp.y - ymin)/csize);
+    NdtCell &c = cells[static_cast<size_t>(yi)*width + xi];
+    double x = lp.x - (xmin + xi*csize);
+    double y = lp.y - (ymin + yi*csize);
+    c.mx += x;
+    c.my += y;
+    c.ixx += x*x;
+    c.ixy += x*y;
+    c.iyy += y*y;
+    ++c.num;
+  }
+
+  int cellNum = 0;
+  for (int yi=0; yi<height; yi++) {
+    for (int xi=0; xi<width; xi++) {
+      NdtCell &c = cells[static_cast<size_t>(yi)*width + xi];
+      if (c.num < minNum) {
+        c.num = 0;
+        continue;
+      }
+      double mx = c.mx/c.num;
+      double my = c.my/c.num;
+      double sxx = c.ixx/c.num - mx*mx;          // 共分散
+      double sxy = c.ixy/c.num - mx*my;
+      double syy = c.iyy/c.num - my*my;
+
+      double tr = sxx + syy;                     // 固有値l1>=l2と、l1の固有ベクトル(vx,vy)
+      double det = sxx*syy - sxy*sxy;
+      double dd = sqrt(max(tr*tr/4 - det, 0.0));
+      double l1 = tr/2 + dd;
+      double l2 = tr/2 - dd;
+      double vx, vy;
+      if (fabs(sxy) > 1.0E-12) {
+        vx = l1 - syy;
+        vy = sxy;
+        double len = sqrt(vx*vx + vy*vy);
+        vx /= len;
+        vy /= len;
+      }
+      else if (sxx >= syy) {
+        vx = 1;  vy = 0;
+      }
+      else {
+        vx = 0;  vy = 1;
+      }
+      l1 = max(l1, 1.0E-4);
+      l2 = max(l2, max(0.01*l1, 1.0E-4));
+
+      c.mx = xmin + xi*csize + mx;               // 地図座標系に戻す
+      c.my = ymin + yi*csize + my;
+      c.ixx = vx*vx/l1 + vy*vy/l2;               // 逆行列。l2の固有ベクトルは(-vy,vx)
+      c.ixy = vx*vy/l1 - vx*vy/l2;
+      c.iyy = vy*vy/l1 + vx*vx/l2;
+      ++cellNum;
+    }
+  }
+
+  SLAM_LOGD("CostFunctionNDT: %d x %d cells, %d used, points=%lu\n", width, height, cellNum, refLps.size());
+}
+
+// 位置(x,y)を囲む2x2セルのうち、マハラノビス距離の2乗mが最も小さいセルを返す。なければnullptr
+const NdtCell *CostFunctionNDT::findCell(double x, double y, double &m) const {
+  double u = (x - xmin)/csize - 0.5;             // セル中心を格子点とした座標
+  double v = (y - ymin)/csize - 0.5;
+  int i0 = static_cast<int>(floor(u));
+  int j0 = static_cast<int>(floor(v));
+
+  const NdtCell *cmin = nullptr;
+  m = HUGE_VAL;
+  for (int j=max(j0, 0); j<=j0+1 && j<height; j++) {
+    for (int i=max(i0, 0); i<=i0+1 && i<width; i++) {
+      const NdtCell &c = cells[static_cast<size_t>(j)*width + i];
+      if (c.num == 0)
+        continue;
+      double qx = x - c.mx;
+      double qy = y - c.my;
+      double mm = c.ixx*qx*qx + 2*c.ixy*qx*qy + c.iyy*qy*qy;
+      if (mm < m) {
+        m = mm;
+        cmin = &c;
+      }
+    }
+  }
+
+  return(cmin);
+}
+
+// NDTによるコスト関数。各点のコストは1-exp(-m/2)の平均。近くに正規分布のない点は、対応がないものとして数えない
+// セルの正規分布は壁に沿って広がっているので、地図に合った点でもコストの平均は0.4〜0.5くらいになる
+// スコア閾値（1.0）で、外れ値がおよそ4割を超えたときに失敗とみなされるよう、SCALE倍する
+double CostFunctionNDT::calValue(double tx, double ty, double th) {
+  double a = DEG2RAD(th);
+  double cs = cos(a);
+  double sn = sin(a);
+
+  double error=0;
+  int pn=0;
+  int nn=0;
+  const vector<LPoint2D> &lps = curScan->lps;
+  for (size_t i=0; i<lps.size(); i++) {
+    const LPoint2D &lp = lps[i];
+    if (lp.type == ISOLATE)                      // 孤立点は使わない
+      continue;
+
+    double x = cs*lp.x - sn*lp.y + tx;           // 現在スキャンの点を参照スキャンの座標系に変換
+    double y = sn*lp.x + cs*lp.y + ty;
+    double m;
+    if (findCell(x, y, m) == nullptr)
+      continue;
+    ++nn;
+    error += 1 - exp(-m/2);
+    if (m <= 9)                                  // 3σ以内の点の数
+      ++pn;
+  }
+
+  error = (nn>0)? SCALE*error/nn : HUGE_VAL;     // 有効点数が0なら、値はHUGE_VAL
+  pnrate = (nn>0)? 1.0*pn/nn : 0;
+  usedNum = pn;
+
+  return(error);
+}
+
+// calValueの勾配とヘッセ行列。点の位置の微分をJ、セルの共分散の逆行列をSとすると、
+// 勾配は SCALE/n*Σe*J^T*S*q、ヘッセ行列は半正定値の部分 SCALE/n*Σe*J^T*S*J を使う（e=exp(-m/2)、qは平均からの差）
+bool CostFunctionNDT::calDerivatives(double tx, double ty, double th, Eigen::Vector3d &grad, Eigen::Matrix3d &hes) {
+  double a = DEG2RAD(th);
+  double cs = cos(a);
+  double sn = sin(a);
+  double rd = M_PI/180;                          // 度あたりにする係数
+
+  double g0=0, g1=0, g2=0;
+  double h00=0, h01=0, h02=0, h11=0, h12=0, h22=0;
+  int nn=0;
+  const vector<LPoint2D> &lps = curScan->lps;
+  for (size_t i=0; i<lps.size(); i++) {
+    const LPoint2D &lp = lps[i];
+    if (lp.type == ISOLATE)
+      continue;
+
+    double rx = cs*lp.x - sn*lp.y;               // 回転だけした点
+    double ry = sn*lp.x + cs*lp.y;
+    double m;
+    const NdtCell *c = findCell(rx + tx, ry + ty, m);
+    if (c == nullptr)
+      continue;
+    ++nn;
+
+    double e = exp(-m/2);
+    double qx = rx + tx - c->mx;
+    double qy = ry + ty - c->my;
+    double ax = c->ixx*qx + c->ixy*qy;           // S*q
+    double ay = c->ixy*qx + c->iyy*qy;
+    double jx = -rd*ry;                          // 角度の微分
+    double jy = rd*rx;
+    double bx = c->ixx*jx + c->ixy*jy;           // S*(jx,jy)
+    double by = c->ixy*jx + c->iyy*jy;
+
+    g0 += e*ax;
+    g1 += e*ay;
+    g2 += e*(jx*ax + jy*ay);
+    h00 += e*c->ixx;
+    h01 += e*c->ixy;
+    h02 += e*bx;
+    h11 += e*c->iyy;
+    h12 += e*by;
+    h22 += e*(jx*bx + jy*by);
+  }
+
+  double k = (nn>0)? SCALE/nn : 0;
+  grad << k*g0, k*g1, k*g2;
+  hes << k*h00, k*h01, k*h02,
+         k*h01, k*h11, k*h12,
+         k*h02, k*h12, k*h22;
+
+  return(true);
+}
@@ -0,0 +1,79 @@
+﻿/****************************************************************************
+ * LittleSLAM: 2D-Laser SLAM for educational use
+ * Copyright (C) 2017-2018 Masahiro Tomono
+ * Copyright (C) 2018 Future Robotics Technology Center (fuRo),
+ *                    Chiba Institute of Technology.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * @file CostFunctionNDT.h
+ * @author Masahiro Tomono
+ ****************************************************************************/
+
+#ifndef _COST_FUNCTION_NDT_H_
+#define _COST_FUNCTION_NDT_H_
+
+#include <vector>
+#include "CostFunction.h"
+
+// NDTの格子セル。参照スキャン点の平均と共分散の逆行列をもつ
+struct NdtCell
+{
+  double mx, my;                    // 点の平均
+  double ixx, ixy, iyy;             // 共分散の逆行列。作成中は2次モーメントの和を入れておく
+  int num;                          // 点数。0ならこのセルは使わない
+};
+
+///////
+
+// NDT（正規分布変換）によるコスト関数
+// setRefBaseで参照スキャンを格子に分けてセルごとに正規分布を当てはめ、現在スキャンの各点を近くのセルの正規分布で評価する
+// 1点あたりの計算量は参照スキャンの点数によらないので、参照スキャンが密な環境で速い
+class CostFunctionNDT : public CostFunction
+{
+private:
+  static const double SCALE;        // コストの倍率
+
+  double csize;                     // セルサイズ[m]
+  int minNum;                       // 正規分布を当てはめる最小点数
+  const Scan2D *curScan;            // 現在スキャン
+  std::vector<NdtCell> cells;       // セルの配列。行（y）順に並べる
+  int width, height;                // セル数
+  double xmin, ymin;                // 左下のセルの角の位置[m]
+  size_t usedNum;                   // 正規分布の中にある点数
+
+public:
+  CostFunctionNDT() : csize(0.5), minNum(5), curScan(nullptr), width(0), height(0), xmin(0), ymin(0), usedNum(0) {
+  }
+
+  ~CostFunctionNDT() {
+  }
+
+  void setCellParams(double cs, int n) {
+    csize = cs;
+    minNum = n;
+  }
+
+  virtual bool usesCorrespondence() {
+    return(false);
+  }
+
+  virtual size_t getUsedNum() {
+    return(usedNum);
+  }
+
+  virtual void setScan(const Scan2D *scan) {
+    curScan = scan;
+  }
+
+  virtual void setRefBase(const LPointSpan &refLps);
+  virtual double calValue(double tx, double ty, double th);
+  virtual bool calDerivatives(double tx, double ty, double th, Eigen::Vector3d &grad, Eigen::Matrix3d &hes);
+
+private:
+  const NdtCell *findCell(double x, double y, double &m) const;
+};
+
+#endif
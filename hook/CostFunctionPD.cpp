@@ -13,29 +13,31 @@
  ****************************************************************************/
 
 #include "CostFunctionPD.h"
+#include "SlamLog.h"
 
 using namespace std;
 
 // 垂直距離によるコスト関数
 double CostFunctionPD::calValue(double tx, double ty, double th) {
   double a = DEG2RAD(th);
+  double cs = cos(a);
+  double sn = sin(a);
 
   double error=0;
   int pn=0;
   int nn=0;
-  for (size_t i=0; i<curLps.size(); i++) {
-    const LPoint2D *clp = curLps[i];             // 現在スキャンの点
-    const LPoint2D *rlp = refLps[i];             // clpに対応する参照スキャンの点
+  const CorrPair *cps = corrs->data();           // 対応づけた点の組
+  size_t num = corrs->size();
+  for (size_t i=0; i<num; i++) {
+    const CorrPair &cp = cps[i];                 // 現在スキャンの点と、それに対応する参照スキャンの点
 
-    if (rlp->type != LINE)                       // 直線上の点でなければ使わない
+    if (cp.rtype != LINE)                        // 直線上の点でなければ使わない
       continue;
  
-    double cx = clp->x;
-    double cy = clp->y;
-    double x = cos(a)*cx - sin(a)*cy + tx;       // clpを参照スキャンの座標系に変換
-    double y = sin(a)*cx + cos(a)*cy + ty;
+    double x = cs*cp.cx - sn*cp.cy + tx;         // 現在スキャンの点を参照スキャンの座標系に変換
+    double y = sn*cp.cx + cs*cp.cy + ty;
 
-    double pdis = (x - rlp->x)*rlp->nx + (y - rlp->y)*rlp->ny;         // 垂直距離
+    double pdis = (x - cp.rx)*cp.nx + (y - cp.ry)*cp.ny;               // 垂直距離
 
     double er = pdis*pdis;
     if (er <= evlimit*evlimit)
@@ -48,7 +50,7 @@ double CostFunctionPD::calValue(double tx, double ty, double th) {
   error = (nn>0)? error/nn : HUGE_VAL;           // 有効点数が0なら、値はHUGE_VAL
   pnrate = 1.0*pn/nn;                            // 誤差が小さい点の比率
 
-//  printf("CostFunctionPD: error=%g, pnrate=%g, evlimit=%g\n", error, pnrate, evlimit);     // 確認用
+//  SLAM_LOGD("CostFunctionPD: error=%g, pnrate=%g, evlimit=%g\n", error, pnrate, evlimit);  // 確認用
 
   error *= 100;                                  // 評価値が小さくなりすぎないよう100かける。
 
@@ -23,21 +23,28 @@ class DataAssociatorGT : public DataAssociator
 {
 private:
   NNGridTable nntab;                        // 格子テーブル
+  const NNGridIndex *refIndex;              // 作成済みの格子テーブル。あればnntabの代わりに使う
   
 public:
-  DataAssociatorGT() {
+  DataAssociatorGT() : refIndex(nullptr) {
   }
 
   ~DataAssociatorGT() {
   }
   
   // 参照スキャンの点rlpsをポインタにしてnntabに入れる
-  virtual void setRefBase(const std::vector<LPoint2D> &rlps) {
+  virtual void setRefBase(const LPointSpan &rlps) {
+    refIndex = nullptr;
     nntab.clear();
     for (size_t i=0; i<rlps.size(); i++) 
       nntab.addPoint(&rlps[i]);              // ポインタにして格納
   }
 
+  // 作成済みの格子テーブルindexを使う。nntabを作り直さなくてよい
+  virtual void setRefIndex(const NNGridIndex *index) {
+    refIndex = index;
+  }
+
 /////////
 
   virtual double findCorrespondence(const Scan2D *curScan, const Pose2D &predPose);
@@ -12,18 +12,15 @@
  * @author Masahiro Tomono
  ****************************************************************************/
 
-#include <boost/timer.hpp>
 #include "DataAssociatorLS.h"
+#include "SlamLog.h"
 
 using namespace std;
 
 // 現在スキャンcurScanの各スキャン点に対応する点をbaseLpsから見つける
 double DataAssociatorLS::findCorrespondence(const Scan2D *curScan, const Pose2D &predPose) {
-  boost::timer tim;                                 // 処理時間測定用
-
   double dthre = 0.2;                               // これより遠い点は除外する[m]
-  curLps.clear();                                   // 対応づけ現在スキャン点群を空にする
-  refLps.clear();                                   // 対応づけ参照スキャン点群を空にする
+  corrs.clear();                                    // 対応づけた点の組を空にする
   for (size_t i=0; i<curScan->lps.size(); i++) {
     const LPoint2D *clp = &(curScan->lps[i]);       // 現在スキャンの点。ポインタで。
 
@@ -42,16 +39,12 @@ double DataAssociatorLS::findCorrespondence(const Scan2D *curScan, const Pose2D
       }
     }
     if (rlpmin != nullptr) {                        // 最近傍点があれば登録
-      curLps.push_back(clp);
-      refLps.push_back(rlpmin);
+      corrs.add(clp, rlpmin);
     }
   }
   
-  double ratio = (1.0*curLps.size())/curScan->lps.size();         // 対応がとれた点の比率
-//  printf("ratio=%g, clps.size=%lu\n", ratio, curScan->lps.size());
-
-//  double t1 = 1000*tim.elapsed();                               // 処理時間
-//  printf("Elapsed time: dassLS=%g\n", t1);
+  double ratio = (1.0*corrs.size())/curScan->lps.size();          // 対応がとれた点の比率
+//  SLAM_LOGD("ratio=%g, clps.size=%lu\n", ratio, curScan->lps.size());
 
   return(ratio);
 }
@@ -12,7 +12,9 @@
  * @author Masahiro Tomono
  ****************************************************************************/
 
+#include <algorithm>
 #include "LoopDetectorSS.h"
+#include "SlamLog.h"
 
 using namespace std;
 
@@ -21,51 +23,46 @@ using namespace std;
 // ループ検出
 // 現在位置curPoseに近く、現在スキャンcurScanに形が一致する場所をロボット軌跡から見つけてポーズアークを張る。
 bool LoopDetectorSS::detectLoop(Scan2D *curScan, Pose2D &curPose, int cnt) {
-  printf("-- detectLoop -- \n");
+  SLAM_LOGD("-- detectLoop -- \n");
 
-  // 最も近い部分地図を探す
-  double atd = pcmap->atd;                             // 現在の実際の累積走行距離
-  double atdR = 0;                                     // 下記の処理で軌跡をなぞる時の累積走行距離
-  const vector<Submap> &submaps = pcmap->submaps;      // 部分地図
-  const vector<Pose2D> &poses = pcmap->poses;          // ロボット軌跡
-  double dmin=HUGE_VAL;                                // 前回訪問点までの距離の最小値
-  size_t imin=0, jmin=0;                               // 距離最小の前回訪問点のインデックス
-  Pose2D prevP;                                        // 直前のロボット位置
-  for (size_t i=0; i<submaps.size()-1; i++) {          // 現在の部分地図以外を探す
-    const Submap &submap = submaps[i];                 // i番目の部分地図
-    for (size_t j=submap.cntS; j<=submap.cntE; j++) {  // 部分地図の各ロボット位置について
-      Pose2D p = poses[j];                             // ロボット位置
-      atdR += sqrt((p.tx - prevP.tx)*(p.tx - prevP.tx) + (p.ty - prevP.ty)*(p.ty - prevP.ty));
-      if (atd-atdR < atdthre) {                        // 現在位置までの走行距離が短いとループとみなさず、もうやめる
-        i = submaps.size();                            // これで外側のループからも抜ける
-        break;
-      }
-      prevP = p;
+  // 現在位置から探索半径内にある前回訪問点を、格子テーブルで近い順に探す
+  pcmap->findRevisitCandidates(curPose, radius, atdthre, cands);     // candsは(距離の2乗, 前回訪問点のインデックス)
 
-      double d = (curPose.tx - p.tx)*(curPose.tx - p.tx) + (curPose.ty - p.ty)*(curPose.ty - p.ty);
-      if (d < dmin) {                                  // 現在位置とpとの距離がこれまでの最小か
-        dmin = d;
-        imin = i;                                      // 候補となる部分地図のインデックス
-        jmin = j;                                      // 前回訪問点のインデックス
-      }
-//      printf("i=%lu, j=%lu: atd=%g, atdR=%g, atdthre=%g\n", i, j, atd, atdR, atdthre);             // 確認用
-    }
+  // 近い順に、部分地図ごとに1つずつ候補を試す
+  tried.clear();                                       // 試した部分地図のインデックス
+  for (size_t k=0; k<cands.size() && tried.size()<candNum; k++) {
+    size_t imin = pcmap->findSubmap(cands[k].second);  // 候補となる部分地図のインデックス
+    if (find(tried.begin(), tried.end(), imin) != tried.end())    // この部分地図はより近い候補で試した
+      continue;
+    tried.push_back(imin);
+
+    size_t jmin = cands[k].second;                     // 前回訪問点のインデックス
+    SLAM_LOGD("dmin=%g, radius=%g, imin=%lu, jmin=%lu\n", sqrt(cands[k].first), radius, imin, jmin);  // 確認用
+
+    if (detectLoopAt(curScan, curPose, cnt, imin, jmin))
+      return(true);
   }
 
-  printf("dmin=%g, radius=%g, imin=%lu, jmin=%lu\n", sqrt(dmin), radius, imin, jmin);  // 確認用
+  if (cands.empty())                                   // 前回訪問点が遠いとループ検出しない
+    SLAM_LOGD("no candidate, radius=%g\n", radius);    // 確認用
 
-  if (dmin > radius*radius)                            // 前回訪問点までの距離が遠いとループ検出しない
-    return(false);
+  return(false);
+}
 
+// imin番目の部分地図のjmin番目のロボット位置を前回訪問点として、ループを検出する
+bool LoopDetectorSS::detectLoopAt(Scan2D *curScan, Pose2D &curPose, int cnt, size_t imin, size_t jmin) {
+  const vector<Pose2D> &poses = pcmap->poses;          // ロボット軌跡
   Submap &refSubmap = pcmap->submaps[imin];            // 最も近い部分地図を参照スキャンにする
+  const NNGridIndex *refIndex = pcmap->getSubmapIndex(imin);       // その格子テーブル。確定時に作ったものを使い回す
+  const vector<LPoint2D> &refLps = refIndex->getPoints();          // その点群
   const Pose2D &initPose = poses[jmin];
-  printf("curPose:  tx=%g, ty=%g, th=%g\n", curPose.tx, curPose.ty, curPose.th);
-  printf("initPose: tx=%g, ty=%g, th=%g\n", initPose.tx, initPose.ty, initPose.th);
+  SLAM_LOGD("curPose:  tx=%g, ty=%g, th=%g\n", curPose.tx, curPose.ty, curPose.th);
+  SLAM_LOGD("initPose: tx=%g, ty=%g, th=%g\n", initPose.tx, initPose.ty, initPose.th);
 
   // 再訪点の位置を求める
   Pose2D revisitPose;
-  bool flag = estimateRevisitPose(curScan, refSubmap.mps, curPose, revisitPose);
-//  bool flag = estimateRelativePose(curScan, refSubmap.mps, initPose, revisitPose);
+  bool flag = estimateRevisitPose(curScan, refIndex, curPose, revisitPose);
+//  bool flag = estimateRelativePose(curScan, refLps, initPose, revisitPose);
 
   if (flag) {                                          // ループを検出した
     Eigen::Matrix3d icpCov;                                                  // ICPの共分散
@@ -82,11 +79,11 @@ bool LoopDetectorSS::detectLoop(Scan2D *curScan, Pose2D &curPose, int cnt) {
     Scan2D refScan;
     Pose2D spose = poses[refSubmap.cntS];
     refScan.setSid(info.refId);
-    refScan.setLps(refSubmap.mps);
+    refScan.setLps(refLps);
     refScan.setPose(spose);
     LoopMatch lm(*curScan, refScan, info);
     loopMatches.emplace_back(lm);
-    printf("curId=%d, refId=%d\n", info.curId, info.refId);
+    SLAM_LOGD("curId=%d, refId=%d\n", info.curId, info.refId);
   }
 
   return(flag);
@@ -113,25 +110,27 @@ void LoopDetectorSS::makeLoopArc(LoopInfo &info) {
   pg->addArc(arc);                                                         // ループアーク登録
 
   // 確認用
-  printf("makeLoopArc: pose arc added\n");
-  printf("srcPose: tx=%g, ty=%g, th=%g\n", srcPose.tx, srcPose.ty, srcPose.th);
-  printf("dstPose: tx=%g, ty=%g, th=%g\n", dstPose.tx, dstPose.ty, dstPose.th);
-  printf("relPose: tx=%g, ty=%g, th=%g\n", relPose.tx, relPose.ty, relPose.th);
-  PoseNode *src = pg->findNode(info.refId);
-  PoseNode *dst = pg->findNode(info.curId);
-  Pose2D relPose2;
-  Pose2D::calRelativePose(dst->pose, src->pose, relPose2);
-  printf("relPose2: tx=%g, ty=%g, th=%g\n", relPose2.tx, relPose2.ty, relPose2.th);
+  SLAM_LOGD("makeLoopArc: pose arc added\n");
+  SLAM_LOGD("srcPose: tx=%g, ty=%g, th=%g\n", srcPose.tx, srcPose.ty, srcPose.th);
+  SLAM_LOGD("dstPose: tx=%g, ty=%g, th=%g\n", dstPose.tx, dstPose.ty, dstPose.th);
+  SLAM_LOGD("relPose: tx=%g, ty=%g, th=%g\n", relPose.tx, relPose.ty, relPose.th);
+  if (SLAM_LOG_ENABLED(SLAM_LOG_DEBUG)) {
+    PoseNode *src = pg->findNode(info.refId);
+    PoseNode *dst = pg->findNode(info.curId);
+    Pose2D relPose2;
+    Pose2D::calRelativePose(dst->pose, src->pose, relPose2);
+    SLAM_LOGD("relPose2: tx=%g, ty=%g, th=%g\n", relPose2.tx, relPose2.ty, relPose2.th);
+  }
 }
 
 //////////
 
-// 現在スキャンcurScanと部分地図の点群refLpsでICPを行い、再訪点の位置を求める。
-bool LoopDetectorSS::estimateRevisitPose(const Scan2D *curScan, const vector<LPoint2D> &refLps, const Pose2D &initPose, Pose2D &revisitPose) {
-  dass->setRefBase(refLps);                              // データ対応づけ器に参照点群を設定
+// 現在スキャンcurScanと部分地図の格子テーブルrefIndexでICPを行い、再訪点の位置を求める。
+bool LoopDetectorSS::estimateRevisitPose(const Scan2D *curScan, const NNGridIndex *refIndex, const Pose2D &initPose, Pose2D &revisitPose) {
+  dass->setRefIndex(refIndex);                           // データ対応づけ器に参照点群を設定
   cfunc->setEvlimit(0.2);                                // コスト関数の誤差閾値
 
-  printf("initPose: tx=%g, ty=%g, th=%g\n", initPose.tx, initPose.ty, initPose.th);       // 確認用
+  SLAM_LOGD("initPose: tx=%g, ty=%g, th=%g\n", initPose.tx, initPose.ty, initPose.th);    // 確認用
 
   size_t usedNumMin = 50; 
 //  size_t usedNumMin = 100;
@@ -155,36 +154,36 @@ bool LoopDetectorSS::estimateRevisitPose(const Scan2D *curScan, const vector<LPo
         double th = MyUtil::add(initPose.th, dth);       // 初期位置に変位分dthを加える
         Pose2D pose(x, y, th);
         double mratio = dass->findCorrespondence(curScan, pose);   // 位置poseでデータ対応づけ
-        size_t usedNum = dass->curLps.size();
-//        printf("usedNum=%lu, mratio=%g\n", usedNum, mratio);          // 確認用
+        size_t usedNum = dass->corrs.size();
+//        SLAM_LOGD("usedNum=%lu, mratio=%g\n", usedNum, mratio);       // 確認用
         if (usedNum < usedNumMin || mratio < 0.9)        // 対応率が悪いと飛ばす
           continue;
-        cfunc->setPoints(dass->curLps, dass->refLps);    // コスト関数に点群を設定
+        cfunc->setPoints(dass->corrs);                   // コスト関数に点の組を設定
         double score =  cfunc->calValue(x, y, th);       // コスト値（マッチングスコア）
         double pnrate = cfunc->getPnrate();              // 詳細な点の対応率
-//        printf("score=%g, pnrate=%g\n", score, pnrate);                    // 確認用
+//        SLAM_LOGD("score=%g, pnrate=%g\n", score, pnrate);                 // 確認用
         if (pnrate > 0.8) {
           candidates.emplace_back(pose);
           if (score < scoreMin)
             scoreMin = score;
           scores.push_back(score);
-//          printf("pose: tx=%g, ty=%g, th=%g\n", pose.tx, pose.ty, pose.th);  // 確認用
-//          printf("score=%g, pnrate=%g\n", score, pnrate);                    // 確認用
+//          SLAM_LOGD("pose: tx=%g, ty=%g, th=%g\n", pose.tx, pose.ty, pose.th);  // 確認用
+//          SLAM_LOGD("score=%g, pnrate=%g\n", score, pnrate);                 // 確認用
         }
       }
     }
   }
-  printf("candidates.size=%lu\n", candidates.size());                           // 確認用
+  SLAM_LOGD("candidates.size=%lu\n", candidates.size());                        // 確認用
   if (candidates.size() == 0)
     return(false);
 
   // 候補位置candidatesの中から最もよいものをICPで選ぶ
   Pose2D best;                                              // 最良候補
   double smin=1000000;                                      // ICPスコア最小値
-  estim->setScanPair(curScan, refLps);                      // ICPにスキャン設定
+  estim->setScanPair(curScan, refIndex);                    // ICPにスキャン設定
   for (size_t i=0; i<candidates.size(); i++) {
     Pose2D p = candidates[i];                               // 候補位置
-    printf("score=%g\n", scores[i]);    // 確認用
+    SLAM_LOGD("score=%g\n", scores[i]); // 確認用
     Pose2D estP;
     double score = estim->estimatePose(p, estP);            // ICPでマッチング位置を求める
     double pnrate = estim->getPnrate();                     // ICPでの点の対応率
@@ -192,7 +191,7 @@ bool LoopDetectorSS::estimateRevisitPose(const Scan2D *curScan, const vector<LPo
     if (score < smin && pnrate >= 0.9 && usedNum >= usedNumMin) {  // ループ検出は条件厳しく
       smin = score;
       best = estP;
-      printf("smin=%g, pnrate=%g, usedNum=%lu\n", smin, pnrate, usedNum);    // 確認用
+      SLAM_LOGD("smin=%g, pnrate=%g, usedNum=%lu\n", smin, pnrate, usedNum); // 確認用
     }
   }
 
@@ -30,6 +30,7 @@ private:
   double radius;                               // 探索半径[m]（現在位置と再訪点の距離閾値）
   double atdthre;                              // 累積走行距離の差の閾値[m]
   double scthre;                               // ICPスコアの閾値
+  size_t candNum;                              // 1回のループ検出で試す部分地図の最大数
 
   PointCloudMapLP *pcmap;                      // 点群地図
   CostFunction *cfunc;                         // コスト関数(ICPとは別に使う)
@@ -37,8 +38,11 @@ private:
   DataAssociator *dass;                        // データ対応づけ器
   PoseFuser *pfu;                              // センサ融合器
 
+  std::vector<std::pair<double, size_t> > cands;   // (距離の2乗, 前回訪問点のインデックス)。作業用
+  std::vector<size_t> tried;                   // 試した部分地図のインデックス。作業用
+
 public:
-  LoopDetectorSS() : radius(4), atdthre(10), scthre(0.2) {
+  LoopDetectorSS() : radius(4), atdthre(10), scthre(0.2), candNum(1) {
   }
 
   ~LoopDetectorSS() {
@@ -66,11 +70,17 @@ public:
     pcmap = p;
   }
 
+  // 近い順に何個の部分地図でループ検出を試すか
+  void setCandidateNum(size_t n) {
+    candNum = n;
+  }
+
 //////////
 
   virtual bool detectLoop(Scan2D *curScan, Pose2D &curPose, int cnt);
+  bool detectLoopAt(Scan2D *curScan, Pose2D &curPose, int cnt, size_t imin, size_t jmin);
   void makeLoopArc(LoopInfo &info);
-  bool estimateRevisitPose(const Scan2D *curScan, const std::vector<LPoint2D> &refLps, const Pose2D &initPose, Pose2D &revisitPose);
+  bool estimateRevisitPose(const Scan2D *curScan, const NNGridIndex *refIndex, const Pose2D &initPose, Pose2D &revisitPose);
 
 };
 
@@ -13,6 +13,7 @@
  ****************************************************************************/
 
 #include "PointCloudMapBS.h"
+#include "SlamLog.h"
 
 using namespace std;
 
@@ -34,7 +35,7 @@ void PointCloudMapBS::addPoints(const vector<LPoint2D> &lps) {
 
 // 全体地図生成。すでにできているので何もしない
 void PointCloudMapBS::makeGlobalMap(){
-  printf("globalMap.size=%lu\n", globalMap.size());   // 確認用
+  SLAM_LOGD("globalMap.size=%lu\n", globalMap.size());   // 確認用
 }
 
 // 局所地図生成。ダミー
@@ -13,6 +13,7 @@
  ****************************************************************************/
 
 #include "PointCloudMapGT.h"
+#include "SlamLog.h"
 
 using namespace std;
 
@@ -31,7 +32,7 @@ void PointCloudMapGT::subsamplePoints(vector<LPoint2D> &sps) {
 
   nntab.makeCellPoints(nthre, sps);         // nthre点以上あるセルから代表点を得る
 
-  printf("allLps.size=%lu, sps.size=%lu\n", allLps.size(), sps.size());  // 確認用
+  SLAM_LOGD("allLps.size=%lu, sps.size=%lu\n", allLps.size(), sps.size());  // 確認用
 }
 
 /////////
@@ -47,13 +48,13 @@ void PointCloudMapGT::makeGlobalMap(){
   globalMap.clear();
   subsamplePoints(globalMap);         // 格子テーブルの各セルの代表点から全体地図を作る
 
-  printf("GT: globalMap.size=%lu\n", globalMap.size());    // 確認用
+  SLAM_LOGD("GT: globalMap.size=%lu\n", globalMap.size()); // 確認用
 }
 
 // 局所地図の生成。全体地図をそのまま使う
 void PointCloudMapGT::makeLocalMap(){
   localMap = globalMap;
-  printf("GT: localMap.size=%lu\n", localMap.size());
+  SLAM_LOGD("GT: localMap.size=%lu\n", localMap.size());
 }
 
 ////////
@@ -61,3 +62,17 @@ void PointCloudMapGT::makeLocalMap(){
 // ダミー
 void PointCloudMapGT::remakeMaps(const vector<Pose2D> &newPoses) {
 }
+
+////////
+
+// 全スキャン点群も書く。格子テーブルは全体地図を作るときに作り直すので書かない
+void PointCloudMapGT::writeState(CheckpointWriter &w) {
+  PointCloudMap::writeState(w);
+  w.putVector(allLps);
+}
+
+bool PointCloudMapGT::readState(CheckpointReader &r) {
+  PointCloudMap::readState(r);
+  r.getVector(allLps);
+  return(r.isOk());
+}
@@ -44,6 +44,8 @@ public:
   virtual void makeLocalMap();
   void subsamplePoints(std::vector<LPoint2D> &sps);
   virtual void remakeMaps(const std::vector<Pose2D> &newPoses);
+  virtual void writeState(CheckpointWriter &w);
+  virtual bool readState(CheckpointReader &r);
 };
 
 #endif
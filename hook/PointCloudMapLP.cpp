@@ -12,28 +12,130 @@
  * @author Masahiro Tomono
  ****************************************************************************/
 
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
 #include "PointCloudMapLP.h"
-#include "NNGridTable.h"
+#include "SlamLog.h"
 
 using namespace std;
 
-double PointCloudMapLP::atdThre = 10;
+///////////
+
+// 退避ファイル内の点の形式。LPoint2Dから地図点に必要な項目だけ残す
+struct SpillPoint
+{
+  int sid;
+  int type;
+  double x, y;
+  double nx, ny;
+};
+
+// 点群lpsをファイルpathに書き出す。一時ファイルに書いてから置き換えるので、
+// 前の中身がチェックポイントにリンクされていても、そちらは書き換わらない
+static bool writePoints(const string &path, const vector<LPoint2D> &lps) {
+  string tmp = path + ".tmp";
+  ofstream ofs(tmp.c_str(), ios::binary | ios::trunc);
+  if (!ofs.is_open()) {
+    SLAM_LOGE("Error: cannot open spill file %s\n", tmp.c_str());
+    return(false);
+  }
+
+  vector<SpillPoint> buf(lps.size());
+  for (size_t i=0; i<lps.size(); i++) {
+    const LPoint2D &lp = lps[i];
+    SpillPoint &sp = buf[i];
+    sp.sid = lp.sid;
+    sp.type = lp.type;
+    sp.x = lp.x;
+    sp.y = lp.y;
+    sp.nx = lp.nx;
+    sp.ny = lp.ny;
+  }
+  if (!buf.empty())
+    ofs.write(reinterpret_cast<const char*>(&buf[0]), buf.size()*sizeof(SpillPoint));
+  ofs.close();
+
+#ifdef _WIN32
+  remove(path.c_str());                    // Windowsのrenameは既存のファイルを置き換えない
+#endif
+  bool flag = ofs.good() && rename(tmp.c_str(), path.c_str()) == 0;
+  if (!flag) {
+    SLAM_LOGE("Error: cannot write spill file %s\n", path.c_str());
+    remove(tmp.c_str());
+  }
+
+  return(flag);
+}
+
+// ファイルpathからnum個の点を読んでlpsに入れる
+static bool readPoints(const string &path, size_t num, vector<LPoint2D> &lps) {
+  lps.clear();
+  ifstream ifs(path.c_str(), ios::binary);
+  if (!ifs.is_open()) {
+    SLAM_LOGE("Error: cannot open spill file %s\n", path.c_str());
+    return(false);
+  }
+
+  vector<SpillPoint> buf(num);
+  if (num > 0)
+    ifs.read(reinterpret_cast<char*>(&buf[0]), num*sizeof(SpillPoint));
+  if (!ifs.good()) {
+    SLAM_LOGE("Error: broken spill file %s\n", path.c_str());
+    return(false);
+  }
+
+  lps.reserve(num);
+  for (size_t i=0; i<num; i++) {
+    const SpillPoint &sp = buf[i];
+    LPoint2D lp(sp.sid, sp.x, sp.y);
+    lp.setNormal(sp.nx, sp.ny);
+    lp.setType(static_cast<ptype>(sp.type));
+    lps.emplace_back(lp);
+  }
+
+  return(true);
+}
 
 ///////////
 
-// 格子テーブルを用いて、部分地図の代表点を得る
-vector<LPoint2D> Submap::subsamplePoints(int nthre) {
-  NNGridTable nntab;                     // 格子テーブル
+// 格子テーブルnntabを用いて、部分地図の代表点をspsの後ろに加える。nntabは作業用で、使い回せばヒープ確保が減る
+void Submap::subsamplePoints(int nthre, NNGridTable &nntab, vector<LPoint2D> &sps) {
+  nntab.clear();
   for (size_t i=0; i<mps.size(); i++) {
     LPoint2D &lp = mps[i];
     nntab.addPoint(&lp);                 // 全点を登録
   }
 
-  vector<LPoint2D> sps;
+  size_t n0 = sps.size();
   nntab.makeCellPoints(nthre, sps);      // nthre個以上のセルの代表点をspsに入れる
-  printf("mps.size=%lu, sps.size=%lu\n", mps.size(), sps.size());
+  SLAM_LOGD("mps.size=%lu, sps.size=%lu\n", mps.size(), sps.size() - n0);
+}
+
+// 点群をファイルpathに退避して、メモリから解放する
+bool Submap::spill(const string &path) {
+  if (spilled)
+    return(true);
+  if (!writePoints(path, mps))
+    return(false);
+
+  spillNum = mps.size();
+  vector<LPoint2D>().swap(mps);            // 領域も解放する
+  spilled = true;
 
-  return(sps);
+  return(true);
+}
+
+// 退避した点群をファイルpathから読み戻してlpsに入れる
+bool Submap::restore(const string &path, vector<LPoint2D> &lps) const {
+  return(readPoints(path, spillNum, lps));
 }
 
 /////////
@@ -49,6 +151,8 @@ void PointCloudMapLP::addPose(const Pose2D &p) {
     atd += sqrt(p.tx*p.tx + p.ty*p.ty);
   }
 
+  poseTable.addPose(poses.size(), p);              // 格子テーブルに登録
+  poseAtds.push_back(atd);
   poses.emplace_back(p);
 }
 
@@ -58,11 +162,20 @@ void PointCloudMapLP::addPoints(const vector<LPoint2D> &lps) {
   if (atd - curSubmap.atdS >= atdThre ) {          // 累積走行距離が閾値を超えたら新しい部分地図に変える
     size_t size = poses.size();
     curSubmap.cntE = size-1;                       // 部分地図の最後のスキャン番号
-    curSubmap.mps = curSubmap.subsamplePoints(nthre); // 終了した部分地図は代表点のみにする（軽量化）
+    sps.clear();
+    curSubmap.subsamplePoints(nthre, nntab, sps);  // 終了した部分地図は代表点のみにする（軽量化）
+    vector<LPoint2D> raw(sps);
+    raw.swap(curSubmap.mps);                       // rawには元の点群が入る。その領域は新しい部分地図で使い回す
+    residentSize += curSubmap.mps.size()*sizeof(LPoint2D);
 
-    Submap submap(atd, size);                      // 新しい部分地図
+    raw.clear();
+    submaps.emplace_back(atd, size);               // 新しい部分地図を追加。curSubmapはここで無効になる
+    Submap &submap = submaps.back();
+    submap.mps.swap(raw);
     submap.addPoints(lps);                         // スキャン点群の登録
-    submaps.emplace_back(submap);                  // 部分地図を追加
+
+    getSubmapIndex(submaps.size()-2);              // 確定した部分地図の格子テーブルを作っておく
+    spillSubmaps();                                // メモリ上限を超えたら古い部分地図を退避
   }
   else {
     curSubmap.addPoints(lps);                      // 現在の部分地図に点群を追加
@@ -70,13 +183,25 @@ void PointCloudMapLP::addPoints(const vector<LPoint2D> &lps) {
 }
 
 // 全体地図の生成。局所地図もここでいっしょに作った方が速い
+// キーフレームごとに呼ばれるので、ファイルに退避した部分地図は読み戻さず、メモリにある部分地図だけで作る
 void PointCloudMapLP::makeGlobalMap(){
+  collectMaps(false);
+}
+
+// 結果の出力用に、退避した部分地図もファイルから読み戻して全体地図を作る
+void PointCloudMapLP::makeExportMap(){
+  collectMaps(true);
+}
+
+// 部分地図から全体地図と局所地図を作る。withSpilledがfalseなら、退避した部分地図は全体地図に入れない
+void PointCloudMapLP::collectMaps(bool withSpilled){
   globalMap.clear();                               // 初期化
   localMap.clear();
   // 現在以外のすでに確定した部分地図から点を集める
   for (size_t i=0; i<submaps.size()-1; i++) {
-    Submap &submap = submaps[i];                   // 部分地図
-    vector<LPoint2D> &mps = submap.mps;            // 部分地図の点群。代表点だけになっている
+    if (submaps[i].spilled && !withSpilled)        // 直前の部分地図は退避しないので、局所地図には影響しない
+      continue;
+    const vector<LPoint2D> &mps = getSubmapPoints(i);   // 部分地図の点群。代表点だけになっている。退避していれば読み戻す
     for (size_t j=0; j<mps.size(); j++) {
       globalMap.emplace_back(mps[j]);              // 全体地図には全点入れる
     }
@@ -89,15 +214,16 @@ void PointCloudMapLP::makeGlobalMap(){
 
   // 現在の部分地図の代表点を全体地図と局所地図に入れる
   Submap &curSubmap = submaps.back();              // 現在の部分地図
-  vector<LPoint2D> sps = curSubmap.subsamplePoints(nthre);  // 代表点を得る
+  sps.clear();
+  curSubmap.subsamplePoints(nthre, nntab, sps);    // 代表点を得る
   for (size_t i=0; i<sps.size(); i++) {
     globalMap.emplace_back(sps[i]);
     localMap.emplace_back(sps[i]);
   }
 
   // 以下は確認用
-  printf("curSubmap.atd=%g, atd=%g, sps.size=%lu\n", curSubmap.atdS, atd, sps.size());
-  printf("submaps.size=%lu, globalMap.size=%lu\n", submaps.size(), globalMap.size());
+  SLAM_LOGD("curSubmap.atd=%g, atd=%g, sps.size=%lu\n", curSubmap.atdS, atd, sps.size());
+  SLAM_LOGD("submaps.size=%lu, globalMap.size=%lu\n", submaps.size(), globalMap.size());
 }
 
 // 局所地図の生成
@@ -113,43 +239,42 @@ void PointCloudMapLP::makeLocalMap(){
 
   // 現在の部分地図の代表点を局所地図に入れる
   Submap &curSubmap = submaps.back();              // 現在の部分地図
-  vector<LPoint2D> sps = curSubmap.subsamplePoints(nthre);  // 代表点を得る
-  for (size_t i=0; i<sps.size(); i++) {
-    localMap.emplace_back(sps[i]);
-  }
+  curSubmap.subsamplePoints(nthre, nntab, localMap);   // 代表点を局所地図の後ろに加える
 
-  printf("localMap.size=%lu\n", localMap.size());   // 確認用
+  SLAM_LOGD("localMap.size=%lu\n", localMap.size());   // 確認用
 }
 
 //////////
 
 // ポーズ調整後のロボット軌跡newPoseを用いて、地図を再構築する
 void PointCloudMapLP::remakeMaps(const vector<Pose2D> &newPoses){
+  clearIndexes();                                      // 点が動くので格子テーブルは作り直す
+
   // 各部分地図内の点の位置を修正する
   for (size_t i=0; i<submaps.size(); i++) {
     Submap &submap = submaps[i];
-    vector<LPoint2D> &mps = submap.mps;                // 部分地図の点群。現在地図以外は代表点になっている
-    for (size_t j=0; j<mps.size(); j++) {
-      LPoint2D &mp = mps[j];
-      size_t idx = mp.sid;                             // 点のスキャン番号
-      if (idx >= poses.size()) {                       // 不正なスキャン番号（あったらバグ）
+    if (submap.spilled) {                              // 退避した部分地図は読み戻して修正し、また書き出す
+      if (!submap.restore(spillPath(i), pagedLps)) {
+        SLAM_LOGE("Error: cannot restore submap %lu. Its points are not corrected.\n", i);
+        pagedIdx = -1;
         continue;
       }
-
-      const Pose2D &oldPose = poses[idx];              // mpに対応する古いロボット位置
-      const Pose2D &newPose = newPoses[idx];           // mpに対応する新しいロボット位置
-      const double (*R1)[2] = oldPose.Rmat;
-      const double (*R2)[2] = newPose.Rmat;
-      LPoint2D lp1 = oldPose.relativePoint(mp);        // oldPoseでmpをセンサ座標系に変換
-      LPoint2D lp2 = newPose.globalPoint(lp1);         // newPoseでポーズ調整後の地図座標系に変換
-      mp.x = lp2.x;
-      mp.y = lp2.y;
-      double nx = R1[0][0]*mp.nx + R1[1][0]*mp.ny;     // 法線ベクトルもoldPoseでセンサ座標系に変換
-      double ny = R1[0][1]*mp.nx + R1[1][1]*mp.ny;
-      double nx2 = R2[0][0]*nx + R2[0][1]*ny;          // 法線ベクトルもnewPoseでポーズ調整後の地図座標系に変換
-      double ny2 = R2[1][0]*nx + R2[1][1]*ny;
-      mp.setNormal(nx2, ny2);
+      remakePoints(pagedLps, newPoses);
+      if (writePoints(spillPath(i), pagedLps))
+        pagedIdx = i;
+      else {                                           // 書けなければ、修正した点群をメモリに戻して退避をあきらめる
+        SLAM_LOGE("Error: cannot rewrite submap %lu. It is kept in memory.\n", i);
+        remove(spillPath(i).c_str());                  // 途中まで書いたファイルを読み戻さないように消す
+        submap.mps.swap(pagedLps);
+        submap.spilled = false;
+        submap.spillNum = 0;
+        residentSize += submap.mps.size()*sizeof(LPoint2D);
+        pagedIdx = -1;
+        memBudget = 0;
+      }
     }
+    else
+      remakePoints(submap.mps, newPoses);              // 部分地図の点群。現在地図以外は代表点になっている
   }
 
   makeGlobalMap();                                     // 部分地図から全体地図と局所地図を生成
@@ -158,4 +283,289 @@ void PointCloudMapLP::remakeMaps(const vector<Pose2D> &newPoses){
     poses[i] = newPoses[i];
   }
   lastPose = newPoses.back();
+
+  remakePoseTable();                                   // 調整後のロボット軌跡で格子テーブルを作り直す
+}
+
+// 点群mpsの各点を、ポーズ調整後のロボット軌跡newPosesで修正する
+void PointCloudMapLP::remakePoints(vector<LPoint2D> &mps, const vector<Pose2D> &newPoses) {
+  for (size_t j=0; j<mps.size(); j++) {
+    LPoint2D &mp = mps[j];
+    size_t idx = mp.sid;                             // 点のスキャン番号
+    if (idx >= poses.size()) {                       // 不正なスキャン番号（あったらバグ）
+      continue;
+    }
+
+    const Pose2D &oldPose = poses[idx];              // mpに対応する古いロボット位置
+    const Pose2D &newPose = newPoses[idx];           // mpに対応する新しいロボット位置
+    const double (*R1)[2] = oldPose.Rmat;
+    const double (*R2)[2] = newPose.Rmat;
+    LPoint2D lp1 = oldPose.relativePoint(mp);        // oldPoseでmpをセンサ座標系に変換
+    LPoint2D lp2 = newPose.globalPoint(lp1);         // newPoseでポーズ調整後の地図座標系に変換
+    mp.x = lp2.x;
+    mp.y = lp2.y;
+    double nx = R1[0][0]*mp.nx + R1[1][0]*mp.ny;     // 法線ベクトルもoldPoseでセンサ座標系に変換
+    double ny = R1[0][1]*mp.nx + R1[1][1]*mp.ny;
+    double nx2 = R2[0][0]*nx + R2[0][1]*ny;          // 法線ベクトルもnewPoseでポーズ調整後の地図座標系に変換
+    double ny2 = R2[1][0]*nx + R2[1][1]*ny;
+    mp.setNormal(nx2, ny2);
+  }
+}
+
+////////// ループ検出の候補探し //////////
+
+// 現在のロボット軌跡posesで、各位置の累積走行距離と格子テーブルを作り直す
+void PointCloudMapLP::remakePoseTable() {
+  poseTable.clear();
+  double atdR = 0;
+  Pose2D prevP;                                        // 原点から始める。addPoseと同じ計算
+  for (size_t i=0; i<poses.size(); i++) {
+    const Pose2D &p = poses[i];
+    atdR += sqrt((p.tx - prevP.tx)*(p.tx - prevP.tx) + (p.ty - prevP.ty)*(p.ty - prevP.ty));
+    poseAtds[i] = atdR;
+    poseTable.addPose(i, p);
+    prevP = p;
+  }
+}
+
+// 現在以外の確定した部分地図にあるロボット位置のうち、位置pから距離radius以内にあるものを探す。
+// 現在の累積走行距離atdとの差がatdthre未満の位置は、ループとみなさないので除く。
+// candsには(距離の2乗, インデックス)を距離の近い順に入れる。
+void PointCloudMapLP::findRevisitCandidates(const Pose2D &p, double radius, double atdthre, vector<pair<double, size_t> > &cands) const {
+  cands.clear();
+  if (submaps.size() < 2)                              // 確定した部分地図がない
+    return;
+
+  size_t idxE = submaps[submaps.size()-2].cntE + 1;   // 確定した部分地図にあるロボット位置の終わり
+  // 累積走行距離は単調増加なので、atdthre以上離れた位置は先頭からの連続した範囲になる。二分探索で終わりを求める
+  vector<double>::const_iterator it = upper_bound(poseAtds.begin(), poseAtds.begin() + idxE, atd,
+                                                  [atdthre](double a1, double a2) { return(a1 - a2 < atdthre); });
+  idxE = it - poseAtds.begin();
+
+  poseTable.findPoses(p, radius, idxE, cands);
+}
+
+// idx番目のロボット位置を含む部分地図のインデックス
+size_t PointCloudMapLP::findSubmap(size_t idx) const {
+  size_t lo=0, hi=submaps.size();                      // 部分地図はcntSの昇順に並んでいる
+  while (hi - lo > 1) {
+    size_t mid = (lo + hi)/2;
+    if (submaps[mid].cntS <= idx)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return(lo);
+}
+
+// i番目の部分地図の格子テーブルを返す。なければ作り、メモリ上限を超えたら最近使っていないものを捨てる
+const NNGridIndex *PointCloudMapLP::getSubmapIndex(size_t i) {
+  if (indexes.size() < submaps.size())
+    indexes.resize(submaps.size(), nullptr);
+
+  if (indexes[i] != nullptr) {                         // 作成済みなら先頭に移して使う
+    indexLru.splice(indexLru.begin(), indexLru, find(indexLru.begin(), indexLru.end(), i));
+    return(indexes[i]);
+  }
+
+  NNGridIndex *index = new NNGridIndex();
+  index->build(getSubmapPoints(i));                    // 退避していればファイルから読み戻して作る
+  indexes[i] = index;
+  indexLru.push_front(i);
+  indexSize += index->byteSize();
+
+  while (indexSize > indexBudget && indexLru.size() > 1) {     // いま作ったものは残す
+    size_t k = indexLru.back();
+    indexLru.pop_back();
+    indexSize -= indexes[k]->byteSize();
+    delete indexes[k];
+    indexes[k] = nullptr;
+  }
+
+  return(index);
+}
+
+// 格子テーブルと距離場をすべて捨てる
+void PointCloudMapLP::clearIndexes() {
+  for (size_t i=0; i<indexes.size(); i++) {
+    delete indexes[i];
+    indexes[i] = nullptr;
+  }
+  indexLru.clear();
+  indexSize = 0;
+
+  for (size_t i=0; i<fields.size(); i++) {
+    delete fields[i];
+    fields[i] = nullptr;
+  }
+  fieldLru.clear();
+}
+
+// 確定したi番目の部分地図の距離場を返す。なければ作る。セルサイズcsize[m]と距離の上限maxDist[m]は作るときだけ使う
+// 確定した部分地図の点は動かないので、ポーズ調整で作り直すまで使い回せる
+const LikelihoodField *PointCloudMapLP::getSubmapField(size_t i, double csize, double maxDist) {
+  if (fields.size() < submaps.size())
+    fields.resize(submaps.size(), nullptr);
+
+  if (fields[i] != nullptr) {                          // 作成済みなら先頭に移して使う。毎スキャン呼ばれるので、要素の付け替えで済ませる
+    fieldLru.splice(fieldLru.begin(), fieldLru, find(fieldLru.begin(), fieldLru.end(), i));
+    return(fields[i]);
+  }
+
+  LikelihoodField *field = new LikelihoodField();
+  field->build(getSubmapPoints(i), csize, maxDist);    // 退避していればファイルから読み戻して作る
+  fields[i] = field;
+  fieldLru.push_front(i);
+
+  while (fieldLru.size() > FIELD_CACHE_NUM) {
+    size_t k = fieldLru.back();
+    fieldLru.pop_back();
+    delete fields[k];
+    fields[k] = nullptr;
+  }
+
+  return(field);
+}
+
+////////// 部分地図の退避 //////////
+
+// i番目の部分地図の点群を返す。退避している場合はファイルから読み戻す
+const vector<LPoint2D> &PointCloudMapLP::getSubmapPoints(size_t i) {
+  Submap &submap = submaps[i];
+  if (!submap.spilled)
+    return(submap.mps);
+
+  if (pagedIdx != i) {                                 // 直前に読み戻したものなら、そのまま使う
+    if (!submap.restore(spillPath(i), pagedLps))
+      pagedLps.clear();
+    pagedIdx = i;
+  }
+
+  return(pagedLps);
+}
+
+// 確定した部分地図の点群がmemBudgetを超えていたら、古いものからファイルに退避する
+void PointCloudMapLP::spillSubmaps() {
+  if (memBudget == 0)                                  // 上限なし
+    return;
+
+  size_t last = submaps.size()-1;                      // 現在の部分地図。これは退避しない
+  while (residentSize > memBudget && spillCursor + horizon < last) {
+    Submap &submap = submaps[spillCursor];
+    size_t size = submap.mps.size()*sizeof(LPoint2D);
+    if (!submap.spill(spillPath(spillCursor))) {       // 書けなければ退避をあきらめる
+      memBudget = 0;
+      break;
+    }
+    residentSize -= size;
+    ++spillCursor;
+  }
+
+  SLAM_LOGD("spillCursor=%lu, residentSize=%lu\n", spillCursor, residentSize);   // 確認用
+}
+
+// i番目の部分地図の退避ファイル名
+string PointCloudMapLP::spillPath(size_t i) {
+  if (spillTag.empty()) {                              // プロセスIDとインスタンスのアドレスで識別する
+    ostringstream oss;
+    oss << getpid() << "_" << this;
+    spillTag = oss.str();
+  }
+
+  ostringstream oss;
+  if (!spillDir.empty())
+    oss << spillDir << "/";
+  oss << "submap_" << spillTag << "_" << i << ".bin";
+
+  return(oss.str());
+}
+
+// 退避ファイルを削除する
+void PointCloudMapLP::removeSpillFiles() {
+  for (size_t i=0; i<submaps.size(); i++) {
+    if (submaps[i].spilled)
+      remove(spillPath(i).c_str());
+  }
+}
+
+////////// チェックポイント //////////
+
+// 部分地図と累積走行距離を書く。退避した部分地図は読み戻さず、退避ファイルをチェックポイントと一緒に残す
+// リンクできなければ、読み戻して点群を書く
+// 格子テーブルは読み込み後に必要になったときに作り直すので書かない
+void PointCloudMapLP::writeState(CheckpointWriter &w) {
+  PointCloudMap::writeState(w);
+  w.put(atd);
+  w.putVector(poseAtds);
+  w.put<uint64_t>(submaps.size());
+  for (size_t i=0; i<submaps.size(); i++) {
+    const Submap &submap = submaps[i];
+    w.put(submap.atdS);
+    w.put(submap.cntS);
+    w.put(submap.cntE);
+    uint64_t fid=0;
+    bool linked = submap.spilled && w.putFile(spillPath(i), fid);
+    w.put<uint8_t>(linked);
+    if (linked) {
+      w.put(submap.spillNum);
+      w.put(fid);
+    }
+    else
+      w.putVector(getSubmapPoints(i));
+  }
+}
+
+// writeStateで書いた状態を読む。残した退避ファイルは、メモリ上限があれば自分の退避ファイルとしてリンクし直し、なければ読み込む
+// その後、メモリ上限に従って退避し直す
+bool PointCloudMapLP::readState(CheckpointReader &r) {
+  if (!PointCloudMap::readState(r))
+    return(false);
+  r.get(atd);
+  r.getVector(poseAtds);
+  uint64_t num=0;
+  r.get(num);
+
+  clearIndexes();
+  removeSpillFiles();
+  submaps.clear();
+  residentSize = 0;
+  spillCursor = 0;
+  pagedIdx = -1;
+  for (uint64_t i=0; i<num && r.isOk(); i++) {
+    submaps.emplace_back();
+    Submap &submap = submaps.back();
+    r.get(submap.atdS);
+    r.get(submap.cntS);
+    r.get(submap.cntE);
+    uint8_t linked=0;
+    r.get(linked);
+    if (linked) {
+      uint64_t fid=0;
+      size_t spillNum=0;
+      r.get(spillNum);
+      r.get(fid);
+      string path = r.getFilePath(fid);
+      if (memBudget > 0 && linkFile(path, spillPath(i))) {
+        submap.spillNum = spillNum;
+        submap.spilled = true;
+        continue;
+      }
+      if (!readPoints(path, spillNum, submap.mps))
+        return(false);
+    }
+    else
+      r.getVector(submap.mps);
+    if (i+1 < num)                                     // 確定した部分地図
+      residentSize += submap.mps.size()*sizeof(LPoint2D);
+  }
+  if (!r.isOk() || submaps.empty() || poseAtds.size() != poses.size())
+    return(false);
+
+  poseTable.clear();                                   // ロボット位置の格子テーブルは作り直す
+  for (size_t i=0; i<poses.size(); i++)
+    poseTable.addPose(i, poses[i]);
+
+  spillSubmaps();
+
+  return(true);
 }
@@ -15,8 +15,14 @@
 #ifndef POINT_CLOUD_MAP_LP_H_
 #define POINT_CLOUD_MAP_LP_H_
 
+#include <string>
+#include <list>
 #include <boost/unordered_map.hpp>
 #include "PointCloudMap.h"
+#include "PoseGridTable.h"
+#include "NNGridIndex.h"
+#include "NNGridTable.h"
+#include "LikelihoodField.h"
 
 ///////////
 
@@ -26,13 +32,15 @@ struct Submap
   double atdS;                              // 部分地図の始点での累積走行距離
   size_t cntS;                              // 部分地図の最初のスキャン番号
   size_t cntE;                              // 部分地図の最後のスキャン番号
+  bool spilled;                             // 点群をファイルに退避したか
+  size_t spillNum;                          // 退避した点数
 
   std::vector<LPoint2D> mps;                // 部分地図内のスキャン点群
 
-  Submap() : atdS(0), cntS(0), cntE(-1) {
+  Submap() : atdS(0), cntS(0), cntE(-1), spilled(false), spillNum(0) {
   }
 
-  Submap(double a, size_t s) : cntE(-1) {
+  Submap(double a, size_t s) : cntE(-1), spilled(false), spillNum(0) {
     atdS = a;
     cntS = s;
   }
@@ -42,7 +50,9 @@ struct Submap
       mps.emplace_back(lps[i]);
   }
 
-  std::vector<LPoint2D> subsamplePoints(int nthre);
+  void subsamplePoints(int nthre, NNGridTable &nntab, std::vector<LPoint2D> &sps);
+  bool spill(const std::string &path);
+  bool restore(const std::string &path, std::vector<LPoint2D> &lps) const;
 };
 
 ///////////
@@ -51,17 +61,45 @@ struct Submap
 class PointCloudMapLP : public PointCloudMap
 {
 public:
-  static double atdThre;                    // 部分地図の区切りとなる累積走行距離(atd)[m]
+  double atdThre;                           // 部分地図の区切りとなる累積走行距離(atd)[m]
   double atd;                               // 現在の累積走行距離(accumulated travel distance)
   std::vector<Submap> submaps;              // 部分地図
+  std::vector<double> poseAtds;             // 各ロボット位置での累積走行距離
+
+private:
+  PoseGridTable poseTable;                  // ロボット位置の格子テーブル。ループ検出の候補探しに使う
+
+  std::vector<NNGridIndex*> indexes;        // 確定した部分地図ごとの格子テーブル。作っていなければnullptr
+  std::list<size_t> indexLru;               // 格子テーブルがある部分地図のインデックス。最近使ったものが先頭
+  size_t indexBudget;                       // 格子テーブルのメモリ上限[byte]
+  size_t indexSize;                         // 格子テーブルの使用メモリ[byte]
+
+  static const size_t FIELD_CACHE_NUM = 2;  // 距離場を残す部分地図の個数。局所地図に使うのは直前の部分地図だけ
+  std::vector<LikelihoodField*> fields;     // 確定した部分地図ごとの距離場。作っていなければnullptr
+  std::list<size_t> fieldLru;               // 距離場がある部分地図のインデックス。最近使ったものが先頭
+
+private:
+  size_t memBudget;                         // 確定した部分地図の点群をメモリに置く上限[byte]。0なら無制限
+  size_t horizon;                           // 常にメモリに置く直近の確定部分地図の個数
+  std::string spillDir;                     // 部分地図の退避先ディレクトリ
+  std::string spillTag;                     // 退避ファイル名の識別子。複数インスタンスで衝突しないようにする
+  size_t residentSize;                      // メモリ上にある確定部分地図の点群サイズ[byte]
+  size_t spillCursor;                       // 次に退避を検討する部分地図のインデックス
+  std::vector<LPoint2D> pagedLps;           // ファイルから読み戻した点群（作業用）
+  size_t pagedIdx;                          // pagedLpsに入っている部分地図のインデックス
+
+  NNGridTable nntab;                        // 代表点を求める格子テーブル（作業用）
+  std::vector<LPoint2D> sps;                // 部分地図の代表点（作業用）
 
 public:
-  PointCloudMapLP() {
+  PointCloudMapLP() : atdThre(10), atd(0), indexBudget(32*1024*1024), indexSize(0), memBudget(0), horizon(2), residentSize(0), spillCursor(0), pagedIdx(-1) {
     Submap submap;
     submaps.emplace_back(submap);           // 最初の部分地図を作っておく
   }
 
   ~PointCloudMapLP() {
+    removeSpillFiles();
+    clearIndexes();
   }
 
 //////////
@@ -78,14 +116,52 @@ public:
     return(submaps);
   }
 
+  // 部分地図の区切りとなる累積走行距離[m]を設定する。最初のスキャンの前に行うこと
+  void setAtdThre(double d) {
+    atdThre = d;
+  }
+
+  // 確定した部分地図の点群のメモリ上限budget[byte]、常にメモリに置く部分地図の個数h、退避先ディレクトリdirを設定
+  void setMemoryBudget(size_t budget, size_t h, const std::string &dir) {
+    memBudget = budget;
+    horizon = (h < 1)? 1 : h;               // 直前の部分地図は局所地図に使うので必ず残す
+    spillDir = dir;
+  }
+
+  size_t getResidentSize() const {
+    return(residentSize);
+  }
+
+  // 部分地図の格子テーブルのメモリ上限[byte]。超えたら最近使っていないものから捨てる
+  void setIndexBudget(size_t budget) {
+    indexBudget = budget;
+  }
+
 /////////////
 
+  const std::vector<LPoint2D> &getSubmapPoints(size_t i);
+  void spillSubmaps();
+  std::string spillPath(size_t i);
+  void removeSpillFiles();
+  void remakePoints(std::vector<LPoint2D> &mps, const std::vector<Pose2D> &newPoses);
+  void remakePoseTable();
+  const NNGridIndex *getSubmapIndex(size_t i);
+  const LikelihoodField *getSubmapField(size_t i, double csize, double maxDist);
+  void clearIndexes();
+  void findRevisitCandidates(const Pose2D &p, double radius, double atdthre, std::vector<std::pair<double, size_t> > &cands) const;
+  size_t findSubmap(size_t idx) const;
+
   virtual void addPose(const Pose2D &p);
   virtual void addPoints(const std::vector<LPoint2D> &lps);
   virtual void makeGlobalMap();
+  virtual void makeExportMap();
   virtual void makeLocalMap();
   virtual void remakeMaps(const std::vector<Pose2D> &newPoses);
+  virtual void writeState(CheckpointWriter &w);
+  virtual bool readState(CheckpointReader &r);
 
+private:
+  void collectMaps(bool withSpilled);
 };
 
 #endif
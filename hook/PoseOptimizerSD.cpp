@@ -13,12 +13,14 @@
  ****************************************************************************/
 
 #include "PoseOptimizerSD.h"
+#include "SlamLog.h"
 
 using namespace std;
 
 ////////
 
 // データ対応づけ固定のもと、初期値initPoseを与えてロボット位置の推定値estPoseを求める
+// 繰り返しの上限や締切があれば、そこで打ち切ってそれまでの最小の解を返す
 double PoseOptimizerSD::optimizePose(Pose2D &initPose, Pose2D &estPose) {
   double th = initPose.th;
   double tx = initPose.tx;
@@ -28,16 +30,25 @@ double PoseOptimizerSD::optimizePose(Pose2D &initPose, Pose2D &estPose) {
   double evold = evmin;                        // 1つ前のコスト値。収束判定に使う
 
   double ev = cfunc->calValue(tx, ty, th);     // コスト計算
-  int nn=0;                                    // 繰り返し回数。確認用
+  int nn=0;                                    // 繰り返し回数
   double kk=0.00001;                           // 最急降下法のステップ幅係数
+  deadlineHit = false;
   while (abs(evold-ev) > evthre) {             // 収束判定。1つ前の値との変化が小さいと終了
     nn++;
     evold = ev;
 
-    // 数値計算による偏微分
-    double dEtx = (cfunc->calValue(tx+dd, ty, th) - ev)/dd;
-    double dEty = (cfunc->calValue(tx, ty+dd, th) - ev)/dd;
-    double dEth = (cfunc->calValue(tx, ty, th+da) - ev)/da;
+    // 偏微分。コスト関数が解析的に求められなければ数値計算で求める
+    double dEtx, dEty, dEth;
+    Eigen::Vector3d grad;
+    Eigen::Matrix3d hes;
+    if (cfunc->calDerivatives(tx, ty, th, grad, hes)) {
+      dEtx = grad(0);  dEty = grad(1);  dEth = grad(2);
+    }
+    else {
+      dEtx = (cfunc->calValue(tx+dd, ty, th) - ev)/dd;
+      dEty = (cfunc->calValue(tx, ty+dd, th) - ev)/dd;
+      dEth = (cfunc->calValue(tx, ty, th+da) - ev)/da;
+    }
 
     // 微分係数にkkをかけてステップ幅にする
     double dx = -kk*dEtx;
@@ -52,15 +63,19 @@ double PoseOptimizerSD::optimizePose(Pose2D &initPose, Pose2D &estPose) {
       txmin = tx;  tymin = ty;  thmin = th;
     }
 
-//    printf("nn=%d, ev=%g, evold=%g, abs(evold-ev)=%g\n", nn, ev, evold, abs(evold-ev));         // 確認用
+//    SLAM_LOGD("nn=%d, ev=%g, evold=%g, abs(evold-ev)=%g\n", nn, ev, evold, abs(evold-ev));      // 確認用
+
+    if (checkStop(nn))
+      break;
   }
+  iterNum = nn;
 
   ++allN;
   if (allN > 0 && evmin < 100) 
     sum += evmin;
-//  printf("allN=%d, evmin=%g, avg=%g\n", allN, evmin, (sum/allN));         // 確認用
+//  SLAM_LOGD("allN=%d, evmin=%g, avg=%g\n", allN, evmin, (sum/allN));      // 確認用
 
-//  printf("nn=%d, ev=%g\n", nn, ev);         // 確認用
+//  SLAM_LOGD("nn=%d, ev=%g\n", nn, ev);      // 確認用
 
   estPose.setVal(txmin, tymin, thmin);          // 最小値を与える解を保存
 
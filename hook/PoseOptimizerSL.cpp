@@ -14,12 +14,14 @@
 
 #include <boost/math/tools/minima.hpp>
 #include "PoseOptimizerSL.h"
+#include "SlamLog.h"
 
 using namespace std;
 
 ////////
 
 // データ対応づけ固定のもと、初期値initPoseを与えてロボット位置の推定値estPoseを求める
+// 繰り返しの上限や締切があれば、そこで打ち切ってそれまでの最小の解を返す
 double PoseOptimizerSL::optimizePose(Pose2D &initPose, Pose2D &estPose) {
   double th = initPose.th;
   double tx = initPose.tx;
@@ -30,38 +32,67 @@ double PoseOptimizerSL::optimizePose(Pose2D &initPose, Pose2D &estPose) {
   Pose2D pose, dir;
 
   double ev = cfunc->calValue(tx, ty, th);       // コスト計算
-  int nn=0;                                      // 繰り返し回数。確認用
+  int nn=0;                                      // 繰り返し回数
+  deadlineHit = false;
   while (abs(evold-ev) > evthre) {               // 収束判定。値の変化が小さいと終了
     nn++;
     evold = ev;
 
-    // 数値計算による偏微分
-    double dx = (cfunc->calValue(tx+dd, ty, th) - ev)/dd;
-    double dy = (cfunc->calValue(tx, ty+dd, th) - ev)/dd;
-    double dth = (cfunc->calValue(tx, ty, th+da) - ev)/da;
-    tx += dx;  ty += dy;  th += dth;              // いったん次の探索位置を決める
-
-    // ブレント法による直線探索
-    pose.tx = tx;  pose.ty = ty;  pose.th = th;   // 探索開始点
-    dir.tx = dx;   dir.ty = dy;   dir.th = dth;   // 探索方向
-    search(ev, pose, dir);                        // 直線探索実行
-    tx = pose.tx;  ty = pose.ty;  th = pose.th;   // 直線探索で求めた位置
-
-    ev = cfunc->calValue(tx, ty, th);             // 求めた位置でコスト計算
+    double dx, dy, dth;
+    Eigen::Vector3d grad;
+    Eigen::Matrix3d hes;
+    if (cfunc->calDerivatives(tx, ty, th, grad, hes)) {
+      // コスト関数が微分を解析的に求められれば、ガウス・ニュートン法で進む
+      // 歩幅は1が基本なので、直線探索の代わりに、コストが下がるまで歩幅を半分にしていく
+      Eigen::Vector3d step = -MyUtil::symInverse(hes)*grad;
+      dx = step(0);  dy = step(1);  dth = step(2);
+      double t = 1;
+      double evn = HUGE_VAL;
+      for (; t>0.1; t*=0.5) {
+        evn = cfunc->calValue(tx+t*dx, ty+t*dy, MyUtil::add(th, t*dth));
+        if (evn < ev)
+          break;
+      }
+      if (evn < ev) {
+        tx += t*dx;  ty += t*dy;  th = MyUtil::add(th, t*dth);
+        ev = evn;
+      }
+      else                                        // 1/8まで下げても下がらなければ、最小に達したとして終える
+        evold = ev;
+    }
+    else {
+      // 数値計算による偏微分
+      dx = (cfunc->calValue(tx+dd, ty, th) - ev)/dd;
+      dy = (cfunc->calValue(tx, ty+dd, th) - ev)/dd;
+      dth = (cfunc->calValue(tx, ty, th+da) - ev)/da;
+      tx += dx;  ty += dy;  th += dth;            // いったん次の探索位置を決める
+
+      // ブレント法による直線探索
+      pose.tx = tx;  pose.ty = ty;  pose.th = th;   // 探索開始点
+      dir.tx = dx;   dir.ty = dy;   dir.th = dth;   // 探索方向
+      search(ev, pose, dir);                        // 直線探索実行
+      tx = pose.tx;  ty = pose.ty;  th = pose.th;   // 直線探索で求めた位置
+
+      ev = cfunc->calValue(tx, ty, th);             // 求めた位置でコスト計算
+    }
 
     if (ev < evmin) {                             // コストがこれまでの最小なら更新
       evmin = ev;
       txmin = tx;  tymin = ty;  thmin = th;
     }
 
-//    printf("nn=%d, ev=%g, evold=%g, abs(evold-ev)=%g\n", nn, ev, evold, abs(evold-ev));         // 確認用
+//    SLAM_LOGD("nn=%d, ev=%g, evold=%g, abs(evold-ev)=%g\n", nn, ev, evold, abs(evold-ev));      // 確認用
+
+    if (checkStop(nn))
+      break;
   }
+  iterNum = nn;
   ++allN;
   if (allN > 0 && evmin < 100) 
     sum += evmin;
-//  printf("allN=%d, nn=%d, evmin=%g, avg=%g, evthre=%g\n", allN, nn, evmin, (sum/allN), evthre);         // 確認用
+//  SLAM_LOGD("allN=%d, nn=%d, evmin=%g, avg=%g, evthre=%g\n", allN, nn, evmin, (sum/allN), evthre);      // 確認用
 
-//  printf("nn=%d, evmin=%g\n", nn, evmin);       // 確認用
+//  SLAM_LOGD("nn=%d, evmin=%g\n", nn, evmin);    // 確認用
 
   estPose.setVal(txmin, tymin, thmin);            // 最小値を与える解を保存
 
@@ -16,7 +16,7 @@
 
 using namespace std;
 
-const Scan2D *RefScanMakerBS::makeRefScan() {
+LPointSpan RefScanMakerBS::makeRefScan() {
   vector<LPoint2D> &refLps = refScan.lps;         // 参照スキャンの点群のコンテナ
   refLps.clear();
 
@@ -39,5 +39,5 @@ const Scan2D *RefScanMakerBS::makeRefScan() {
     refLps.emplace_back(rp);
   }
 
-  return(&refScan);
+  return(LPointSpan(refLps));
 }
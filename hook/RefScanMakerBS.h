@@ -25,7 +25,7 @@ public:
   ~RefScanMakerBS() {
   }
 
-  virtual const Scan2D *makeRefScan();
+  virtual LPointSpan makeRefScan();
 
 };
 
@@ -25,7 +25,7 @@ public:
   ~RefScanMakerLM() {
   }
 
-  virtual const Scan2D *makeRefScan();
+  virtual LPointSpan makeRefScan();
 
 };
 